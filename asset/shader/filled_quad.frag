@@ -1,21 +1,87 @@
 #version 450 core
 
+// The discard below would otherwise hold the depth test back until the shader ran. Only opaque draws write depth and
+// they never discard, so testing first changes nothing but what gets shaded.
+layout (early_fragment_tests) in;
+
 in vec4 frag_tint_color;
 in vec2 frag_uv_coord;
-in float frag_texture_index;
+flat in int frag_texture_index;
+// Negative when the texture slot is sampled instead of the atlas
+flat in int frag_texture_layer;
+flat in int frag_primitive_kind;
+// x: corner radius, y: thickness, both relative to the quad width (see Primitive.h)
+flat in vec2 frag_primitive_params;
 
 out vec4 pixel_color;
 
 uniform sampler2D u_textures[9];
+uniform sampler2DArray u_atlas;
+
+const int PRIMITIVE_NONE = 0;
+const int PRIMITIVE_CIRCLE = 1;
+const int PRIMITIVE_RING = 2;
+const int PRIMITIVE_ROUNDED_RECT = 3;
+
+// Share of the pixel covered by the primitive, from its signed distance in screen pixels
+float primitive_coverage(vec2 uv_per_pixel)
+{
+    int kind = frag_primitive_kind;
+
+    if (kind == PRIMITIVE_NONE) {
+        return 1.0;
+    }
+
+    vec2 pixels_per_uv = 1.0 / max(uv_per_pixel, vec2(1e-6));
+
+    vec2 half_size = 0.5 * pixels_per_uv;
+    vec2 point = (frag_uv_coord - 0.5) * pixels_per_uv;
+    float distance;
+
+    if (kind == PRIMITIVE_ROUNDED_RECT) {
+        float corner = min(frag_primitive_params.x * pixels_per_uv.x, min(half_size.x, half_size.y));
+        vec2 corner_offset = abs(point) - half_size + corner;
+        distance = length(max(corner_offset, 0.0)) + min(max(corner_offset.x, corner_offset.y), 0.0) - corner;
+    } else {
+        distance = length(point) - min(half_size.x, half_size.y);
+
+        if (kind == PRIMITIVE_RING) {
+            float half_thickness = 0.5 * frag_primitive_params.y * pixels_per_uv.x;
+            distance = abs(distance + half_thickness) - half_thickness;
+        }
+    }
+
+    return clamp(0.5 - distance, 0.0, 1.0);
+}
 
 void main()
 {
-    int text_index = int(frag_texture_index);
-    vec4 potential_pixel_color = texture(u_textures[text_index], frag_uv_coord) * frag_tint_color;
+    // Uv units per screen pixel along each quad axis, holds for rotated and zoomed quads. Derivatives are undefined
+    // once a neighbouring invocation discarded or took another branch, so they are taken first.
+    vec2 uv_per_pixel = vec2(length(vec2(dFdx(frag_uv_coord.x), dFdy(frag_uv_coord.x))),
+                             length(vec2(dFdx(frag_uv_coord.y), dFdy(frag_uv_coord.y))));
+
+    vec4 texture_color;
+
+    if (frag_texture_layer < 0) {
+        texture_color = texture(u_textures[frag_texture_index], frag_uv_coord);
+    } else {
+        texture_color = texture(u_atlas, vec3(frag_uv_coord, float(frag_texture_layer)));
+    }
+
+    vec4 potential_pixel_color = texture_color * frag_tint_color;
 
     if(potential_pixel_color.a < 0.1) {
         discard;
     }
 
+    float coverage = primitive_coverage(uv_per_pixel);
+
+    if (coverage <= 0.0) {
+        discard;
+    }
+
+    potential_pixel_color.a *= coverage;
+
     pixel_color = potential_pixel_color;
-}
\ No newline at end of file
+}
@@ -1,20 +1,34 @@
 #version 450 core
 
+// See Shape::BatchVertex, the packed attributes are normalized by the vertex format
+// z is the clip space depth of the drawable, only x and y are projected
 layout (location = 0) in vec3 cpu_vertex_point;
 layout (location = 1) in vec4 cpu_tint_color;
 layout (location = 2) in vec2 cpu_uv;
-layout (location = 3) in float cpu_texture_index;
+// x: texture slot, y: atlas layer (255 when the slot is sampled), z: primitive kind, see Shape::Material
+layout (location = 3) in uvec4 cpu_material;
+layout (location = 4) in vec2 cpu_primitive_params;
 
 out vec4 frag_tint_color;
 out vec2 frag_uv_coord;
-out float frag_texture_index;
+flat out int frag_texture_index;
+flat out int frag_texture_layer;
+flat out int frag_primitive_kind;
+flat out vec2 frag_primitive_params;
 
-uniform mat4 u_projection;
+// Shared by every program, see Renderer::FrameData
+layout (std140, binding = 0) uniform FrameData {
+    mat4 u_projection;
+};
 
 void main()
 {
-    gl_Position = u_projection * vec4(cpu_vertex_point, 1.0);
+    gl_Position = u_projection * vec4(cpu_vertex_point.xy, 0.0, 1.0);
+    gl_Position.z = cpu_vertex_point.z;
     frag_tint_color = cpu_tint_color;
     frag_uv_coord = cpu_uv;
-    frag_texture_index = cpu_texture_index;
-}
\ No newline at end of file
+    frag_texture_index = int(cpu_material.x);
+    frag_texture_layer = cpu_material.y == 255u ? -1 : int(cpu_material.y);
+    frag_primitive_kind = int(cpu_material.z);
+    frag_primitive_params = cpu_primitive_params;
+}
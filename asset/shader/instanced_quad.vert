@@ -0,0 +1,48 @@
+#version 450 core
+
+layout (location = 0) in vec2 cpu_shape_point;
+layout (location = 1) in vec2 cpu_shape_uv;
+// z is the clip space depth of the instance, only x and y are projected
+layout (location = 2) in vec3 cpu_instance_position;
+layout (location = 3) in vec2 cpu_instance_scale;
+layout (location = 4) in float cpu_instance_rotation;
+// See Shape::InstanceData, the packed attributes are normalized by the vertex format
+layout (location = 5) in vec4 cpu_tint_color;
+layout (location = 6) in vec2 cpu_uv_offset;
+// Negative where the uv rect flips the texture
+layout (location = 7) in vec2 cpu_uv_size;
+// x: texture slot, y: atlas layer (255 when the slot is sampled), z: primitive kind, see Shape::Material
+layout (location = 8) in uvec4 cpu_material;
+layout (location = 9) in vec2 cpu_primitive_params;
+
+out vec4 frag_tint_color;
+out vec2 frag_uv_coord;
+flat out int frag_texture_index;
+flat out int frag_texture_layer;
+flat out int frag_primitive_kind;
+flat out vec2 frag_primitive_params;
+
+// Shared by every program, see Renderer::FrameData
+layout (std140, binding = 0) uniform FrameData {
+    mat4 u_projection;
+};
+
+void main()
+{
+    vec2 local_point = cpu_shape_point * cpu_instance_scale;
+    float rotation_cos = cos(cpu_instance_rotation);
+    float rotation_sin = sin(cpu_instance_rotation);
+    vec2 world_point = cpu_instance_position.xy + vec2(
+        local_point.x * rotation_cos - local_point.y * rotation_sin,
+        local_point.x * rotation_sin + local_point.y * rotation_cos
+    );
+
+    gl_Position = u_projection * vec4(world_point, 0.0, 1.0);
+    gl_Position.z = cpu_instance_position.z;
+    frag_tint_color = cpu_tint_color;
+    frag_uv_coord = cpu_uv_offset + cpu_shape_uv * cpu_uv_size;
+    frag_texture_index = int(cpu_material.x);
+    frag_texture_layer = cpu_material.y == 255u ? -1 : int(cpu_material.y);
+    frag_primitive_kind = int(cpu_material.z);
+    frag_primitive_params = cpu_primitive_params;
+}
@@ -0,0 +1,32 @@
+#version 450 core
+
+layout (location = 0) in vec2 cpu_vertex_point;
+layout (location = 1) in vec4 cpu_tint_color;
+layout (location = 2) in vec2 cpu_uv;
+layout (location = 4) in float cpu_texture_layer;
+
+out vec4 frag_tint_color;
+out vec2 frag_uv_coord;
+flat out int frag_texture_index;
+flat out int frag_texture_layer;
+flat out int frag_primitive_kind;
+flat out vec2 frag_primitive_params;
+
+// Shared by every program, see Renderer::FrameData
+layout (std140, binding = 0) uniform FrameData {
+    mat4 u_projection;
+};
+
+// Tiles always sample the atlas and are never a primitive, see TileMap::TileVertex. They lie on the far plane, behind
+// every drawable.
+void main()
+{
+    gl_Position = u_projection * vec4(cpu_vertex_point, 0.0, 1.0);
+    gl_Position.z = 1.0;
+    frag_tint_color = cpu_tint_color;
+    frag_uv_coord = cpu_uv;
+    frag_texture_index = 0;
+    frag_texture_layer = int(cpu_texture_layer);
+    frag_primitive_kind = 0;
+    frag_primitive_params = vec2(0.0);
+}
\ No newline at end of file
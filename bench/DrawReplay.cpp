@@ -0,0 +1,474 @@
+#define GLM_FORCE_RADIANS 1
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+#include <glad/glad.h>
+#include "renderer/Renderer.h"
+#include "renderer/DrawCaptureFormat.h"
+#include "Offscreen.h"
+
+
+// Replays a draw capture of the game through the renderer into an offscreen framebuffer and reports frame times as
+// JSON. Replaying the same capture before and after a renderer change compares both on a real workload.
+//
+//   rulethecity --capture=city.rtcd
+//   rtc_replay --capture=city.rtcd --loops=5 > before.json
+//   rtc_replay --capture=city.rtcd --paced > paced.json
+//   rtc_replay --capture=city.rtcd --overdraw [--no-depth-test] > overdraw.json
+
+// Every captured texture name is drawn with a checker texture of this size
+static constexpr const size_t REPLAY_TEXTURE_SIZE = 64;
+
+struct ReplayOptions {
+    const char* capture = nullptr;
+    // Waits for the recorded time of every frame instead of replaying as fast as possible
+    bool paced = false;
+    size_t loops = 1;
+    // Replayed before the measured loops, the first frames create the render batches
+    size_t warmup_frames = 30;
+    const char* assets = nullptr;
+    const char* output = nullptr;
+    RenderSettings settings;
+};
+
+struct CapturedFrame {
+    DrawCaptureFormat::FrameHeader header;
+    size_t first_command;
+};
+
+struct Capture {
+    std::vector<CapturedFrame> frames;
+    std::vector<DrawCaptureFormat::Command> commands;
+    std::vector<DrawCaptureFormat::Shape> shapes;
+    std::vector<std::vector<Shape::Vertex>> shape_vertices;
+    std::vector<std::vector<int>> shape_indices;
+};
+
+// Per frame means of what the renderer did with the captured draws
+struct ReplayStats {
+    double commands;
+    double draw_calls;
+    double culled;
+    // Fragments per screen pixel, with --overdraw
+    double overdraw;
+    // Paced replays only, frames that took longer than the captured frame did
+    size_t late_frames;
+    double wall_ms;
+};
+
+static bool parse_size(const char* arg, const char* prefix, size_t& value) {
+    size_t length = strlen(prefix);
+    if (strncmp(arg, prefix, length) != 0) {
+        return false;
+    }
+
+    value = strtoul(arg + length, nullptr, 10);
+
+    return true;
+}
+
+static ReplayOptions parse_options(int argc, char* args[]) {
+    ReplayOptions options;
+    options.settings.worker_threads = std::max(1U, std::thread::hardware_concurrency()) - 1;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = args[i];
+
+        if (parse_size(arg, "--loops=", options.loops) ||
+            parse_size(arg, "--warmup=", options.warmup_frames) ||
+            parse_size(arg, "--workers=", options.settings.worker_threads)) {
+            continue;
+        }
+
+        if (strcmp(arg, "--paced") == 0) {
+            options.paced = true;
+        } else if (strcmp(arg, "--instanced") == 0) {
+            options.settings.instancing = true;
+        } else if (strcmp(arg, "--multi-draw") == 0) {
+            options.settings.multi_draw_indirect = true;
+        } else if (strcmp(arg, "--buffer-sub-data") == 0) {
+            options.settings.upload_mode = UploadMode::BUFFER_SUB_DATA;
+        } else if (strcmp(arg, "--no-depth-test") == 0) {
+            options.settings.depth_test = false;
+        } else if (strcmp(arg, "--overdraw") == 0) {
+            options.settings.count_overdraw = true;
+        } else if (strncmp(arg, "--capture=", 10) == 0) {
+            options.capture = arg + 10;
+        } else if (strncmp(arg, "--assets=", 9) == 0) {
+            options.assets = arg + 9;
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            options.output = arg + 6;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            exit(1);
+        }
+    }
+
+    options.loops = std::max<size_t>(options.loops, 1);
+
+    return options;
+}
+
+// Reads the whole capture up front, so the replay never waits for the disk
+static std::optional<Capture> load_capture(const char* file_name) {
+    FILE* file = fopen(file_name, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Couldn't open %s\n", file_name);
+
+        return std::nullopt;
+    }
+
+    std::vector<unsigned char> data;
+    unsigned char buffer[64 * 1024];
+    size_t read;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+
+    fclose(file);
+
+    size_t offset = 0;
+    const auto take = [&data, &offset](void* out, size_t bytes) {
+        if (data.size() - offset < bytes) {
+            return false;
+        }
+
+        memcpy(out, data.data() + offset, bytes);
+        offset += bytes;
+
+        return true;
+    };
+
+    // Counts read from the file are checked against the bytes left before anything is sized from them
+    const auto fits = [&data, &offset](uint64_t bytes) {
+        return bytes <= data.size() - offset;
+    };
+
+    DrawCaptureFormat::Header header{};
+    if (!take(&header, sizeof(header)) || memcmp(header.magic, DrawCaptureFormat::MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DrawCaptureFormat::VERSION) {
+        fprintf(stderr, "%s is not a draw capture of this version\n", file_name);
+
+        return std::nullopt;
+    }
+
+    if (header.frame_count == 0) {
+        fprintf(stderr, "%s holds no frames, the capture may not have been stopped\n", file_name);
+
+        return std::nullopt;
+    }
+
+    if (!fits((uint64_t) header.frame_count * sizeof(DrawCaptureFormat::FrameHeader))) {
+        fprintf(stderr, "%s is truncated, it cannot hold %u frames\n", file_name, header.frame_count);
+
+        return std::nullopt;
+    }
+
+    Capture capture;
+    capture.frames.reserve(header.frame_count);
+
+    // A shape is written once, in the frame it is first drawn. Commands may only use shapes defined up to their frame.
+    std::unordered_set<uint32_t> shape_ids;
+
+    for (uint32_t f = 0; f < header.frame_count; ++f) {
+        CapturedFrame frame{{}, capture.commands.size()};
+        bool complete = take(&frame.header, sizeof(frame.header));
+
+        for (uint32_t s = 0; complete && s < frame.header.shape_count; ++s) {
+            DrawCaptureFormat::Shape shape{};
+            complete = take(&shape, sizeof(shape)) &&
+                       fits((uint64_t) shape.vertex_count * sizeof(Shape::Vertex) + (uint64_t) shape.index_count * sizeof(int));
+
+            std::vector<Shape::Vertex> vertices(complete ? shape.vertex_count : 0);
+            std::vector<int> indices(complete ? shape.index_count : 0);
+            complete = complete && take(vertices.data(), vertices.size() * sizeof(Shape::Vertex)) && take(indices.data(), indices.size() * sizeof(int));
+
+            if (!complete) {
+                break;
+            }
+
+            // Only list modes, the batches append the indices of many shapes into one draw
+            if (shape.gl_render_mode != GL_TRIANGLES && shape.gl_render_mode != GL_LINES && shape.gl_render_mode != GL_POINTS) {
+                fprintf(stderr, "%s has shape %u with unsupported render mode 0x%x in frame %u\n", file_name, shape.id, shape.gl_render_mode, f);
+
+                return std::nullopt;
+            }
+
+            if (std::any_of(indices.begin(), indices.end(), [&shape](int index) { return index < 0 || (uint32_t) index >= shape.vertex_count; })) {
+                fprintf(stderr, "%s has shape %u with an index past its vertices in frame %u\n", file_name, shape.id, f);
+
+                return std::nullopt;
+            }
+
+            shape_ids.insert(shape.id);
+            capture.shapes.push_back(shape);
+            capture.shape_vertices.push_back(std::move(vertices));
+            capture.shape_indices.push_back(std::move(indices));
+        }
+
+        complete = complete && fits((uint64_t) frame.header.command_count * sizeof(DrawCaptureFormat::Command));
+        capture.commands.resize(frame.first_command + (complete ? frame.header.command_count : 0));
+        complete = complete && take(capture.commands.data() + frame.first_command, frame.header.command_count * sizeof(DrawCaptureFormat::Command));
+
+        if (!complete) {
+            fprintf(stderr, "%s is truncated in frame %u\n", file_name, f);
+
+            return std::nullopt;
+        }
+
+        // The replay looks every shape up by id, and draws every texture id with a checker texture made for it
+        for (size_t c = frame.first_command; c < capture.commands.size(); ++c) {
+            if (shape_ids.find(capture.commands[c].shape_id) == shape_ids.end()) {
+                fprintf(stderr, "%s draws shape %u before defining it in frame %u\n", file_name, capture.commands[c].shape_id, f);
+
+                return std::nullopt;
+            }
+        }
+
+        capture.frames.push_back(frame);
+    }
+
+    return capture;
+}
+
+// Checker textures in a color of their own, so the captured textures still differ on replay
+static Texture create_texture(uint32_t captured_id) {
+    std::vector<unsigned char> pixels(REPLAY_TEXTURE_SIZE * REPLAY_TEXTURE_SIZE * 4);
+    const unsigned char color[] = {(unsigned char) (64 + captured_id * 97 % 192), (unsigned char) (64 + captured_id * 59 % 192),
+                                   (unsigned char) (64 + captured_id * 31 % 192)};
+
+    for (size_t y = 0; y < REPLAY_TEXTURE_SIZE; ++y) {
+        for (size_t x = 0; x < REPLAY_TEXTURE_SIZE; ++x) {
+            unsigned char* pixel = &pixels[(y * REPLAY_TEXTURE_SIZE + x) * 4];
+            bool dark = ((x / 8) + (y / 8)) % 2 == 0;
+
+            pixel[0] = dark ? color[0] / 2 : color[0];
+            pixel[1] = dark ? color[1] / 2 : color[1];
+            pixel[2] = dark ? color[2] / 2 : color[2];
+            pixel[3] = 255;
+        }
+    }
+
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, REPLAY_TEXTURE_SIZE, REPLAY_TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    return Texture{texture_id, true};
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = (size_t) (p * (double) (sorted.size() - 1) + 0.5);
+
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void write_report(FILE* out, const ReplayOptions& options, const Capture& capture, std::vector<double> frame_ms, const ReplayStats& stats) {
+    std::sort(frame_ms.begin(), frame_ms.end());
+
+    double total_ms = 0.0;
+    for (double ms: frame_ms) {
+        total_ms += ms;
+    }
+
+    const double mean_ms = total_ms / (double) frame_ms.size();
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"capture\": {\"file\": \"%s\", \"frames\": %zu, \"shapes\": %zu, \"commands\": %zu},\n",
+            options.capture, capture.frames.size(), capture.shapes.size(), capture.commands.size());
+    fprintf(out, "  \"replay\": {\"paced\": %s, \"loops\": %zu, \"wall_ms\": %.3f, \"late_frames\": %zu},\n",
+            options.paced ? "true" : "false", options.loops, stats.wall_ms, stats.late_frames);
+    fprintf(out, "  \"settings\": {\"upload_mode\": \"%s\", \"instancing\": %s, \"multi_draw\": %s, \"depth_test\": %s, \"worker_threads\": %zu},\n",
+            options.settings.upload_mode == UploadMode::PERSISTENT_MAPPED ? "persistent_mapped" : "buffer_sub_data",
+            options.settings.instancing ? "true" : "false", options.settings.multi_draw_indirect ? "true" : "false",
+            options.settings.depth_test ? "true" : "false", options.settings.worker_threads);
+    fprintf(out, "  \"gl_renderer\": \"%s\",\n", (const char*) glGetString(GL_RENDERER));
+    fprintf(out, "  \"frames\": %zu,\n", frame_ms.size());
+    fprintf(out, "  \"frame_ms\": {\"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f},\n",
+            mean_ms, percentile(frame_ms, 0.50), percentile(frame_ms, 0.90), percentile(frame_ms, 0.99), frame_ms.front(), frame_ms.back());
+    fprintf(out, "  \"commands_per_frame\": %.1f,\n", stats.commands);
+    fprintf(out, "  \"culled_per_frame\": %.1f,\n", stats.culled);
+    if (options.settings.count_overdraw) {
+        fprintf(out, "  \"overdraw\": %.3f,\n", stats.overdraw);
+    }
+    fprintf(out, "  \"draws_per_frame\": %.2f\n", stats.draw_calls);
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char* args[]) {
+    ReplayOptions options = parse_options(argc, args);
+
+    if (options.capture == nullptr) {
+        fprintf(stderr, "Pass the capture to replay with --capture=<file>\n");
+
+        return 1;
+    }
+
+    // Read before entering the asset directory, so a relative capture path works as given
+    std::optional<Capture> loaded = load_capture(options.capture);
+    if (!loaded.has_value()) {
+        return 1;
+    }
+
+    const Capture& capture = *loaded;
+
+    // Shaders are loaded relative to the asset directory, like the game does
+    if (options.assets != nullptr && chdir(options.assets) != 0) {
+        fprintf(stderr, "Couldn't enter the asset directory: %s\n", options.assets);
+
+        return 1;
+    }
+
+    // The renderer logs to stdout, it is moved to stderr so a report written to stdout stays parseable
+    FILE* out = stdout;
+    if (options.output != nullptr) {
+        out = fopen(options.output, "w");
+
+        if (out == nullptr) {
+            fprintf(stderr, "Couldn't open %s\n", options.output);
+
+            return 1;
+        }
+    } else {
+        out = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    Offscreen offscreen = create_offscreen();
+
+    Renderer renderer;
+    renderer.init(egl_proc, options.settings);
+    init_framebuffer(offscreen);
+
+    // Every shape of the game draws with the batched program
+    ShaderProgram simple_shader;
+    simple_shader.init("shader/filled_quad.vert", "shader/filled_quad.frag");
+
+    // Created before the replay starts, the renderer keeps pointers to them
+    std::vector<Shape> shapes;
+    std::unordered_map<uint32_t, const Shape*> shapes_by_id;
+    shapes.reserve(capture.shapes.size());
+
+    for (size_t s = 0; s < capture.shapes.size(); ++s) {
+        shapes.push_back(Shape{capture.shapes[s].id, capture.shape_vertices[s], capture.shape_indices[s], simple_shader,
+                               (GLenum) capture.shapes[s].gl_render_mode});
+    }
+
+    for (const Shape& shape: shapes) {
+        shapes_by_id[(uint32_t) shape.id] = &shape;
+    }
+
+    std::unordered_map<uint32_t, Texture> textures;
+    bool sprites = false;
+
+    for (const DrawCaptureFormat::Command& command: capture.commands) {
+        if (command.texture_id != 0 && textures.find(command.texture_id) == textures.end()) {
+            textures.emplace(command.texture_id, create_texture(command.texture_id));
+        }
+
+        sprites = sprites || command.atlas_layer >= 0;
+    }
+
+    // Sprites keep their captured layer and rectangle, the atlas only has to exist
+    TextureAtlas atlas;
+    if (sprites) {
+        const std::vector<unsigned char> white(4 * 4 * 4, 255);
+
+        atlas.init();
+        (void) atlas.add(4, 4, white.data());
+        renderer.set_atlas(&atlas);
+    }
+
+    Camera camera;
+    renderer.set_camera(&camera);
+
+    const auto replay_frame = [&](const CapturedFrame& frame) {
+        camera.set_position(glm::vec2{frame.header.camera_position[0], frame.header.camera_position[1]});
+        camera.set_zoom(frame.header.camera_zoom);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        for (size_t c = frame.first_command; c < frame.first_command + frame.header.command_count; ++c) {
+            const DrawCaptureFormat::Command& command = capture.commands[c];
+            std::optional<Texture> texture;
+
+            if (command.texture_id != 0) {
+                texture = textures.at(command.texture_id);
+            }
+
+            renderer.draw_captured(shapes_by_id.at(command.shape_id), command, texture);
+        }
+
+        renderer.flush();
+
+        // Without a swap nothing waits for the GPU, the frame is only done once it finished drawing
+        glFinish();
+    };
+
+    for (size_t f = 0; f < options.warmup_frames; ++f) {
+        replay_frame(capture.frames[f % capture.frames.size()]);
+    }
+
+    std::vector<double> frame_ms;
+    frame_ms.reserve(capture.frames.size() * options.loops);
+    ReplayStats stats{};
+
+    const uint64_t first_frame_ns = capture.frames.front().header.time_ns;
+    const uint64_t capture_ns = capture.frames.back().header.time_ns - first_frame_ns;
+    const auto replay_start = std::chrono::steady_clock::now();
+
+    for (size_t loop = 0; loop < options.loops; ++loop) {
+        for (size_t f = 0; f < capture.frames.size(); ++f) {
+            const CapturedFrame& frame = capture.frames[f];
+
+            // Every loop starts one captured frame interval after the previous one ended
+            if (options.paced) {
+                const uint64_t frame_ns = frame.header.time_ns - first_frame_ns + loop * (capture_ns + capture_ns / std::max<size_t>(capture.frames.size() - 1, 1));
+                std::this_thread::sleep_until(replay_start + std::chrono::nanoseconds{frame_ns});
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            replay_frame(frame);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            frame_ms.push_back(ms);
+            stats.commands += (double) frame.header.command_count;
+            stats.draw_calls += (double) renderer.last_frame_draw_calls();
+            stats.culled += (double) renderer.last_frame_culled_draws();
+            stats.overdraw += renderer.last_frame_overdraw();
+
+            if (options.paced && f + 1 < capture.frames.size() &&
+                ms * 1.0e6 > (double) (capture.frames[f + 1].header.time_ns - frame.header.time_ns)) {
+                ++stats.late_frames;
+            }
+        }
+    }
+
+    stats.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - replay_start).count();
+    stats.commands /= (double) frame_ms.size();
+    stats.draw_calls /= (double) frame_ms.size();
+    stats.culled /= (double) frame_ms.size();
+    stats.overdraw /= (double) frame_ms.size();
+
+    write_report(out, options, capture, frame_ms, stats);
+    fclose(out);
+
+    for (auto& [_, texture]: textures) {
+        glDeleteTextures(1, &texture.id);
+    }
+
+    destroy_offscreen(offscreen);
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "renderer/Screen.h"
+#include "Offscreen.h"
+
+
+static void offscreen_die(const char* message) {
+    fprintf(stderr, "%s (EGL error 0x%x)\n", message, eglGetError());
+    exit(2);
+}
+
+void* egl_proc(const char* name) {
+    return (void*) eglGetProcAddress(name);
+}
+
+static EGLDisplay open_display() {
+    // Surfaceless needs no X server or DRM master, fall back to the default display where it is missing
+    const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (client_extensions != nullptr && strstr(client_extensions, "EGL_MESA_platform_surfaceless") != nullptr) {
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+        if (get_platform_display != nullptr) {
+            EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+            if (display != EGL_NO_DISPLAY) {
+                return display;
+            }
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+Offscreen create_offscreen() {
+    Offscreen offscreen{};
+
+    offscreen.display = open_display();
+    if (offscreen.display == EGL_NO_DISPLAY || !eglInitialize(offscreen.display, nullptr, nullptr)) {
+        offscreen_die("Couldn't initialize EGL");
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        offscreen_die("Couldn't bind the OpenGL API");
+    }
+
+    const EGLint config_attributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(offscreen.display, config_attributes, &config, 1, &config_count) || config_count == 0) {
+        offscreen_die("No EGL config supports OpenGL");
+    }
+
+    const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 5,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+
+    offscreen.context = eglCreateContext(offscreen.display, config, EGL_NO_CONTEXT, context_attributes);
+    if (offscreen.context == EGL_NO_CONTEXT) {
+        offscreen_die("Couldn't create an OpenGL 4.5 context");
+    }
+
+    // Needs EGL_KHR_surfaceless_context, the renderer draws into its own framebuffer
+    if (!eglMakeCurrent(offscreen.display, EGL_NO_SURFACE, EGL_NO_SURFACE, offscreen.context)) {
+        offscreen_die("Couldn't make the context current without a surface");
+    }
+
+    return offscreen;
+}
+
+void init_framebuffer(Offscreen& offscreen) {
+    glCreateRenderbuffers(1, &offscreen.color_buffer);
+    glNamedRenderbufferStorage(offscreen.color_buffer, GL_RGBA8, Screen::WIDTH, Screen::HEIGHT);
+
+    glCreateRenderbuffers(1, &offscreen.depth_buffer);
+    glNamedRenderbufferStorage(offscreen.depth_buffer, GL_DEPTH_COMPONENT24, Screen::WIDTH, Screen::HEIGHT);
+
+    glCreateFramebuffers(1, &offscreen.framebuffer);
+    glNamedFramebufferRenderbuffer(offscreen.framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen.color_buffer);
+    glNamedFramebufferRenderbuffer(offscreen.framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreen.depth_buffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen.framebuffer);
+
+    if (glCheckNamedFramebufferStatus(offscreen.framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+        exit(2);
+    }
+}
+
+void destroy_offscreen(Offscreen& offscreen) {
+    glDeleteFramebuffers(1, &offscreen.framebuffer);
+    glDeleteRenderbuffers(1, &offscreen.color_buffer);
+    glDeleteRenderbuffers(1, &offscreen.depth_buffer);
+
+    eglMakeCurrent(offscreen.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(offscreen.display, offscreen.context);
+    eglTerminate(offscreen.display);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <glad/glad.h>
+
+
+// Surfaceless EGL context with a framebuffer of the screen size, the headless tools render into it without a window
+struct Offscreen {
+    EGLDisplay display;
+    EGLContext context;
+    GLuint framebuffer;
+    GLuint color_buffer;
+    // The renderer tests opaque draws against it, see RenderSettings::depth_test
+    GLuint depth_buffer;
+};
+
+// Loader for Renderer::init
+void* egl_proc(const char* name);
+
+// Creates the context and makes it current, exits when the machine can not provide one
+Offscreen create_offscreen();
+
+// Needs the GL functions loaded, i.e. the renderer initialized
+void init_framebuffer(Offscreen& offscreen);
+
+void destroy_offscreen(Offscreen& offscreen);
@@ -0,0 +1,822 @@
+#define GLM_FORCE_RADIANS 1
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <glad/glad.h>
+#include <glm/geometric.hpp>
+#include "renderer/Screen.h"
+#include "renderer/Renderer.h"
+#include "renderer/ShapeGenerator.h"
+#include "renderer/TransformKernel.h"
+#include "renderer/AssetPack.h"
+#include "renderer/SpatialGrid.h"
+#include "Offscreen.h"
+
+
+// Renders synthetic scenes into an offscreen framebuffer and reports frame times as JSON. Runs without a window or a
+// display through a surfaceless EGL context, Mesa's llvmpipe is enough when the machine has no GPU.
+//
+//   rtc_bench --quads=20000 --triangles=5000 --textures=8 --tints=16 --rotate --frames=300 > result.json
+//   rtc_bench --quads=0 --tile-map=512 --tile-changes=64 > tiles.json
+//   rtc_bench --quads=1000000 --world=32 --cull-index > culling.json
+//   rtc_bench --quads=0 --labels=5000 --label-changes=100 --font=font/label.ttf > text.json
+//   rtc_bench --quads=0 --ui-widgets=2000 --ui-changes=20 --font=font/label.ttf > ui.json
+//   rtc_bench --quads=200000 --random-depth --tile-map=256 --overdraw [--no-depth-test] > overdraw.json
+//   rtc_bench --quads=100000 --textures=8 --bulk > bulk.json
+//   rtc_bench --quads=20000 --textures=8 --rotate --check-allocations > /dev/null   (built with RTC_COUNT_ALLOCATIONS)
+
+static constexpr const size_t BENCH_TEXTURE_SIZE = 64;
+
+// Tile types of the --tile-map grid
+static constexpr const size_t BENCH_TILE_TYPES = 4;
+static constexpr const float BENCH_TILE_SIZE = 16.0F;
+
+// Pixel height the --font is rasterized at
+static constexpr const float BENCH_FONT_PIXEL_HEIGHT = 16.0F;
+
+// Glyphs a --ui-widgets label holds
+static constexpr const size_t BENCH_UI_LABEL_GLYPHS = 12;
+
+// Cell size of the --cull-index grid, a few times the largest drawable
+static constexpr const float BENCH_INDEX_CELL_SIZE = 128.0F;
+
+// Programs the game links at startup, loaded by the startup comparison
+static constexpr const char* BENCH_PROGRAMS[][2] = {
+        {"shader/filled_quad.vert", "shader/filled_quad.frag"},
+        {"shader/instanced_quad.vert", "shader/filled_quad.frag"}
+};
+
+struct StartupTimes {
+    double loose_ms;
+    double pack_ms;
+    size_t textures;
+    size_t programs;
+};
+
+// Per frame means of the UI layer update, it scales with the changed widgets
+struct UiStats {
+    double update_ms;
+    double widgets_rebuilt;
+    double quads_uploaded;
+};
+
+// Per frame means of the culling work
+struct CullingStats {
+    double submitted;
+    double culled;
+    double index_candidates;
+};
+
+struct BenchOptions {
+    size_t quads = 10000;
+    size_t triangles = 0;
+    // Quads drawn as analytic circles instead, at most quads
+    size_t circles = 0;
+    // Distinct textures the drawables cycle through, zero draws everything untextured
+    size_t textures = 4;
+    // Distinct tint colors the drawables cycle through
+    size_t tints = 8;
+    bool rotate = false;
+    // Every drawable gets a depth of its own instead of all sharing depth 0, so front to back order can hide some
+    bool random_depth = false;
+    // The drawables spread over world x world screens while the camera shows the first one
+    size_t world = 1;
+    // Draws only what a SpatialGrid query finds in the view instead of submitting every drawable
+    bool cull_index = false;
+    // Submits the drawables of every shape and texture as one Renderer::draw_instances() span at depth 0, instead of
+    // one draw call each. Ignores --cull-index, the renderer culls the spans.
+    bool bulk = false;
+    // Exits with 1 when a measured frame made heap allocations in the renderer, needs RTC_COUNT_ALLOCATIONS
+    bool check_allocations = false;
+    // Cells along each side of a tile map drawn below the scene, zero draws none
+    size_t tile_map = 0;
+    // Random cells of the tile map changed every frame
+    size_t tile_changes = 0;
+    // Text labels drawn with --font, their layouts are cached after the first frame
+    size_t labels = 0;
+    // Of those labels, how many change their text every frame and have to be laid out again
+    size_t label_changes = 0;
+    const char* font = nullptr;
+    // Labels of a retained UI layer, drawn with --font
+    size_t ui_widgets = 0;
+    // Of those widgets, how many change their text every frame
+    size_t ui_changes = 0;
+    size_t warmup_frames = 30;
+    size_t frames = 300;
+    uint32_t seed = 1;
+    const char* assets = nullptr;
+    // Pack to compare the startup against the loose files of the asset directory
+    const char* pack = nullptr;
+    // Off by default, a warm program binary cache would hide the compile time of the startup comparison
+    const char* shader_cache = nullptr;
+    const char* output = nullptr;
+    RenderSettings settings;
+};
+
+struct BenchDrawable {
+    const Shape* shape;
+    glm::vec2 position;
+    glm::vec2 scale;
+    float rotation;
+    float rotation_speed;
+    float depth;
+    glm::vec4 tint_color;
+    std::optional<Texture> texture;
+    bool circle;
+};
+
+// The drawables of one --bulk span, their rotation speeds side by side with the instances
+struct BenchGroup {
+    MaterialHandle material;
+    std::vector<DrawInstance> instances;
+    std::vector<float> rotation_speeds;
+};
+
+static bool parse_size(const char* arg, const char* prefix, size_t& value) {
+    size_t length = strlen(prefix);
+    if (strncmp(arg, prefix, length) != 0) {
+        return false;
+    }
+
+    value = strtoul(arg + length, nullptr, 10);
+
+    return true;
+}
+
+static BenchOptions parse_options(int argc, char* args[]) {
+    BenchOptions options;
+    options.settings.worker_threads = std::max(1U, std::thread::hardware_concurrency()) - 1;
+
+    size_t seed = options.seed;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = args[i];
+
+        if (parse_size(arg, "--quads=", options.quads) ||
+            parse_size(arg, "--triangles=", options.triangles) ||
+            parse_size(arg, "--circles=", options.circles) ||
+            parse_size(arg, "--textures=", options.textures) ||
+            parse_size(arg, "--tints=", options.tints) ||
+            parse_size(arg, "--world=", options.world) ||
+            parse_size(arg, "--tile-map=", options.tile_map) ||
+            parse_size(arg, "--tile-changes=", options.tile_changes) ||
+            parse_size(arg, "--labels=", options.labels) ||
+            parse_size(arg, "--label-changes=", options.label_changes) ||
+            parse_size(arg, "--ui-widgets=", options.ui_widgets) ||
+            parse_size(arg, "--ui-changes=", options.ui_changes) ||
+            parse_size(arg, "--warmup=", options.warmup_frames) ||
+            parse_size(arg, "--frames=", options.frames) ||
+            parse_size(arg, "--workers=", options.settings.worker_threads) ||
+            parse_size(arg, "--seed=", seed)) {
+            continue;
+        }
+
+        if (strcmp(arg, "--rotate") == 0) {
+            options.rotate = true;
+        } else if (strcmp(arg, "--random-depth") == 0) {
+            options.random_depth = true;
+        } else if (strcmp(arg, "--no-depth-test") == 0) {
+            options.settings.depth_test = false;
+        } else if (strcmp(arg, "--overdraw") == 0) {
+            options.settings.count_overdraw = true;
+        } else if (strcmp(arg, "--bulk") == 0) {
+            options.bulk = true;
+        } else if (strcmp(arg, "--check-allocations") == 0) {
+#ifdef RTC_COUNT_ALLOCATIONS
+            options.check_allocations = true;
+#else
+            fprintf(stderr, "--check-allocations needs a build with RTC_COUNT_ALLOCATIONS\n");
+            exit(1);
+#endif
+        } else if (strcmp(arg, "--cull-index") == 0) {
+            options.cull_index = true;
+        } else if (strcmp(arg, "--instanced") == 0) {
+            options.settings.instancing = true;
+        } else if (strcmp(arg, "--multi-draw") == 0) {
+            options.settings.multi_draw_indirect = true;
+        } else if (strcmp(arg, "--buffer-sub-data") == 0) {
+            options.settings.upload_mode = UploadMode::BUFFER_SUB_DATA;
+        } else if (strncmp(arg, "--shader-cache=", 15) == 0) {
+            options.shader_cache = arg + 15;
+        } else if (strncmp(arg, "--pack=", 7) == 0) {
+            options.pack = arg + 7;
+        } else if (strncmp(arg, "--font=", 7) == 0) {
+            options.font = arg + 7;
+        } else if (strncmp(arg, "--assets=", 9) == 0) {
+            options.assets = arg + 9;
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            options.output = arg + 6;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            exit(1);
+        }
+    }
+
+    options.seed = (uint32_t) seed;
+    options.frames = std::max<size_t>(options.frames, 1);
+    options.tints = std::max<size_t>(options.tints, 1);
+    options.world = std::max<size_t>(options.world, 1);
+    options.label_changes = std::min(options.label_changes, options.labels);
+    options.ui_changes = std::min(options.ui_changes, options.ui_widgets);
+
+    return options;
+}
+
+// Solid textures with a checker pattern, so samples differ without shipping image files
+static std::vector<Texture> generate_textures(size_t count, std::mt19937& random) {
+    std::vector<Texture> textures;
+    std::vector<unsigned char> pixels(BENCH_TEXTURE_SIZE * BENCH_TEXTURE_SIZE * 4);
+    std::uniform_int_distribution<int> channel{64, 255};
+
+    for (size_t t = 0; t < count; ++t) {
+        const unsigned char color[] = {(unsigned char) channel(random), (unsigned char) channel(random), (unsigned char) channel(random)};
+
+        for (size_t y = 0; y < BENCH_TEXTURE_SIZE; ++y) {
+            for (size_t x = 0; x < BENCH_TEXTURE_SIZE; ++x) {
+                unsigned char* pixel = &pixels[(y * BENCH_TEXTURE_SIZE + x) * 4];
+                bool dark = ((x / 8) + (y / 8)) % 2 == 0;
+
+                pixel[0] = dark ? color[0] / 2 : color[0];
+                pixel[1] = dark ? color[1] / 2 : color[1];
+                pixel[2] = dark ? color[2] / 2 : color[2];
+                pixel[3] = 255;
+            }
+        }
+
+        GLuint texture_id;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, BENCH_TEXTURE_SIZE, BENCH_TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        textures.push_back(Texture{texture_id, true});
+    }
+
+    return textures;
+}
+
+// Fills the map with random tiles of solid atlas sprites
+static void generate_tile_map(TileMap& tile_map, TextureAtlas& atlas, size_t size, std::mt19937& random) {
+    std::vector<unsigned char> pixels(BENCH_TEXTURE_SIZE * BENCH_TEXTURE_SIZE * 4);
+    std::uniform_int_distribution<int> channel{64, 255};
+
+    tile_map.init((int) size, (int) size, BENCH_TILE_SIZE);
+
+    for (size_t t = 0; t < BENCH_TILE_TYPES; ++t) {
+        for (size_t p = 0; p < pixels.size(); p += 4) {
+            pixels[p] = (unsigned char) channel(random);
+            pixels[p + 1] = (unsigned char) channel(random);
+            pixels[p + 2] = (unsigned char) channel(random);
+            pixels[p + 3] = 255;
+        }
+
+        (void) tile_map.add_tile(atlas.add(BENCH_TEXTURE_SIZE, BENCH_TEXTURE_SIZE, pixels.data()).value());
+    }
+
+    std::uniform_int_distribution<int> tile{1, (int) BENCH_TILE_TYPES};
+
+    for (int y = 0; y < tile_map.rows(); ++y) {
+        for (int x = 0; x < tile_map.columns(); ++x) {
+            tile_map.set(x, y, (TileMap::TileId) tile(random));
+        }
+    }
+}
+
+static std::vector<BenchDrawable> generate_scene(const BenchOptions& options, const Shape& quad, const Shape& triangle,
+                                                 const std::vector<Texture>& textures, std::mt19937& random) {
+    std::uniform_real_distribution<float> x{0.0F, (float) (Screen::WIDTH * options.world)};
+    std::uniform_real_distribution<float> y{0.0F, (float) (Screen::HEIGHT * options.world)};
+    std::uniform_real_distribution<float> size{4.0F, 32.0F};
+    std::uniform_real_distribution<float> unit{0.0F, 1.0F};
+    std::uniform_real_distribution<float> speed{-2.0F, 2.0F};
+
+    std::vector<glm::vec4> tints;
+    for (size_t t = 0; t < options.tints; ++t) {
+        tints.emplace_back(unit(random), unit(random), unit(random), 1.0F);
+    }
+
+    std::vector<BenchDrawable> drawables;
+    drawables.reserve(options.quads + options.triangles);
+
+    for (size_t d = 0; d < options.quads + options.triangles; ++d) {
+        BenchDrawable drawable{};
+        drawable.shape = d < options.quads ? &quad : &triangle;
+        drawable.position = glm::vec2{x(random), y(random)};
+        drawable.scale = glm::vec2{size(random), size(random)};
+        drawable.rotation = options.rotate ? unit(random) * 6.2831853F : 0.0F;
+        drawable.rotation_speed = options.rotate ? speed(random) : 0.0F;
+        drawable.depth = options.random_depth ? unit(random) : 0.0F;
+        drawable.tint_color = tints[d % tints.size()];
+        drawable.circle = d < std::min(options.circles, options.quads);
+
+        if (!textures.empty()) {
+            drawable.texture = textures[d % textures.size()];
+        }
+
+        drawables.push_back(drawable);
+    }
+
+    return drawables;
+}
+
+// Groups the drawables by shape, texture and primitive, each group resolves its material once
+static std::vector<BenchGroup> group_scene(Renderer& renderer, const std::vector<BenchDrawable>& drawables, const Shape& quad) {
+    struct GroupKey {
+        const Shape* shape;
+        GLuint texture_id;
+        bool circle;
+    };
+
+    std::vector<GroupKey> keys;
+    std::vector<BenchGroup> groups;
+
+    for (const BenchDrawable& drawable: drawables) {
+        const GroupKey key{drawable.shape, drawable.texture.has_value() ? drawable.texture->id : 0, drawable.circle};
+        auto found = std::find_if(keys.begin(), keys.end(), [&key](const GroupKey& other) {
+            return other.shape == key.shape && other.texture_id == key.texture_id && other.circle == key.circle;
+        });
+
+        if (found == keys.end()) {
+            keys.push_back(key);
+            groups.push_back(BenchGroup{drawable.circle ? renderer.primitive_material(&quad, Primitive{PrimitiveKind::CIRCLE})
+                                                        : renderer.material(drawable.shape, drawable.texture), {}, {}});
+            found = keys.end() - 1;
+        }
+
+        BenchGroup& group = groups[found - keys.begin()];
+        group.instances.push_back(DrawInstance{drawable.position, drawable.scale, drawable.rotation, drawable.tint_color});
+        group.rotation_speeds.push_back(drawable.rotation_speed);
+    }
+
+    return groups;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Where the startup comparison loads the textures and programs from
+enum class StartupSource {
+    LOOSE,
+    PACK
+};
+
+// What a startup child process reports back through its pipe
+struct StartupRun {
+    double ms;
+    size_t textures;
+};
+
+// Loads every texture of the pack and links the startup programs from one source, including finishing the uploads on
+// the GPU. The loose files only use the pack for the names of the textures, opening it is not timed for them.
+static std::optional<StartupRun> load_startup_assets(StartupSource source, const char* pack_file) {
+    std::vector<GLuint> textures;
+
+    auto start = std::chrono::steady_clock::now();
+    AssetPack pack;
+    if (!pack.open(pack_file)) {
+        return std::nullopt;
+    }
+
+    if (source == StartupSource::LOOSE) {
+        start = std::chrono::steady_clock::now();
+    }
+
+    for (const AssetPackFormat::Entry& entry: pack.entries()) {
+        if (entry.type == AssetPackFormat::EntryType::TEXTURE) {
+            textures.push_back(source == StartupSource::PACK ? pack.load_texture(entry.name)->id : Texture::load(entry.name).id);
+        }
+    }
+
+    for (const auto& program: BENCH_PROGRAMS) {
+        ShaderProgram shader_program;
+        if (source == StartupSource::PACK) {
+            shader_program.init_from_sources(pack.shader_source(program[0]), pack.shader_source(program[1]));
+        } else {
+            shader_program.init(program[0], program[1]);
+        }
+        glDeleteProgram(shader_program.id());
+    }
+
+    glFinish();
+    StartupRun run{elapsed_ms(start), textures.size()};
+
+    glDeleteTextures((GLsizei) textures.size(), textures.data());
+
+    return run;
+}
+
+// Times one source in a fresh process with a context of its own and Mesa's shader cache disabled, so neither source
+// links programs the other one already compiled. Has to run before this process creates its context.
+static std::optional<StartupRun> run_startup_process(StartupSource source, const char* pack_file, const char* shader_cache) {
+    int result_pipe[2];
+    if (pipe(result_pipe) != 0) {
+        return std::nullopt;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        close(result_pipe[0]);
+        close(result_pipe[1]);
+
+        return std::nullopt;
+    }
+
+    if (child == 0) {
+        close(result_pipe[0]);
+        setenv("MESA_SHADER_CACHE_DISABLE", "1", 1);
+
+        Offscreen offscreen = create_offscreen();
+        gladLoadGLLoader(egl_proc);
+        Texture::init();
+        ShaderProgram::set_binary_cache(shader_cache);
+
+        std::optional<StartupRun> run = load_startup_assets(source, pack_file);
+        bool written = run.has_value() && write(result_pipe[1], &*run, sizeof(StartupRun)) == (ssize_t) sizeof(StartupRun);
+
+        destroy_offscreen(offscreen);
+        fflush(stdout);
+        _exit(written ? 0 : 1);
+    }
+
+    close(result_pipe[1]);
+    StartupRun run{};
+    bool received = read(result_pipe[0], &run, sizeof(StartupRun)) == (ssize_t) sizeof(StartupRun);
+    close(result_pipe[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return std::nullopt;
+    }
+
+    return run;
+}
+
+// Loads every texture of the pack and links the startup programs, once from the loose files and once from the pack.
+// Drop the OS page cache before the run to measure a truly cold start.
+static std::optional<StartupTimes> measure_startup(const char* pack_file, const char* shader_cache) {
+    std::optional<StartupRun> pack = run_startup_process(StartupSource::PACK, pack_file, shader_cache);
+    std::optional<StartupRun> loose = run_startup_process(StartupSource::LOOSE, pack_file, shader_cache);
+
+    if (!pack.has_value() || !loose.has_value()) {
+        return std::nullopt;
+    }
+
+    return StartupTimes{loose->ms, pack->ms, pack->textures, std::size(BENCH_PROGRAMS)};
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = (size_t) (p * (double) (sorted.size() - 1) + 0.5);
+
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void write_report(FILE* out, const BenchOptions& options, std::vector<double> frame_ms, double submit_ms, double draws_per_frame, double overdraw,
+                         const CullingStats& culling, const FrameArena::Stats& arena, const std::optional<Font::Stats>& text,
+                         const UiStats& ui, const std::optional<StartupTimes>& startup) {
+    std::sort(frame_ms.begin(), frame_ms.end());
+
+    double total_ms = 0.0;
+    for (double ms: frame_ms) {
+        total_ms += ms;
+    }
+
+    const double mean_ms = total_ms / (double) frame_ms.size();
+    const size_t drawables = options.quads + options.triangles;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"scene\": {\"quads\": %zu, \"triangles\": %zu, \"circles\": %zu, \"textures\": %zu, \"tints\": %zu, \"rotate\": %s, \"random_depth\": %s, \"world\": %zu, \"tile_map\": %zu, \"tile_changes\": %zu, \"seed\": %u},\n",
+            options.quads, options.triangles, std::min(options.circles, options.quads), options.textures, options.tints, options.rotate ? "true" : "false",
+            options.random_depth ? "true" : "false", options.world, options.tile_map, options.tile_changes, options.seed);
+    fprintf(out, "  \"settings\": {\"upload_mode\": \"%s\", \"instancing\": %s, \"multi_draw\": %s, \"depth_test\": %s, \"worker_threads\": %zu, \"transform_kernel\": \"%s\"},\n",
+            options.settings.upload_mode == UploadMode::PERSISTENT_MAPPED ? "persistent_mapped" : "buffer_sub_data",
+            options.settings.instancing ? "true" : "false", options.settings.multi_draw_indirect ? "true" : "false",
+            options.settings.depth_test ? "true" : "false", options.settings.worker_threads, TransformKernel::active_name());
+    fprintf(out, "  \"gl_renderer\": \"%s\",\n", (const char*) glGetString(GL_RENDERER));
+    if (startup.has_value()) {
+        fprintf(out, "  \"startup_ms\": {\"loose\": %.3f, \"pack\": %.3f, \"textures\": %zu, \"programs\": %zu},\n",
+                startup->loose_ms, startup->pack_ms, startup->textures, startup->programs);
+    }
+    fprintf(out, "  \"frames\": %zu,\n", frame_ms.size());
+    fprintf(out, "  \"frame_ms\": {\"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f},\n",
+            mean_ms, percentile(frame_ms, 0.50), percentile(frame_ms, 0.90), percentile(frame_ms, 0.99), frame_ms.front(), frame_ms.back());
+    fprintf(out, "  \"submit_ms\": {\"mean\": %.4f, \"bulk\": %s},\n", submit_ms, options.bulk ? "true" : "false");
+    fprintf(out, "  \"culling\": {\"index\": %s, \"submitted\": %.1f, \"culled\": %.1f, \"index_candidates\": %.1f},\n",
+            options.cull_index ? "true" : "false", culling.submitted, culling.culled, culling.index_candidates);
+    fprintf(out, "  \"frame_arena\": {\"capacity\": %zu, \"high_water\": %zu, \"overflow_allocations\": %zu},\n",
+            arena.capacity, arena.high_water, arena.overflow_allocations);
+    if (text.has_value()) {
+        fprintf(out, "  \"text\": {\"labels\": %zu, \"label_changes\": %zu, \"glyphs_rasterized\": %zu, \"glyphs_evicted\": %zu, \"glyphs_dropped\": %zu, \"layouts_built\": %zu, \"layouts_reused\": %zu},\n",
+                options.labels, options.label_changes, text->glyphs_rasterized, text->glyphs_evicted, text->glyphs_dropped, text->layouts_built,
+                text->layouts_reused);
+    }
+    if (options.ui_widgets > 0) {
+        fprintf(out, "  \"ui\": {\"widgets\": %zu, \"changes\": %zu, \"update_ms\": %.4f, \"widgets_rebuilt\": %.1f, \"quads_uploaded\": %.1f},\n",
+                options.ui_widgets, options.ui_changes, ui.update_ms, ui.widgets_rebuilt, ui.quads_uploaded);
+    }
+    if (options.settings.count_overdraw) {
+        fprintf(out, "  \"overdraw\": %.3f,\n", overdraw);
+    }
+    fprintf(out, "  \"draws_per_frame\": %.2f,\n", draws_per_frame);
+    fprintf(out, "  \"drawables_per_frame\": %zu,\n", drawables);
+    fprintf(out, "  \"drawables_per_second\": %.0f\n", (double) drawables * 1000.0 / mean_ms);
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char* args[]) {
+    BenchOptions options = parse_options(argc, args);
+
+    // Shaders are loaded relative to the asset directory, like the game does
+    if (options.assets != nullptr && chdir(options.assets) != 0) {
+        fprintf(stderr, "Couldn't enter the asset directory: %s\n", options.assets);
+
+        return 1;
+    }
+
+    // The renderer logs to stdout, it is moved to stderr so a report written to stdout stays parseable
+    FILE* out = stdout;
+    if (options.output != nullptr) {
+        out = fopen(options.output, "w");
+
+        if (out == nullptr) {
+            fprintf(stderr, "Couldn't open %s\n", options.output);
+
+            return 1;
+        }
+    } else {
+        out = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    // Runs first, the child processes of the comparison must not inherit a context
+    std::optional<StartupTimes> startup;
+    if (options.pack != nullptr) {
+        startup = measure_startup(options.pack, options.shader_cache);
+
+        if (!startup.has_value()) {
+            fprintf(stderr, "Couldn't measure the startup with the asset pack %s\n", options.pack);
+
+            return 1;
+        }
+    }
+
+    Offscreen offscreen = create_offscreen();
+
+    ShaderProgram::set_binary_cache(options.shader_cache);
+
+    Renderer renderer;
+    renderer.init(egl_proc, options.settings);
+    init_framebuffer(offscreen);
+
+    std::mt19937 random{options.seed};
+
+    ShaderProgram simple_shader;
+    simple_shader.init("shader/filled_quad.vert", "shader/filled_quad.frag");
+
+    Shape quad = ShapeGenerator::generate_quad(0, simple_shader);
+    Shape triangle = ShapeGenerator::generate_triangle(1, simple_shader);
+
+    std::vector<Texture> textures = generate_textures(options.textures, random);
+    std::vector<BenchDrawable> drawables = generate_scene(options, quad, triangle, textures, random);
+
+    std::vector<BenchGroup> groups;
+    if (options.bulk) {
+        groups = group_scene(renderer, drawables, quad);
+    }
+
+    TextureAtlas atlas;
+    TileMap tile_map;
+    std::uniform_int_distribution<int> tile_cell{0, std::max((int) options.tile_map, 1) - 1};
+    std::uniform_int_distribution<int> tile_type{1, (int) BENCH_TILE_TYPES};
+
+    if (options.tile_map > 0) {
+        atlas.init();
+        generate_tile_map(tile_map, atlas, options.tile_map, random);
+        renderer.set_atlas(&atlas);
+    }
+
+    // Labels spread over the world like the drawables, the changing ones show a new number every frame
+    Font font;
+    std::vector<std::string> label_texts;
+    std::vector<glm::vec2> label_positions;
+
+    if (options.labels > 0 || options.ui_widgets > 0) {
+        if (options.font == nullptr || !font.init(options.font, BENCH_FONT_PIXEL_HEIGHT)) {
+            fprintf(stderr, "--labels and --ui-widgets need a TrueType font, pass one with --font=<file>\n");
+
+            return 1;
+        }
+
+    }
+
+    if (options.labels > 0) {
+        std::uniform_real_distribution<float> label_x{0.0F, (float) (Screen::WIDTH * options.world)};
+        std::uniform_real_distribution<float> label_y{0.0F, (float) (Screen::HEIGHT * options.world)};
+
+        for (size_t l = 0; l < options.labels; ++l) {
+            label_texts.push_back("Lot " + std::to_string(l));
+            label_positions.emplace_back(label_x(random), label_y(random));
+        }
+    }
+
+    // Labels in a grid over the screen, the changing ones are spread over the layer so their uploads do not coalesce
+    UiLayer ui;
+    std::vector<UiLayer::WidgetId> ui_labels;
+    char ui_text[BENCH_UI_LABEL_GLYPHS + 1];
+
+    if (options.ui_widgets > 0) {
+        ui.init();
+
+        const auto columns = (size_t) (Screen::WIDTH / (BENCH_UI_LABEL_GLYPHS * BENCH_FONT_PIXEL_HEIGHT * 0.6F));
+
+        for (size_t w = 0; w < options.ui_widgets; ++w) {
+            const glm::vec2 position{(float) (w % columns) * (float) Screen::WIDTH / (float) columns, (float) (w / columns % 40) * BENCH_FONT_PIXEL_HEIGHT};
+            ui_labels.push_back(ui.add_label(&font, position, BENCH_UI_LABEL_GLYPHS));
+
+            snprintf(ui_text, sizeof(ui_text), "W%zu", w);
+            ui.set_text(ui_labels.back(), ui_text);
+        }
+    }
+
+    UiStats ui_stats{};
+
+    // Rotating drawables are indexed by the circle they sweep, like the renderer culls them
+    SpatialGrid index;
+    std::vector<SpatialGrid::ObjectId> visible;
+
+    if (options.cull_index) {
+        index.init(glm::vec2{0.0F, 0.0F}, glm::vec2{(float) (Screen::WIDTH * options.world), (float) (Screen::HEIGHT * options.world)}, BENCH_INDEX_CELL_SIZE);
+
+        for (const BenchDrawable& drawable: drawables) {
+            const float radius = glm::length(drawable.scale);
+            (void) index.insert(drawable.position - radius, drawable.position + radius);
+        }
+
+        visible.reserve(drawables.size());
+    }
+
+    CullingStats culling{};
+
+    std::vector<double> frame_ms;
+    frame_ms.reserve(options.frames);
+    size_t draw_calls = 0;
+    double overdraw = 0.0;
+    double submit_ms = 0.0;
+    size_t allocating_frames = 0;
+    size_t max_frame_allocations = 0;
+
+    for (size_t frame = 0; frame < options.warmup_frames + options.frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (options.tile_map > 0) {
+            for (size_t c = 0; c < options.tile_changes; ++c) {
+                tile_map.set(tile_cell(random), tile_cell(random), (TileMap::TileId) tile_type(random));
+            }
+
+            renderer.draw_tile_map(&tile_map);
+        }
+
+        auto submit = [&renderer](BenchDrawable& drawable) {
+            drawable.rotation += drawable.rotation_speed * (1.0F / 60.0F);
+
+            if (drawable.circle) {
+                renderer.draw_primitive(drawable.shape, Primitive{PrimitiveKind::CIRCLE}, drawable.position, drawable.scale, drawable.rotation, drawable.tint_color,
+                                        0, drawable.depth);
+            } else {
+                renderer.draw(drawable.shape, drawable.position, drawable.scale, drawable.rotation, drawable.tint_color, drawable.texture, 0, drawable.depth);
+            }
+        };
+
+        for (size_t l = 0; l < label_texts.size(); ++l) {
+            if (l < options.label_changes) {
+                label_texts[l] = "$" + std::to_string(frame * 7 + l);
+            }
+
+            renderer.draw_text(&quad, &font, label_texts[l], label_positions[l]);
+        }
+
+        if (options.ui_widgets > 0) {
+            const size_t stride = options.ui_widgets / std::max<size_t>(options.ui_changes, 1);
+
+            for (size_t c = 0; c < options.ui_changes; ++c) {
+                snprintf(ui_text, sizeof(ui_text), "%zu", frame * 31 + c);
+                ui.set_text(ui_labels[c * stride], ui_text);
+            }
+
+            // Updated here to be timed on its own, the update of the flush then finds nothing dirty
+            auto ui_start = std::chrono::steady_clock::now();
+            ui.update();
+
+            if (frame >= options.warmup_frames) {
+                ui_stats.update_ms += elapsed_ms(ui_start);
+                ui_stats.widgets_rebuilt += (double) ui.last_update_stats().widgets_rebuilt;
+                ui_stats.quads_uploaded += (double) ui.last_update_stats().quads_uploaded;
+            }
+
+            renderer.draw_ui(&ui);
+        }
+
+        size_t submitted = drawables.size();
+        auto submit_start = std::chrono::steady_clock::now();
+
+        if (options.bulk) {
+            for (BenchGroup& group: groups) {
+                for (size_t i = 0; i < group.instances.size(); ++i) {
+                    group.instances[i].rotation += group.rotation_speeds[i] * (1.0F / 60.0F);
+                }
+
+                renderer.draw_instances(group.material, group.instances);
+            }
+        } else if (options.cull_index) {
+            visible.clear();
+            index.query(glm::vec2{0.0F, 0.0F}, glm::vec2{(float) Screen::WIDTH, (float) Screen::HEIGHT}, visible);
+
+            for (SpatialGrid::ObjectId id: visible) {
+                submit(drawables[id]);
+            }
+
+            submitted = visible.size();
+        } else {
+            for (BenchDrawable& drawable: drawables) {
+                submit(drawable);
+            }
+        }
+
+        const double frame_submit_ms = elapsed_ms(submit_start);
+
+        renderer.flush();
+
+        // Without a swap nothing waits for the GPU, the frame is only done once it finished drawing
+        glFinish();
+
+        auto end = std::chrono::steady_clock::now();
+
+        if (frame >= options.warmup_frames) {
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            submit_ms += frame_submit_ms;
+            draw_calls += renderer.last_frame_draw_calls();
+            allocating_frames += renderer.last_frame_allocations() != 0 ? 1 : 0;
+            max_frame_allocations = std::max(max_frame_allocations, renderer.last_frame_allocations());
+            overdraw += renderer.last_frame_overdraw();
+            culling.submitted += (double) submitted;
+            culling.culled += (double) renderer.last_frame_culled_draws();
+            culling.index_candidates += (double) index.last_query_stats().candidates;
+        }
+    }
+
+    culling.submitted /= (double) frame_ms.size();
+    culling.culled /= (double) frame_ms.size();
+    culling.index_candidates /= (double) frame_ms.size();
+    ui_stats.update_ms /= (double) frame_ms.size();
+    ui_stats.widgets_rebuilt /= (double) frame_ms.size();
+    ui_stats.quads_uploaded /= (double) frame_ms.size();
+
+    std::optional<Font::Stats> text;
+    if (options.labels > 0) {
+        text = font.font_stats();
+    }
+
+    write_report(out, options, frame_ms, submit_ms / (double) frame_ms.size(), (double) draw_calls / (double) frame_ms.size(), overdraw / (double) frame_ms.size(), culling, renderer.frame_arena_stats(), text, ui_stats, startup);
+    fclose(out);
+
+    for (Texture& texture: textures) {
+        glDeleteTextures(1, &texture.id);
+    }
+
+    if (options.tile_map > 0) {
+        tile_map.shutdown();
+    }
+
+    if (options.ui_widgets > 0) {
+        ui.shutdown();
+    }
+
+    if (options.labels > 0 || options.ui_widgets > 0) {
+        font.shutdown();
+    }
+
+    destroy_offscreen(offscreen);
+
+    // The warmup frames grow the frame memory, every measured frame after them has to reuse it
+    if (options.check_allocations && allocating_frames > 0) {
+        fprintf(stderr, "%zu of %zu measured frames made heap allocations in the renderer, up to %zu in one frame\n",
+                allocating_frames, frame_ms.size(), max_frame_allocations);
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#define GLM_FORCE_RADIANS 1
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <glm/ext/matrix_transform.hpp>
+#include "renderer/TransformKernel.h"
+
+
+// Checks every transform kernel this CPU can run against the per drawable transform the batches used before the
+// kernels existed. Exits with 1 on a mismatch, run it after touching TransformKernel.
+//
+//   rtc_kernel_check
+
+// Odd count so the scalar tail of the vector kernels is exercised as well
+static constexpr const size_t CHECK_DRAWABLES = 1003;
+// Relative to the magnitude of the position, the matrix rounds in another order than the kernels
+static constexpr const float CHECK_EPSILON = 1e-5F;
+
+struct CheckTransform {
+    glm::vec2 position;
+    float rotation;
+    glm::vec2 scale;
+};
+
+// Translate * Rotate(z) * Scale as a full matrix applied to every vertex, one drawable at a time
+static void reference_transform(const CheckTransform& transform, std::span<const Shape::Vertex> shape_vertices, std::vector<glm::vec2>& out) {
+    glm::mat4 transformation_matrix = glm::mat4{1.0F};
+    transformation_matrix = glm::translate(transformation_matrix, glm::vec3{transform.position.x, transform.position.y, 0.0F});
+    transformation_matrix = glm::rotate(transformation_matrix, transform.rotation, glm::vec3{0.0F, 0.0F, 1.0F});
+    transformation_matrix = glm::scale(transformation_matrix, glm::vec3{transform.scale.x, transform.scale.y, 1.0F});
+
+    for (const Shape::Vertex& vertex: shape_vertices) {
+        const glm::vec4 position = transformation_matrix * glm::vec4{vertex.points.x, vertex.points.y, 0.0F, 1.0F};
+
+        out.push_back(glm::vec2{position.x, position.y});
+    }
+}
+
+struct CheckedKernel {
+    TransformKernel::Function function;
+    const char* name;
+};
+
+int main() {
+    const Shape::Vertex shape_vertices[] = {
+            {{0.0F, 0.0F}, {0.0F, 0.0F}},
+            {{1.0F, 0.0F}, {1.0F, 0.0F}},
+            {{0.5F, 1.0F}, {0.5F, 1.0F}},
+            {{1.0F, 1.0F}, {1.0F, 1.0F}}
+    };
+    const size_t vertex_count = std::size(shape_vertices);
+
+    std::vector<CheckTransform> transforms(CHECK_DRAWABLES);
+    for (size_t d = 0; d < CHECK_DRAWABLES; ++d) {
+        transforms[d] = CheckTransform{
+                glm::vec2{(float) (d % 97) * 13.25F - 200.0F, (float) (d % 89) * 7.5F + 3.0F},
+                (float) d * 0.1F,
+                glm::vec2{1.0F + (float) (d % 7) * 16.0F, 0.5F + (float) (d % 5) * 32.0F}
+        };
+    }
+
+    // Drawable major, as the batches wrote the vertices
+    std::vector<glm::vec2> expected;
+    expected.reserve(CHECK_DRAWABLES * vertex_count);
+    for (const CheckTransform& transform: transforms) {
+        reference_transform(transform, shape_vertices, expected);
+    }
+
+    // The streams the render buffers fill for the kernels
+    std::vector<float> position_x(CHECK_DRAWABLES), position_y(CHECK_DRAWABLES), scale_x(CHECK_DRAWABLES), scale_y(CHECK_DRAWABLES);
+    std::vector<float> rotation_cos(CHECK_DRAWABLES), rotation_sin(CHECK_DRAWABLES);
+    for (size_t d = 0; d < CHECK_DRAWABLES; ++d) {
+        position_x[d] = transforms[d].position.x;
+        position_y[d] = transforms[d].position.y;
+        scale_x[d] = transforms[d].scale.x;
+        scale_y[d] = transforms[d].scale.y;
+        rotation_cos[d] = std::cos(transforms[d].rotation);
+        rotation_sin[d] = std::sin(transforms[d].rotation);
+    }
+
+    const TransformKernel::TransformStreams streams{
+            position_x.data(), position_y.data(), scale_x.data(), scale_y.data(), rotation_cos.data(), rotation_sin.data(), CHECK_DRAWABLES
+    };
+
+    std::vector<CheckedKernel> kernels{{TransformKernel::transform_scalar, "Scalar"}};
+    if (TransformKernel::supports_sse2()) {
+        kernels.push_back(CheckedKernel{TransformKernel::transform_sse2, "SSE2"});
+    }
+    if (TransformKernel::supports_avx2()) {
+        kernels.push_back(CheckedKernel{TransformKernel::transform_avx2, "AVX2"});
+    }
+
+    std::vector<float> actual_x(CHECK_DRAWABLES * vertex_count), actual_y(CHECK_DRAWABLES * vertex_count);
+    bool passed = true;
+    for (const CheckedKernel& kernel: kernels) {
+        kernel.function(streams, std::span{shape_vertices}, actual_x.data(), actual_y.data());
+
+        size_t mismatches = 0;
+        for (size_t d = 0; d < CHECK_DRAWABLES; ++d) {
+            for (size_t v = 0; v < vertex_count; ++v) {
+                // The kernels write vertex major
+                const glm::vec2 expected_position = expected[d * vertex_count + v];
+                const size_t actual_index = v * CHECK_DRAWABLES + d;
+
+                const float tolerance = CHECK_EPSILON * std::max({1.0F, std::fabs(expected_position.x), std::fabs(expected_position.y)});
+
+                if (std::fabs(actual_x[actual_index] - expected_position.x) > tolerance ||
+                    std::fabs(actual_y[actual_index] - expected_position.y) > tolerance) {
+                    ++mismatches;
+                }
+            }
+        }
+
+        printf("%-6s : %s (%zu of %zu vertices differ)\n", kernel.name, mismatches == 0 ? "ok" : "FAILED", mismatches, expected.size());
+        passed = passed && mismatches == 0;
+    }
+
+    printf("Selected kernel : %s\n", TransformKernel::active_name());
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cmath>
+#include "Simulation.h"
+
+
+float SimulationSnapshot::blend(std::chrono::steady_clock::time_point frame_time, double tick_seconds) const {
+    const double since_tick = std::chrono::duration<double>(frame_time - time).count();
+
+    return (float) std::clamp(since_tick / tick_seconds, 0.0, 1.0);
+}
+
+Simulation::~Simulation() {
+    shutdown();
+}
+
+void Simulation::init(size_t vehicle_count, float city_extent_, float street_spacing_, double tick_rate, double tick_load_) {
+    shutdown();
+
+    this->city_extent = city_extent_;
+    this->street_spacing = street_spacing_;
+    this->tick_seconds = 1.0 / tick_rate;
+    this->tick_load = tick_load_;
+
+    const int streets = std::max((int) (city_extent / street_spacing), 1);
+    std::uniform_int_distribution<int> street{0, streets};
+    std::uniform_real_distribution<float> along{0.0F, city_extent};
+    std::uniform_real_distribution<float> speed{20.0F, 80.0F};
+    std::uniform_int_distribution<int> heading{0, 3};
+
+    static constexpr const glm::vec2 DIRECTIONS[] = {{1.0F, 0.0F}, {-1.0F, 0.0F}, {0.0F, 1.0F}, {0.0F, -1.0F}};
+
+    vehicles.clear();
+    vehicles.reserve(vehicle_count);
+
+    for (size_t v = 0; v < vehicle_count; ++v) {
+        const glm::vec2 direction = DIRECTIONS[heading(random)];
+        const float street_position = (float) street(random) * street_spacing;
+
+        // Vehicles driving along x sit on a horizontal street and the other way round
+        const glm::vec2 position = direction.x != 0.0F ? glm::vec2{along(random), street_position} : glm::vec2{street_position, along(random)};
+
+        vehicles.push_back(Vehicle{position, position, direction, speed(random)});
+    }
+
+    // Every buffer holds room for all vehicles, publishing never allocates
+    snapshots.for_each_buffer([vehicle_count](SimulationSnapshot& snapshot) {
+        snapshot.previous_positions.reserve(vehicle_count);
+        snapshot.positions.reserve(vehicle_count);
+    });
+
+    ticks = 0;
+    skipped_ticks = 0;
+    running = true;
+    thread = std::thread{&Simulation::run, this};
+}
+
+void Simulation::shutdown() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    thread.join();
+}
+
+const SimulationSnapshot& Simulation::latest_snapshot() {
+    (void) snapshots.acquire();
+
+    return snapshots.read_buffer();
+}
+
+void Simulation::run() {
+    using Clock = std::chrono::steady_clock;
+
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tick_seconds));
+    Clock::time_point next_tick = Clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        const Clock::time_point now = Clock::now();
+
+        if (now < next_tick) {
+            std::this_thread::sleep_until(next_tick);
+            continue;
+        }
+
+        // Behind by more than the catch up allows, the backlog is dropped and the simulation runs slower than real time
+        if (now - next_tick > interval * SIMULATION_MAX_CATCH_UP_TICKS) {
+            skipped_ticks.fetch_add((uint64_t) ((now - next_tick) / interval), std::memory_order_relaxed);
+            next_tick = now;
+        }
+
+        const Clock::time_point tick_start = Clock::now();
+        tick();
+        last_tick_nanoseconds.store((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - tick_start).count(),
+                                    std::memory_order_relaxed);
+
+        next_tick += interval;
+        publish(next_tick - interval);
+        ticks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Simulation::tick() {
+    const auto step = (float) tick_seconds;
+
+    for (Vehicle& vehicle: vehicles) {
+        const glm::vec2 previous = vehicle.position;
+        vehicle.previous_position = previous;
+        vehicle.position += vehicle.direction * vehicle.speed * step;
+
+        // Turns back at the edge of the city instead of jumping across, which could not be interpolated
+        if (vehicle.position.x < 0.0F || vehicle.position.x > city_extent || vehicle.position.y < 0.0F || vehicle.position.y > city_extent) {
+            vehicle.position = previous;
+            vehicle.direction = -vehicle.direction;
+
+            continue;
+        }
+
+        // Crossing a street, turns onto it now and then
+        const glm::vec2 previous_street = glm::floor(previous / street_spacing);
+        const glm::vec2 street = glm::floor(vehicle.position / street_spacing);
+
+        if (previous_street != street && random() % 4 == 0) {
+            const glm::vec2 crossing = glm::max(previous_street, street) * street_spacing;
+
+            if (vehicle.direction.x != 0.0F) {
+                vehicle.position.x = crossing.x;
+                vehicle.direction = glm::vec2{0.0F, random() % 2 == 0 ? 1.0F : -1.0F};
+            } else {
+                vehicle.position.y = crossing.y;
+                vehicle.direction = glm::vec2{random() % 2 == 0 ? 1.0F : -1.0F, 0.0F};
+            }
+        }
+    }
+
+    // Stands in for game logic heavier than the traffic
+    if (tick_load > 0.0) {
+        const auto busy_until = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(tick_load);
+
+        while (std::chrono::steady_clock::now() < busy_until) {
+        }
+    }
+}
+
+void Simulation::publish(std::chrono::steady_clock::time_point time) {
+    SimulationSnapshot& snapshot = snapshots.write_buffer();
+
+    // The write buffer is a recycled snapshot a few ticks old, both arrays are overwritten
+    snapshot.previous_positions.resize(vehicles.size());
+    snapshot.positions.resize(vehicles.size());
+
+    for (size_t v = 0; v < vehicles.size(); ++v) {
+        snapshot.previous_positions[v] = vehicles[v].previous_position;
+        snapshot.positions[v] = vehicles[v].position;
+    }
+
+    snapshot.tick = ticks.load(std::memory_order_relaxed) + 1;
+    snapshot.time = time;
+
+    snapshots.publish();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+#include "TripleBuffer.h"
+
+
+// Ticks per second unless the simulation is started with another rate
+static constexpr const double SIMULATION_TICK_RATE = 30.0;
+
+// Ticks run back to back at most to catch up after a stall, time beyond that is dropped instead of spiraling
+static constexpr const size_t SIMULATION_MAX_CATCH_UP_TICKS = 5;
+
+// Renderable state of the simulation after a tick. It holds the state before the tick as well, so the render thread
+// can interpolate over the tick from a single snapshot.
+struct SimulationSnapshot {
+    uint64_t tick = 0;
+    // When the tick was due, the state is current from then on
+    std::chrono::steady_clock::time_point time;
+    std::vector<glm::vec2> previous_positions;
+    std::vector<glm::vec2> positions;
+
+    // Blend factor between the previous and the current positions for a frame drawn at frame_time
+    [[nodiscard]] float blend(std::chrono::steady_clock::time_point frame_time, double tick_seconds) const;
+};
+
+// Moves the vehicles of the city at a fixed timestep on its own thread, independent of the frame rate. Every tick
+// publishes a snapshot through a triple buffer, the render thread picks up the newest one whenever it draws. A slow
+// frame never holds back the simulation and a slow tick never holds back the frames.
+class Simulation {
+public:
+    Simulation() : vehicles {}, snapshots {}, tick_seconds { 1.0 / SIMULATION_TICK_RATE }, tick_load { 0.0 }, city_extent { 0.0F },
+                   street_spacing { 0.0F }, random { 1 }, thread {}, running { false }, ticks { 0 }, skipped_ticks { 0 },
+                   last_tick_nanoseconds { 0 } {
+
+    }
+
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+
+    Simulation& operator=(const Simulation&) = delete;
+
+    // Places vehicle_count vehicles on the streets, a grid street_spacing_ apart over [0, city_extent_]^2, and starts
+    // ticking. tick_load_ milliseconds of busy work are added to every tick to see how the two threads behave under load.
+    void init(size_t vehicle_count, float city_extent_, float street_spacing_, double tick_rate = SIMULATION_TICK_RATE, double tick_load_ = 0.0);
+
+    void shutdown();
+
+    // Render thread side. The newest snapshot, empty until the first tick finished.
+    const SimulationSnapshot& latest_snapshot();
+
+    [[nodiscard]] double tick_interval() const {
+        return tick_seconds;
+    }
+
+    // Ticks since start, the rate is observed by sampling it
+    [[nodiscard]] uint64_t tick_count() const {
+        return ticks.load(std::memory_order_relaxed);
+    }
+
+    // Ticks dropped because the simulation fell too far behind
+    [[nodiscard]] uint64_t skipped_tick_count() const {
+        return skipped_ticks.load(std::memory_order_relaxed);
+    }
+
+    // Time the last tick took to compute
+    [[nodiscard]] double last_tick_ms() const {
+        return (double) last_tick_nanoseconds.load(std::memory_order_relaxed) / 1e6;
+    }
+
+private:
+    struct Vehicle {
+        glm::vec2 position;
+        // Position before the last tick, published with the current one for interpolation
+        glm::vec2 previous_position;
+        // Unit step along one of the axes
+        glm::vec2 direction;
+        float speed;
+    };
+
+    void run();
+
+    void tick();
+
+    void publish(std::chrono::steady_clock::time_point time);
+
+private:
+    // Only touched by the simulation thread once started
+    std::vector<Vehicle> vehicles;
+    TripleBuffer<SimulationSnapshot> snapshots;
+
+    double tick_seconds;
+    double tick_load;
+    float city_extent;
+    float street_spacing;
+    std::mt19937 random;
+
+    std::thread thread;
+    std::atomic<bool> running;
+
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> skipped_ticks;
+    std::atomic<uint64_t> last_tick_nanoseconds;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+// Hands values from one writer thread to one reader thread without locks. The writer fills its back buffer and
+// publishes it, the reader acquires the newest published one. Neither side ever waits for the other, a value the
+// reader did not pick up in time is simply replaced by the next one.
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : buffers {}, back { 0 }, middle { 1 }, front { 2 } {
+
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Calls function on all three buffers, only while neither thread is using them yet, e.g. to reserve their storage
+    template<typename F>
+    void for_each_buffer(F function) {
+        for (T& buffer: buffers) {
+            function(buffer);
+        }
+    }
+
+    // Writer side, the buffer is only the writer's until publish()
+    T& write_buffer() {
+        return buffers[back];
+    }
+
+    // Makes the back buffer the newest value and takes over the buffer the reader did not pick up, if any. That buffer
+    // holds an older value, the writer has to overwrite all of it.
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side, switches to the newest published value. False when nothing was published since the last call.
+    bool acquire() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+
+        return true;
+    }
+
+    // The value of the last successful acquire(), stays valid until the next one
+    const T& read_buffer() const {
+        return buffers[front];
+    }
+
+private:
+    // The middle buffer index and whether the reader has seen it are swapped together
+    static constexpr const uint8_t INDEX = 0x3;
+    static constexpr const uint8_t FRESH = 0x4;
+
+    std::array<T, 3> buffers;
+    uint8_t back;
+    std::atomic<uint8_t> middle;
+    uint8_t front;
+};
@@ -2,11 +2,24 @@
 #define SDL_MAIN_HANDLED
 
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 #include "renderer/Screen.h"
 #include "renderer/Renderer.h"
 #include "renderer/ShapeGenerator.h"
+#include "renderer/Profiler.h"
+#include "renderer/TextureStreamer.h"
+#include "renderer/AssetPack.h"
+#include "renderer/SpatialGrid.h"
+#include "game/Simulation.h"
 
 
 // Globals
@@ -14,12 +27,41 @@ static SDL_Window* window = nullptr;
 static SDL_GLContext main_context;
 // =======
 
+// Cells along each side of the city grid
+static constexpr const int CITY_SIZE = 512;
+static constexpr const float CITY_CELL_SIZE = 16.0F;
+
+// Buildings scattered over the city, found through the spatial index instead of drawing all of them
+static constexpr const size_t CITY_BUILDINGS = 50000;
+static constexpr const float CITY_INDEX_CELL_SIZE = 256.0F;
+
+// Screen pixels moved per key press and zoom factor per mouse wheel step
+static constexpr const float CAMERA_PAN_STEP = 64.0F;
+static constexpr const float CAMERA_ZOOM_STEP = 1.1F;
+
+// Traffic moved by the simulation thread, vehicles drive along a street every STREET_CELLS cells
+static constexpr const size_t CITY_VEHICLES = 4000;
+static constexpr const int STREET_CELLS = 8;
+static constexpr const float VEHICLE_SIZE = 6.0F;
+
+// District names drawn over the city, one district per DISTRICT_SIZE^2 cells
+static constexpr const int DISTRICT_SIZE = 64;
+static constexpr const char* LABEL_FONT = "font/label.ttf";
+static constexpr const float LABEL_PIXEL_HEIGHT = 32.0F;
+static constexpr const float LABEL_SCALE = 2.0F;
+
+// Terminal in the bottom left corner of the screen, a retained UI layer rebuilt only where its text changes
+static constexpr const float TERMINAL_PIXEL_HEIGHT = 16.0F;
+static constexpr const size_t TERMINAL_LINES = 5;
+static constexpr const size_t TERMINAL_COLUMNS = 64;
+static constexpr const float TERMINAL_MARGIN = 12.0F;
+
+// Frames recorded by --trace=<file>
+static constexpr const size_t TRACE_FRAMES = 120;
+
 // TODO:
 // ============
-// TODO: Figure out how to do performant circle drawing with triangles and without fragment shader
 // TODO: Port the stage area from the other project to this game.
-// TODO: Add text rendering.
-// TODO: Create a simple UI for the terminal.
 // ============
 
 static void sdl_die(const char* message) {
@@ -39,6 +81,8 @@ void init_screen() {
     SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+    // Opaque draws are depth tested, see RenderSettings::depth_test
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
     // Request a debug context.
     SDL_GL_SetAttribute(
             SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG
@@ -84,6 +128,26 @@ void postinit_screen() {
     printf("\n");
 }
 
+// Sprite pixels come straight from the mapped pack when it holds the sprite, from the loose file otherwise
+static AtlasSprite add_sprite(TextureAtlas& atlas, const AssetPack& pack, const char* file_name) {
+    if (const AssetPackFormat::Entry* entry = pack.find(file_name)) {
+        return atlas.add((int) entry->width, (int) entry->height, pack.mip_level(*entry, 0).data()).value();
+    }
+
+    return atlas.add(file_name).value();
+}
+
+static void init_shader(ShaderProgram& shader_program, const AssetPack& pack, const char* vertex_shader_file, const char* fragment_shader_file) {
+    std::string_view vertex_shader_source = pack.shader_source(vertex_shader_file);
+    std::string_view fragment_shader_source = pack.shader_source(fragment_shader_file);
+
+    if (!vertex_shader_source.empty() && !fragment_shader_source.empty()) {
+        shader_program.init_from_sources(vertex_shader_source, fragment_shader_source);
+    } else {
+        shader_program.init(vertex_shader_file, fragment_shader_file);
+    }
+}
+
 void destroy_screen() {
     SDL_Quit();
 }
@@ -91,17 +155,83 @@ void destroy_screen() {
 int main(int argc, char* args[]) {
     init_screen();
 
+    RenderSettings render_settings;
+    const char* trace_path = nullptr;
+    const char* pack_path = nullptr;
+    const char* capture_path = nullptr;
+    double tick_rate = SIMULATION_TICK_RATE;
+    double simulation_load = 0.0;
+    double render_load = 0.0;
+    render_settings.worker_threads = std::max(1U, std::thread::hardware_concurrency()) - 1;
+
+    // Allows comparing frame times between the render paths
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(args[i], "--buffer-sub-data") == 0) {
+            render_settings.upload_mode = UploadMode::BUFFER_SUB_DATA;
+        } else if (strcmp(args[i], "--instanced") == 0) {
+            render_settings.instancing = true;
+        } else if (strcmp(args[i], "--multi-draw") == 0) {
+            render_settings.multi_draw_indirect = true;
+        } else if (strcmp(args[i], "--no-depth-test") == 0) {
+            render_settings.depth_test = false;
+        } else if (strcmp(args[i], "--overdraw") == 0) {
+            render_settings.count_overdraw = true;
+        } else if (strncmp(args[i], "--workers=", 10) == 0) {
+            render_settings.worker_threads = strtoul(args[i] + 10, nullptr, 10);
+        } else if (strncmp(args[i], "--trace=", 8) == 0) {
+            trace_path = args[i] + 8;
+        } else if (strncmp(args[i], "--pack=", 7) == 0) {
+            pack_path = args[i] + 7;
+        } else if (strncmp(args[i], "--capture=", 10) == 0) {
+            capture_path = args[i] + 10;
+        } else if (strncmp(args[i], "--tick-rate=", 12) == 0) {
+            tick_rate = std::max(strtod(args[i] + 12, nullptr), 1.0);
+        } else if (strncmp(args[i], "--sim-load=", 11) == 0) {
+            // Milliseconds of busy work per tick or frame, shows that each side holds its rate while the other one stalls
+            simulation_load = strtod(args[i] + 11, nullptr);
+        } else if (strncmp(args[i], "--render-load=", 14) == 0) {
+            render_load = strtod(args[i] + 14, nullptr);
+        }
+    }
+
     Renderer renderer;
-    renderer.init(SDL_GL_GetProcAddress);
+    renderer.init(SDL_GL_GetProcAddress, render_settings);
 
     postinit_screen();
 
-    Texture fill_cell = Texture::load("texture/fill_cell.png");
-    Texture empty_cell = Texture::load("texture/empty_cell.png");
-    Texture stage_border = Texture::load("texture/stage_border.png");
+    // Needs a build with RTC_PROFILE, the trace stays empty otherwise
+    if (trace_path != nullptr) {
+        Profiler::capture(TRACE_FRAMES);
+    }
+
+    // Every frame until the game quits, replayed with rtc_replay
+    if (capture_path != nullptr && !renderer.start_capture(capture_path)) {
+        fprintf(stderr, "Running without a draw capture\n");
+    }
+
+    // Assets missing from the pack, or all of them without one, load from the loose files
+    AssetPack pack;
+    if (pack_path != nullptr && !pack.open(pack_path)) {
+        fprintf(stderr, "Falling back to loose asset files\n");
+    }
+
+    // Decoded in the background, draws with the empty texture until the upload finished
+    TextureStreamer texture_streamer;
+    texture_streamer.init(2);
+    TextureHandle stage_border = texture_streamer.request("texture/stage_border.png");
+
+    // Small sprites share the atlas so any number of them draw in a single call
+    TextureAtlas atlas;
+    atlas.init();
+    AtlasSprite fill_cell = add_sprite(atlas, pack, "texture/fill_cell.png");
+    AtlasSprite empty_cell = add_sprite(atlas, pack, "texture/empty_cell.png");
+    renderer.set_atlas(&atlas);
 
     SDL_Event event;
     bool quit = false;
+#ifdef RTC_COUNT_ALLOCATIONS
+    size_t frame_index = 0;
+#endif
 
     /**
                 glm::vec3{-1.0F, 1.0F, 0.0F},       // BOTTOM LEFT
@@ -112,13 +242,122 @@ int main(int argc, char* args[]) {
      */
 
     ShaderProgram simple_shader;
-    simple_shader.init("shader/filled_quad.vert", "shader/filled_quad.frag");
+    init_shader(simple_shader, pack, "shader/filled_quad.vert", "shader/filled_quad.frag");
 
     Shape quad = ShapeGenerator::generate_quad(0, simple_shader);
     Shape triangle = ShapeGenerator::generate_triangle(1, simple_shader);
 
-    quad.init();
-    triangle.init();
+    // Resolved once, the buildings and the traffic are drawn as spans of instances every frame
+    const MaterialHandle building_material = renderer.primitive_material(&quad, Primitive{PrimitiveKind::ROUNDED_RECT, 4.0F});
+    const MaterialHandle vehicle_material = renderer.primitive_material(&quad, Primitive{PrimitiveKind::CIRCLE});
+
+    // Stays on the GPU, only the chunks of cells that change are uploaded again
+    TileMap city;
+    city.init(CITY_SIZE, CITY_SIZE, CITY_CELL_SIZE);
+    const TileMap::TileId empty_tile = city.add_tile(empty_cell, {1.0F, 0.0F, 0.0F, 1.0F});
+    const TileMap::TileId fill_tile = city.add_tile(fill_cell, {1.0F, 0.0F, 0.0F, 1.0F});
+
+    for (int y = 0; y < CITY_SIZE; ++y) {
+        for (int x = 0; x < CITY_SIZE; ++x) {
+            city.set(x, y, empty_tile);
+        }
+    }
+
+    const float city_extent = CITY_SIZE * CITY_CELL_SIZE;
+
+    SpatialGrid city_index;
+    city_index.init(glm::vec2{0.0F, 0.0F}, glm::vec2{city_extent, city_extent}, CITY_INDEX_CELL_SIZE);
+
+    std::vector<DrawInstance> buildings;
+    buildings.reserve(CITY_BUILDINGS);
+
+    std::mt19937 random{7};
+    std::uniform_int_distribution<int> building_cell{0, CITY_SIZE - 4};
+    std::uniform_int_distribution<int> building_cells{1, 3};
+    std::uniform_real_distribution<float> shade{0.3F, 0.9F};
+
+    for (size_t b = 0; b < CITY_BUILDINGS; ++b) {
+        const glm::vec2 position = glm::vec2{(float) building_cell(random), (float) building_cell(random)} * CITY_CELL_SIZE;
+        const glm::vec2 scale = glm::vec2{(float) building_cells(random), (float) building_cells(random)} * CITY_CELL_SIZE;
+        const float building_shade = shade(random);
+
+        buildings.push_back(DrawInstance{position, scale, 0.0F, {building_shade, building_shade, building_shade * 1.1F, 1.0F}});
+        (void) city_index.insert(position, position + scale);
+    }
+
+    // Only buildings the index reports in the view are drawn
+    std::vector<SpatialGrid::ObjectId> visible_buildings;
+    visible_buildings.reserve(CITY_BUILDINGS);
+    std::vector<DrawInstance> building_instances;
+    building_instances.reserve(CITY_BUILDINGS);
+    std::vector<DrawInstance> vehicle_instances;
+    vehicle_instances.reserve(CITY_VEHICLES);
+
+    // Glyphs are rasterized into the font atlas on first use, the layouts of the names stay cached
+    Font label_font;
+    const bool labels = label_font.init(LABEL_FONT, LABEL_PIXEL_HEIGHT);
+
+    if (!labels) {
+        fprintf(stderr, "Drawing the city without district names\n");
+    }
+
+    struct District {
+        std::string name;
+        glm::vec2 center;
+    };
+
+    std::vector<District> districts;
+    const int districts_per_side = CITY_SIZE / DISTRICT_SIZE;
+
+    for (int y = 0; y < districts_per_side; ++y) {
+        for (int x = 0; x < districts_per_side; ++x) {
+            const glm::vec2 center = (glm::vec2{(float) x, (float) y} + 0.5F) * (float) DISTRICT_SIZE * CITY_CELL_SIZE;
+            districts.push_back(District{"District " + std::to_string(y * districts_per_side + x + 1), center});
+        }
+    }
+
+    // Its own font, glyphs of the district names never take the cells of the terminal
+    Font terminal_font;
+    const bool terminal = terminal_font.init(LABEL_FONT, TERMINAL_PIXEL_HEIGHT);
+
+    UiLayer terminal_ui;
+    std::array<UiLayer::WidgetId, TERMINAL_LINES> terminal_lines{};
+    UiLayer::WidgetId terminal_panel = 0;
+    bool terminal_visible = true;
+
+    if (terminal) {
+        terminal_ui.init();
+
+        const float line_height = std::ceil(terminal_font.line_height());
+        const glm::vec2 panel_size{TERMINAL_COLUMNS * TERMINAL_PIXEL_HEIGHT * 0.5F + TERMINAL_MARGIN * 2.0F, line_height * TERMINAL_LINES + TERMINAL_MARGIN * 2.0F};
+
+        terminal_panel = terminal_ui.add_panel(glm::vec2{TERMINAL_MARGIN, TERMINAL_MARGIN}, panel_size, {0.05F, 0.08F, 0.1F, 0.85F}, 8.0F);
+
+        // First line on top
+        for (size_t line = 0; line < TERMINAL_LINES; ++line) {
+            const glm::vec2 position{TERMINAL_MARGIN * 2.0F, TERMINAL_MARGIN * 2.0F + line_height * (float) (TERMINAL_LINES - 1 - line)};
+            terminal_lines[line] = terminal_ui.add_label(&terminal_font, position, TERMINAL_COLUMNS, {0.4F, 1.0F, 0.6F, 1.0F});
+        }
+
+        terminal_ui.set_text(terminal_lines[0], "RULE THE CITY  -  F2 hides the terminal");
+    }
+
+    char terminal_text[TERMINAL_COLUMNS + 1];
+
+    // Ticks on its own thread from here on, frames only read the snapshots it publishes
+    Simulation simulation;
+    simulation.init(CITY_VEHICLES, city_extent, STREET_CELLS * CITY_CELL_SIZE, tick_rate, simulation_load);
+
+    // Both rates are sampled once a second
+    auto rate_sample_time = std::chrono::steady_clock::now();
+    uint64_t rate_sample_ticks = 0;
+    size_t rate_sample_frames = 0;
+    double tick_rate_observed = 0.0;
+    double frame_rate_observed = 0.0;
+
+    Camera camera;
+    renderer.set_camera(&camera);
+    glm::vec2 mouse_position{0.0F, 0.0F};
 
     while (!quit) {
         // Event
@@ -132,25 +371,196 @@ int main(int argc, char* args[]) {
                     case SDLK_ESCAPE:
                         quit = true;
                         break;
+                    case SDLK_w:
+                    case SDLK_UP:
+                        camera.pan(glm::vec2{0.0F, CAMERA_PAN_STEP});
+                        break;
+                    case SDLK_s:
+                    case SDLK_DOWN:
+                        camera.pan(glm::vec2{0.0F, -CAMERA_PAN_STEP});
+                        break;
+                    case SDLK_a:
+                    case SDLK_LEFT:
+                        camera.pan(glm::vec2{-CAMERA_PAN_STEP, 0.0F});
+                        break;
+                    case SDLK_d:
+                    case SDLK_RIGHT:
+                        camera.pan(glm::vec2{CAMERA_PAN_STEP, 0.0F});
+                        break;
+                    case SDLK_F2:
+                        terminal_visible = !terminal_visible;
+
+                        if (terminal) {
+                            terminal_ui.set_visible(terminal_panel, terminal_visible);
+
+                            for (UiLayer::WidgetId line: terminal_lines) {
+                                terminal_ui.set_visible(line, terminal_visible);
+                            }
+                        }
+                        break;
+                    case SDLK_F1: {
+                        const SpatialGrid::QueryStats& stats = city_index.last_query_stats();
+                        printf("Culling          : %zu index cells, %zu candidates, %zu of %zu buildings visible, %zu draws culled\n",
+                               stats.cells_visited, stats.candidates, stats.results, city_index.object_count(), renderer.last_frame_culled_draws());
+
+                        const FrameArena::Stats& arena = renderer.frame_arena_stats();
+                        printf("Frame arena      : %zu of %zu bytes last frame, high water %zu, %zu overflows\n",
+                               arena.last_frame_bytes, arena.capacity, arena.high_water, arena.overflow_allocations);
+
+                        const Font::Stats& text = label_font.font_stats();
+                        printf("Text             : %zu glyphs rasterized, %zu evicted, %zu dropped, %zu layouts built, %zu reused\n",
+                               text.glyphs_rasterized, text.glyphs_evicted, text.glyphs_dropped, text.layouts_built, text.layouts_reused);
+                        break;
+                    }
                     default:
                         break;
                 }
             }
+
+            // The window origin is top left while the screen and world origin is bottom left
+            if (event.type == SDL_MOUSEMOTION) {
+                mouse_position = glm::vec2{(float) event.motion.x, (float) (Screen::HEIGHT - event.motion.y)};
+            }
+
+            if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0) {
+                camera.zoom_at(mouse_position, event.wheel.y > 0 ? CAMERA_ZOOM_STEP : 1.0F / CAMERA_ZOOM_STEP);
+            }
+
+            // Toggles the clicked cell
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+                const glm::vec2 click = camera.screen_to_world(glm::vec2{(float) event.button.x, (float) (Screen::HEIGHT - event.button.y)});
+
+                int x, y;
+                if (city.cell_at(click, x, y)) {
+                    city.set(x, y, city.get(x, y) == fill_tile ? empty_tile : fill_tile);
+                }
+            }
         }
 
         // Update
+        texture_streamer.update();
+
+        const auto frame_time = std::chrono::steady_clock::now();
+        ++rate_sample_frames;
+
+        if (frame_time - rate_sample_time >= std::chrono::seconds{1}) {
+            const double seconds = std::chrono::duration<double>(frame_time - rate_sample_time).count();
+            const uint64_t ticks = simulation.tick_count();
+
+            tick_rate_observed = (double) (ticks - rate_sample_ticks) / seconds;
+            frame_rate_observed = (double) rate_sample_frames / seconds;
+
+            rate_sample_time = frame_time;
+            rate_sample_ticks = ticks;
+            rate_sample_frames = 0;
+        }
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Draw
-        renderer.draw(&quad, glm::vec2{0.0F, 0.0F}, glm::vec2{64.0F, 64.0F}, {1.0F, 0.0F, 0.0F, 1.0F}, empty_cell);
-        renderer.draw(&quad, glm::vec2{65.0F, 65.0F}, glm::vec2{64.0F, 64.0F}, {1.0F, 0.0F, 0.0F, 1.0F}, fill_cell);
-        renderer.draw(&quad, glm::vec2{130.0F, 130.0F}, glm::vec2{400.0F, 100.0F}, {1.0F, 1.0F, 1.0F, 1.0F}, stage_border);
+        renderer.draw_tile_map(&city);
+
+        visible_buildings.clear();
+        city_index.query(camera.view_min(), camera.view_max(), visible_buildings);
+
+        building_instances.clear();
+        for (SpatialGrid::ObjectId id: visible_buildings) {
+            building_instances.push_back(buildings[id]);
+        }
+
+        renderer.draw_instances(building_material, building_instances);
+
+        // Drawn between the last two ticks, the traffic moves smoothly at any frame rate
+        const SimulationSnapshot& traffic = simulation.latest_snapshot();
+        const float blend = traffic.blend(frame_time, simulation.tick_interval());
+        const glm::vec2 view_min = camera.view_min() - VEHICLE_SIZE;
+        const glm::vec2 view_max = camera.view_max() + VEHICLE_SIZE;
+
+        vehicle_instances.clear();
+        for (size_t v = 0; v < traffic.positions.size() && v < traffic.previous_positions.size(); ++v) {
+            const glm::vec2 position = traffic.previous_positions[v] + (traffic.positions[v] - traffic.previous_positions[v]) * blend;
+
+            if (position.x > view_min.x && position.y > view_min.y && position.x < view_max.x && position.y < view_max.y) {
+                vehicle_instances.push_back(DrawInstance{position - VEHICLE_SIZE * 0.5F, glm::vec2{VEHICLE_SIZE, VEHICLE_SIZE}, 0.0F,
+                                                         {1.0F, 0.85F, 0.2F, 1.0F}});
+            }
+        }
+
+        renderer.draw_instances(vehicle_material, vehicle_instances);
+
+        if (labels) {
+            for (const District& district: districts) {
+                const glm::vec2 size = label_font.layout(district.name).size * LABEL_SCALE;
+                renderer.draw_text(&quad, &label_font, district.name, district.center - size * 0.5F, LABEL_SCALE, {1.0F, 1.0F, 1.0F, 1.0F}, 1);
+            }
+        }
+
+        // Lines whose text did not change stay as they are on the GPU
+        if (terminal) {
+            snprintf(terminal_text, sizeof(terminal_text), "Camera %.0f, %.0f  zoom %.2fx", camera.position().x, camera.position().y, camera.zoom());
+            terminal_ui.set_text(terminal_lines[1], terminal_text);
+            snprintf(terminal_text, sizeof(terminal_text), "Buildings in view: %zu", visible_buildings.size());
+            terminal_ui.set_text(terminal_lines[2], terminal_text);
+            if (render_settings.count_overdraw) {
+                snprintf(terminal_text, sizeof(terminal_text), "Draw calls: %zu  Overdraw %.2fx", renderer.last_frame_draw_calls(),
+                         renderer.last_frame_overdraw());
+            } else {
+                snprintf(terminal_text, sizeof(terminal_text), "Draw calls: %zu", renderer.last_frame_draw_calls());
+            }
+            terminal_ui.set_text(terminal_lines[3], terminal_text);
+            snprintf(terminal_text, sizeof(terminal_text), "Sim %.1f ticks/s  %.2f ms  %llu skipped  Render %.1f fps", tick_rate_observed,
+                     simulation.last_tick_ms(), (unsigned long long) simulation.skipped_tick_count(), frame_rate_observed);
+            terminal_ui.set_text(terminal_lines[4], terminal_text);
+
+            renderer.draw_ui(&terminal_ui);
+        }
+
+        renderer.draw(&quad, glm::vec2{130.0F, 130.0F}, glm::vec2{400.0F, 100.0F}, 0.0F, {1.0F, 1.0F, 1.0F, 1.0F}, texture_streamer.resolve(stage_border));
+        renderer.draw_primitive(&quad, Primitive{PrimitiveKind::CIRCLE}, glm::vec2{560.0F, 130.0F}, glm::vec2{100.0F, 100.0F}, 0.0F, {0.2F, 0.6F, 1.0F, 1.0F});
+        renderer.draw_primitive(&quad, Primitive{PrimitiveKind::RING, 0.0F, 6.0F}, glm::vec2{670.0F, 130.0F}, glm::vec2{100.0F, 100.0F}, 0.0F, {1.0F, 0.8F, 0.2F, 1.0F});
+        renderer.draw_primitive(&quad, Primitive{PrimitiveKind::ROUNDED_RECT, 16.0F}, glm::vec2{130.0F, 240.0F}, glm::vec2{400.0F, 60.0F}, 0.0F, {0.3F, 0.3F, 0.3F, 1.0F});
         renderer.flush();
 
+        // Stands in for an expensive frame, the simulation keeps its tick rate regardless
+        if (render_load > 0.0) {
+            const auto busy_until = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(render_load);
+
+            while (std::chrono::steady_clock::now() < busy_until) {
+            }
+        }
+
+#ifdef RTC_COUNT_ALLOCATIONS
+        // The first frame warms up the render buffers, every frame after it must be allocation free.
+        if (frame_index > 0 && renderer.last_frame_allocations() != 0) {
+            fprintf(stderr, "Frame %zu: renderer made %zu heap allocations\n", frame_index, renderer.last_frame_allocations());
+        }
+        ++frame_index;
+#endif
+
+        if (trace_path != nullptr && Profiler::capture_finished()) {
+            if (Profiler::write_chrome_trace(trace_path)) {
+                printf("Trace written    : %s\n", trace_path);
+            }
+            trace_path = nullptr;
+        }
+
         SDL_GL_SwapWindow(window);
     }
 
+    simulation.shutdown();
+    renderer.stop_capture();
+
+    if (labels) {
+        label_font.shutdown();
+    }
+
+    if (terminal) {
+        terminal_ui.shutdown();
+        terminal_font.shutdown();
+    }
+
+    city.shutdown();
+    texture_streamer.shutdown();
     destroy_screen();
 
     return 0;
@@ -0,0 +1,51 @@
+#include "AllocationCounter.h"
+
+#ifdef RTC_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+
+// Plain thread locals, operator new must not allocate to reach them
+static thread_local size_t scope_depth = 0;
+static thread_local size_t allocation_count = 0;
+
+size_t AllocationCounter::count() {
+    return allocation_count;
+}
+
+AllocationCounter::Scope::Scope() {
+    ++scope_depth;
+}
+
+AllocationCounter::Scope::~Scope() {
+    --scope_depth;
+}
+
+void* operator new(size_t size) {
+    if (scope_depth > 0) {
+        ++allocation_count;
+    }
+
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+#else
+
+size_t AllocationCounter::count() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+
+// Counts heap allocations made inside a Scope when the build defines RTC_COUNT_ALLOCATIONS (CMake option of the same
+// name). Without it the counter always reads zero and operator new is left untouched.
+namespace AllocationCounter {
+    // Allocations this thread made inside a Scope so far. Other threads, like the game's simulation or the renderer's
+    // build jobs, count on their own.
+    [[nodiscard]] size_t count();
+
+    // Counts the allocations of the constructing thread until it is destroyed, the renderer opens one in every draw
+    // call and in flush so allocations of the game around it are left out. Scopes may nest.
+    class Scope {
+    public:
+#ifdef RTC_COUNT_ALLOCATIONS
+        Scope();
+
+        ~Scope();
+#else
+        Scope() {
+
+        }
+#endif
+
+        Scope(const Scope&) = delete;
+
+        Scope& operator=(const Scope&) = delete;
+    };
+}
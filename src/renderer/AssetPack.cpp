@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "AssetPack.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+AssetPack::~AssetPack() {
+    close();
+}
+
+bool AssetPack::open(const char* file_name) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Failed to open asset pack %s\n", file_name);
+
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+
+    // The view keeps the mapping alive, both handles can go right away
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+
+    if (mapping == nullptr) {
+        printf("Failed to map asset pack %s\n", file_name);
+
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (view == nullptr) {
+        printf("Failed to map asset pack %s\n", file_name);
+
+        return false;
+    }
+
+    mapped = (const unsigned char*) view;
+    mapped_size = (size_t) file_size.QuadPart;
+#else
+    int file = ::open(file_name, O_RDONLY);
+    if (file < 0) {
+        printf("Failed to open asset pack %s\n", file_name);
+
+        return false;
+    }
+
+    struct stat file_stat{};
+    fstat(file, &file_stat);
+
+    // The mapping stays valid after the descriptor is closed
+    void* view = file_stat.st_size > 0 ? mmap(nullptr, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    ::close(file);
+
+    if (view == MAP_FAILED) {
+        printf("Failed to map asset pack %s\n", file_name);
+
+        return false;
+    }
+
+    mapped = (const unsigned char*) view;
+    mapped_size = (size_t) file_stat.st_size;
+#endif
+
+    const auto* header = (const AssetPackFormat::Header*) mapped;
+    if (mapped_size >= sizeof(AssetPackFormat::Header)) {
+        entry_table = std::span{(const AssetPackFormat::Entry*) (mapped + sizeof(AssetPackFormat::Header)), header->entry_count};
+    }
+
+    if (!validate()) {
+        printf("Invalid asset pack %s\n", file_name);
+        close();
+
+        return false;
+    }
+
+    return true;
+}
+
+void AssetPack::close() {
+    if (mapped == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+#else
+    munmap((void*) mapped, mapped_size);
+#endif
+
+    mapped = nullptr;
+    mapped_size = 0;
+    entry_table = {};
+}
+
+const AssetPackFormat::Entry* AssetPack::find(std::string_view name) const {
+    // The packer sorts the entries by name
+    auto it = std::lower_bound(entry_table.begin(), entry_table.end(), name, [](const AssetPackFormat::Entry& entry, std::string_view key) {
+        return std::string_view{entry.name} < key;
+    });
+
+    if (it == entry_table.end() || std::string_view{it->name} != name) {
+        return nullptr;
+    }
+
+    return &*it;
+}
+
+std::span<const unsigned char> AssetPack::data(const AssetPackFormat::Entry& entry) const {
+    return std::span{mapped + entry.offset, (size_t) entry.size};
+}
+
+std::optional<Texture> AssetPack::load_texture(std::string_view name) const {
+    const AssetPackFormat::Entry* entry = find(name);
+
+    if (entry == nullptr || entry->type != AssetPackFormat::EntryType::TEXTURE) {
+        return std::nullopt;
+    }
+
+    GLuint texture_id;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture_id);
+    glTextureStorage2D(texture_id, (GLsizei) entry->mip_count, GL_RGBA8, (GLsizei) entry->width, (GLsizei) entry->height);
+    glTextureParameteri(texture_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Straight from the mapping, the driver copies the pages it touches
+    for (uint32_t level = 0; level < entry->mip_count; ++level) {
+        glTextureSubImage2D(texture_id, (GLint) level, 0, 0,
+                            (GLsizei) AssetPackFormat::mip_extent(entry->width, level),
+                            (GLsizei) AssetPackFormat::mip_extent(entry->height, level),
+                            GL_RGBA, GL_UNSIGNED_BYTE, mip_level(*entry, level).data());
+    }
+
+    return Texture{texture_id, Texture::opaque_pixels(mip_level(*entry, 0).data(), (size_t) entry->width * entry->height)};
+}
+
+std::span<const unsigned char> AssetPack::mip_level(const AssetPackFormat::Entry& entry, uint32_t level) const {
+    size_t offset = 0;
+    for (uint32_t l = 0; l < level; ++l) {
+        offset += AssetPackFormat::mip_bytes(entry.width, entry.height, l);
+    }
+
+    return data(entry).subspan(offset, AssetPackFormat::mip_bytes(entry.width, entry.height, level));
+}
+
+std::string_view AssetPack::shader_source(std::string_view name) const {
+    const AssetPackFormat::Entry* entry = find(name);
+
+    if (entry == nullptr || entry->type != AssetPackFormat::EntryType::SHADER) {
+        return {};
+    }
+
+    std::span<const unsigned char> source = data(*entry);
+
+    return std::string_view{(const char*) source.data(), source.size()};
+}
+
+bool AssetPack::validate() const {
+    if (mapped_size < sizeof(AssetPackFormat::Header)) {
+        return false;
+    }
+
+    const auto* header = (const AssetPackFormat::Header*) mapped;
+    if (memcmp(header->magic, AssetPackFormat::MAGIC, sizeof(header->magic)) != 0 || header->version != AssetPackFormat::VERSION) {
+        return false;
+    }
+
+    if (sizeof(AssetPackFormat::Header) + entry_table.size_bytes() > mapped_size) {
+        return false;
+    }
+
+    for (const AssetPackFormat::Entry& entry: entry_table) {
+        if (memchr(entry.name, '\0', AssetPackFormat::NAME_LENGTH) == nullptr) {
+            return false;
+        }
+
+        if (entry.offset > mapped_size || entry.size > mapped_size - entry.offset) {
+            return false;
+        }
+
+        if (entry.type == AssetPackFormat::EntryType::TEXTURE) {
+            // The levels are sized by shifting the extent, more levels than down to 1x1 would shift past its width
+            if (entry.width == 0 || entry.height == 0 || entry.mip_count == 0 ||
+                entry.mip_count > AssetPackFormat::max_mip_count(entry.width, entry.height)) {
+                return false;
+            }
+
+            size_t expected_size = 0;
+            for (uint32_t level = 0; level < entry.mip_count; ++level) {
+                expected_size += AssetPackFormat::mip_bytes(entry.width, entry.height, level);
+            }
+
+            if (expected_size != entry.size) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
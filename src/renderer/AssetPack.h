@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include "AssetPackFormat.h"
+#include "Texture.h"
+
+
+// Read-only view of an asset pack written by rtc_pack. The file is memory mapped for the lifetime of the pack and
+// textures upload straight from the mapping, nothing is decoded or copied at load time.
+class AssetPack {
+public:
+    AssetPack() : mapped { nullptr }, mapped_size { 0 }, entry_table {} {
+
+    }
+
+    ~AssetPack();
+
+    AssetPack(const AssetPack&) = delete;
+
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    // Maps and validates the pack, false if it can not be used
+    [[nodiscard]] bool open(const char* file_name);
+
+    void close();
+
+    [[nodiscard]] bool is_open() const {
+        return mapped != nullptr;
+    }
+
+    [[nodiscard]] std::span<const AssetPackFormat::Entry> entries() const {
+        return entry_table;
+    }
+
+    [[nodiscard]] const AssetPackFormat::Entry* find(std::string_view name) const;
+
+    [[nodiscard]] std::span<const unsigned char> data(const AssetPackFormat::Entry& entry) const;
+
+    // Creates the texture with every packed mip level, needs a current GL context
+    [[nodiscard]] std::optional<Texture> load_texture(std::string_view name) const;
+
+    // RGBA8 pixels of one mip level of a texture entry, e.g. to add level 0 to a TextureAtlas
+    [[nodiscard]] std::span<const unsigned char> mip_level(const AssetPackFormat::Entry& entry, uint32_t level) const;
+
+    // Empty when the pack has no such shader
+    [[nodiscard]] std::string_view shader_source(std::string_view name) const;
+
+private:
+    [[nodiscard]] bool validate() const;
+
+private:
+    const unsigned char* mapped;
+    size_t mapped_size;
+    std::span<const AssetPackFormat::Entry> entry_table;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+
+// On-disk layout of an asset pack, shared by the packer tool and AssetPack. A pack is a Header, followed by entry_count
+// Entries sorted by name, followed by the data of every entry. All integers are little endian.
+namespace AssetPackFormat {
+    static constexpr const char MAGIC[4] = {'R', 'T', 'C', 'P'};
+    static constexpr const uint32_t VERSION = 1;
+
+    // Entry names are the asset paths relative to the asset directory, e.g. "texture/fill_cell.png"
+    static constexpr const size_t NAME_LENGTH = 64;
+
+    // Every entry's data starts on this alignment
+    static constexpr const size_t DATA_ALIGNMENT = 16;
+
+    enum class EntryType : uint32_t {
+        // RGBA8 pixels of every mip level, largest first, rows tightly packed
+        TEXTURE = 0,
+        // GLSL source text, not null terminated
+        SHADER = 1
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        char name[NAME_LENGTH];
+        EntryType type;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_count;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static_assert(sizeof(Header) == 16, "Header layout is part of the file format");
+    static_assert(sizeof(Entry) == NAME_LENGTH + 32, "Entry layout is part of the file format");
+
+    inline uint32_t mip_extent(uint32_t extent, uint32_t level) {
+        return std::max<uint32_t>(extent >> level, 1);
+    }
+
+    // floor(log2(max(width, height))) + 1, the levels down to 1x1
+    inline uint32_t max_mip_count(uint32_t width, uint32_t height) {
+        uint32_t levels = 1;
+        while ((std::max(width, height) >> levels) > 0) {
+            ++levels;
+        }
+
+        return levels;
+    }
+
+    inline size_t mip_bytes(uint32_t width, uint32_t height, uint32_t level) {
+        return (size_t) mip_extent(width, level) * mip_extent(height, level) * 4;
+    }
+}
@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <glm/ext/matrix_clip_space.hpp>
+#include "Camera.h"
+
+
+void Camera::set_position(glm::vec2 position_) {
+    this->world_position = position_;
+}
+
+void Camera::pan(glm::vec2 screen_delta) {
+    world_position += screen_delta / zoom_level;
+}
+
+void Camera::set_zoom(float zoom_) {
+    this->zoom_level = std::clamp(zoom_, CAMERA_MIN_ZOOM, CAMERA_MAX_ZOOM);
+}
+
+void Camera::zoom_at(glm::vec2 screen_point, float factor) {
+    const glm::vec2 anchor = screen_to_world(screen_point);
+
+    set_zoom(zoom_level * factor);
+
+    // Shift the view so the anchor is back under the screen point
+    world_position += anchor - screen_to_world(screen_point);
+}
+
+void Camera::set_viewport(glm::vec2 viewport_) {
+    this->viewport = viewport_;
+}
+
+glm::vec2 Camera::view_min() const {
+    return world_position - viewport * (0.5F / zoom_level);
+}
+
+glm::vec2 Camera::view_max() const {
+    return world_position + viewport * (0.5F / zoom_level);
+}
+
+glm::mat4 Camera::projection() const {
+    const glm::vec2 min = view_min();
+    const glm::vec2 max = view_max();
+
+    return glm::ortho(min.x, max.x, min.y, max.y);
+}
+
+glm::vec2 Camera::screen_to_world(glm::vec2 screen_point) const {
+    return view_min() + screen_point / zoom_level;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/mat4x4.hpp>
+#include "Screen.h"
+
+
+static constexpr const float CAMERA_MIN_ZOOM = 0.05F;
+static constexpr const float CAMERA_MAX_ZOOM = 16.0F;
+
+// Orthographic 2D camera. The position is the world point at the center of the view, a zoom of 2 shows every world
+// unit as two pixels. Screen coordinates have their origin at the bottom left like the world.
+// The default camera maps the world one to one onto the screen, with the world origin at the bottom left corner.
+class Camera {
+public:
+    Camera() : world_position { Screen::WIDTH * 0.5F, Screen::HEIGHT * 0.5F }, zoom_level { 1.0F },
+               viewport { (float) Screen::WIDTH, (float) Screen::HEIGHT } {
+
+    }
+
+    void set_position(glm::vec2 position_);
+
+    // Moves by a distance in screen pixels, so panning feels the same at every zoom
+    void pan(glm::vec2 screen_delta);
+
+    void set_zoom(float zoom_);
+
+    // Zooms by factor while the world point under the screen point stays where it is
+    void zoom_at(glm::vec2 screen_point, float factor);
+
+    void set_viewport(glm::vec2 viewport_);
+
+    [[nodiscard]] glm::vec2 position() const {
+        return world_position;
+    }
+
+    [[nodiscard]] float zoom() const {
+        return zoom_level;
+    }
+
+    // Corners of the visible world rectangle
+    [[nodiscard]] glm::vec2 view_min() const;
+
+    [[nodiscard]] glm::vec2 view_max() const;
+
+    [[nodiscard]] glm::mat4 projection() const;
+
+    [[nodiscard]] glm::vec2 screen_to_world(glm::vec2 screen_point) const;
+
+private:
+    glm::vec2 world_position;
+    float zoom_level;
+    glm::vec2 viewport;
+};
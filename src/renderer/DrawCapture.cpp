@@ -0,0 +1,100 @@
+#include <cstddef>
+#include <cstring>
+#include "DrawCapture.h"
+
+
+DrawCapture::~DrawCapture() {
+    close();
+}
+
+bool DrawCapture::open(const char* file_name) {
+    close();
+
+    file = fopen(file_name, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open capture file: %s\n", file_name);
+
+        return false;
+    }
+
+    DrawCaptureFormat::Header header{};
+    memcpy(header.magic, DrawCaptureFormat::MAGIC, sizeof(header.magic));
+    header.version = DrawCaptureFormat::VERSION;
+    fwrite(&header, sizeof(header), 1, file);
+
+    start_time = std::chrono::steady_clock::now();
+    frame_count = 0;
+    known_shapes.clear();
+    frame_shapes.clear();
+    frame_shape_count = 0;
+    frame_commands.clear();
+
+    return true;
+}
+
+void DrawCapture::close() {
+    if (file == nullptr) {
+        return;
+    }
+
+    // Draws recorded after the last flush never made it into a frame
+    fseek(file, offsetof(DrawCaptureFormat::Header, frame_count), SEEK_SET);
+    fwrite(&frame_count, sizeof(frame_count), 1, file);
+
+    fclose(file);
+    file = nullptr;
+}
+
+void DrawCapture::record(const Shape* shape, const DrawCaptureFormat::Command& command) {
+    if (known_shapes.insert(shape->id).second) {
+        write_shape(shape);
+    }
+
+    frame_commands.push_back(command);
+}
+
+void DrawCapture::write_shape(const Shape* shape) {
+    const DrawCaptureFormat::Shape record{(uint32_t) shape->id, (uint32_t) shape->gl_render_mode, (uint32_t) shape->vertices.size(),
+                                          (uint32_t) shape->indices.size()};
+
+    static_assert(sizeof(Shape::Vertex) == 4 * sizeof(float), "Captured vertices are 4 floats");
+    static_assert(sizeof(int) == sizeof(uint32_t), "Captured indices are 32 bit");
+
+    const auto append = [this](const void* data, size_t bytes) {
+        const auto* begin = (const unsigned char*) data;
+        frame_shapes.insert(frame_shapes.end(), begin, begin + bytes);
+    };
+
+    append(&record, sizeof(record));
+    append(shape->vertices.data(), shape->vertices.size() * sizeof(Shape::Vertex));
+    append(shape->indices.data(), shape->indices.size() * sizeof(int));
+
+    ++frame_shape_count;
+}
+
+void DrawCapture::end_frame(const Camera& camera) {
+    DrawCaptureFormat::FrameHeader frame_header{};
+    frame_header.time_ns = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+    frame_header.camera_position[0] = camera.position().x;
+    frame_header.camera_position[1] = camera.position().y;
+    frame_header.camera_zoom = camera.zoom();
+    frame_header.shape_count = frame_shape_count;
+    frame_header.command_count = (uint32_t) frame_commands.size();
+
+    const bool written = fwrite(&frame_header, sizeof(frame_header), 1, file) == 1 &&
+                         fwrite(frame_shapes.data(), 1, frame_shapes.size(), file) == frame_shapes.size() &&
+                         fwrite(frame_commands.data(), sizeof(DrawCaptureFormat::Command), frame_commands.size(), file) == frame_commands.size();
+
+    frame_shapes.clear();
+    frame_shape_count = 0;
+    frame_commands.clear();
+
+    if (!written) {
+        fprintf(stderr, "Failed to write the capture, stopped after %u frames\n", frame_count);
+        close();
+
+        return;
+    }
+
+    ++frame_count;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_set>
+#include <vector>
+#include "DrawCaptureFormat.h"
+#include "Shape.h"
+#include "Camera.h"
+
+
+// Records the draws reaching the Renderer into a capture file, see DrawCaptureFormat. The draws of a frame are
+// collected in memory and written with one call when the frame is flushed, a shape is written once with the first
+// frame drawing it.
+class DrawCapture {
+public:
+    DrawCapture() : file { nullptr }, start_time {}, frame_count { 0 }, known_shapes {}, frame_shapes {}, frame_shape_count { 0 }, frame_commands {} {
+
+    }
+
+    ~DrawCapture();
+
+    DrawCapture(const DrawCapture&) = delete;
+
+    DrawCapture& operator=(const DrawCapture&) = delete;
+
+    // Creates the file, false if it can not be written
+    [[nodiscard]] bool open(const char* file_name);
+
+    // Completes the header, the file is a valid capture only afterwards
+    void close();
+
+    [[nodiscard]] bool is_open() const {
+        return file != nullptr;
+    }
+
+    void record(const Shape* shape, const DrawCaptureFormat::Command& command);
+
+    // Writes the draws recorded since the previous frame
+    void end_frame(const Camera& camera);
+
+    [[nodiscard]] size_t captured_frames() const {
+        return frame_count;
+    }
+
+private:
+    void write_shape(const Shape* shape);
+
+private:
+    FILE* file;
+    std::chrono::steady_clock::time_point start_time;
+    uint32_t frame_count;
+
+    std::unordered_set<size_t> known_shapes;
+
+    // Frame data, cleared every frame but keeping its memory
+    std::vector<unsigned char> frame_shapes;
+    uint32_t frame_shape_count;
+    std::vector<DrawCaptureFormat::Command> frame_commands;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// On-disk layout of a draw capture, written by the Renderer and read by rtc_replay. A capture is a Header followed by
+// frame_count frames. Every frame is a FrameHeader, followed by shape_count shapes the capture has not seen before,
+// followed by command_count Commands in the order they were drawn. A shape is a Shape record, followed by its vertices
+// and its indices. All integers are little endian.
+namespace DrawCaptureFormat {
+    static constexpr const char MAGIC[4] = {'R', 'T', 'C', 'D'};
+    static constexpr const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        // Written when the capture is stopped, zero while it is still recording
+        uint32_t frame_count;
+        uint32_t reserved;
+    };
+
+    struct FrameHeader {
+        // Since the capture started, when the frame was flushed. Replays at recorded pacing wait for it.
+        uint64_t time_ns;
+        // The camera the frame was seen through, draws outside of it are culled again on replay
+        float camera_position[2];
+        float camera_zoom;
+        uint32_t shape_count;
+        uint32_t command_count;
+        uint32_t reserved;
+    };
+
+    struct Shape {
+        uint32_t id;
+        uint32_t gl_render_mode;
+        // Followed by vertex_count vertices of 4 floats (point xy, uv xy) and index_count 32 bit indices
+        uint32_t vertex_count;
+        uint32_t index_count;
+    };
+
+    // One draw as it reached the renderer, a draw_text is one command per glyph
+    struct Command {
+        uint32_t shape_id;
+        // GL name of the texture at capture time, zero when untextured. It only tells textures apart, replays draw
+        // every name with a texture of their own.
+        uint32_t texture_id;
+        // Layer of the atlas sprite, negative when the draw is not a sprite
+        int32_t atlas_layer;
+        uint8_t layer;
+        // Nonzero when no pixel of the texture or sprite was translucent. Zero in captures that predate it.
+        uint8_t opaque;
+        uint8_t reserved[2];
+        float depth;
+        float rotation;
+        float position[2];
+        float scale[2];
+        float tint_color[4];
+        // Of the texture or the atlas sprite
+        float uv_rect[4];
+        float shape_params[4];
+    };
+
+    static_assert(sizeof(Header) == 16, "Header layout is part of the file format");
+    static_assert(sizeof(FrameHeader) == 32, "FrameHeader layout is part of the file format");
+    static_assert(sizeof(Shape) == 16, "Shape layout is part of the file format");
+    static_assert(sizeof(Command) == 88, "Command layout is part of the file format");
+}
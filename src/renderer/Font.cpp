@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "Font.h"
+#include "Profiler.h"
+
+
+// Decodes the code point starting at index and moves index past it. Malformed bytes decode as U+FFFD.
+static int next_codepoint(std::string_view text, size_t& index) {
+    const auto first = (unsigned char) text[index++];
+
+    if (first < 0x80) {
+        return first;
+    }
+
+    int length;
+    int codepoint;
+
+    if ((first & 0xE0) == 0xC0) {
+        length = 1;
+        codepoint = first & 0x1F;
+    } else if ((first & 0xF0) == 0xE0) {
+        length = 2;
+        codepoint = first & 0x0F;
+    } else if ((first & 0xF8) == 0xF0) {
+        length = 3;
+        codepoint = first & 0x07;
+    } else {
+        return 0xFFFD;
+    }
+
+    for (int i = 0; i < length; ++i) {
+        if (index >= text.size() || ((unsigned char) text[index] & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+
+        codepoint = (codepoint << 6) | ((unsigned char) text[index++] & 0x3F);
+    }
+
+    return codepoint;
+}
+
+bool Font::init(const char* file_name, float pixel_height) {
+    FILE* file = fopen(file_name, "rb");
+
+    if (file == nullptr) {
+        printf("Failed to open font %s\n", file_name);
+
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    font_data.resize(length > 0 ? (size_t) length : 0);
+    const bool read = !font_data.empty() && fread(font_data.data(), 1, font_data.size(), file) == font_data.size();
+    fclose(file);
+
+    const int offset = read ? stbtt_GetFontOffsetForIndex(font_data.data(), 0) : -1;
+
+    if (offset < 0 || !stbtt_InitFont(&font_info, font_data.data(), offset)) {
+        printf("Failed to load font %s\n", file_name);
+        font_data.clear();
+
+        return false;
+    }
+
+    scale = stbtt_ScaleForPixelHeight(&font_info, pixel_height);
+
+    int font_ascent, font_descent, font_line_gap;
+    stbtt_GetFontVMetrics(&font_info, &font_ascent, &font_descent, &font_line_gap);
+    ascent = scale * (float) font_ascent;
+    descent = scale * (float) font_descent;
+    line_gap = scale * (float) font_line_gap;
+
+    // Accents and some symbols reach past the ascent, they get a little room before they are clipped
+    cell_size = (int) std::ceil(pixel_height * 1.25F) + GLYPH_PADDING * 2;
+    cells_per_row = GLYPH_ATLAS_SIZE / cell_size;
+
+    cells.assign((size_t) cells_per_row * cells_per_row, Cell{});
+    next_free_cell = 0;
+    lru_head = NO_CELL;
+    lru_tail = NO_CELL;
+    resident_glyphs.clear();
+    resident_glyphs.reserve(cells.size());
+    layouts.clear();
+    frame = 1;
+    stats = {};
+
+    scratch_cell.resize((size_t) cell_size * cell_size);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &atlas_texture.id);
+    glTextureStorage2D(atlas_texture.id, 1, GL_R8, GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE);
+
+    // Only coverage is stored, it samples as white with the coverage as alpha so the tint colors the text
+    const GLint swizzle[] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
+    glTextureParameteriv(atlas_texture.id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTextureParameteri(atlas_texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(atlas_texture.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(atlas_texture.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(atlas_texture.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    printf("Font             : %s, %.0f px, %zu glyph cells\n", file_name, pixel_height, cells.size());
+
+    return true;
+}
+
+void Font::shutdown() {
+    glDeleteTextures(1, &atlas_texture.id);
+    atlas_texture.id = 0;
+
+    cells.clear();
+    resident_glyphs.clear();
+    layouts.clear();
+    font_data.clear();
+}
+
+Font::Layout& Font::layout(std::string_view text) {
+    auto found = layouts.find(text);
+
+    if (found != layouts.end()) {
+        found->second.last_used_frame = frame;
+        ++stats.layouts_reused;
+
+        return found->second;
+    }
+
+    auto [inserted, _] = layouts.emplace(std::string{text}, Layout{});
+    build_layout(text, inserted->second);
+    inserted->second.last_used_frame = frame;
+    ++stats.layouts_built;
+
+    return inserted->second;
+}
+
+std::optional<glm::vec4> Font::glyph_uv_rect(Font::LayoutGlyph& glyph) {
+    // The cell still holds the glyph unless it was evicted since the glyph was last drawn
+    if (glyph.cell == NO_CELL || cells[glyph.cell].generation != glyph.cell_generation) {
+        auto resident = resident_glyphs.find(glyph.glyph_index);
+        std::optional<uint32_t> cell = resident != resident_glyphs.end() ? std::optional{resident->second} : rasterize(glyph.glyph_index);
+
+        if (!cell.has_value()) {
+            ++stats.glyphs_dropped;
+
+            return std::nullopt;
+        }
+
+        glyph.cell = *cell;
+        glyph.cell_generation = cells[*cell].generation;
+    }
+
+    touch(glyph.cell);
+
+    const auto atlas_size = (float) GLYPH_ATLAS_SIZE;
+    const auto x = (float) ((int) (glyph.cell % cells_per_row) * cell_size + GLYPH_PADDING);
+    const auto y = (float) ((int) (glyph.cell / cells_per_row) * cell_size + GLYPH_PADDING);
+
+    // Bitmap rows run top down while the quad's uvs run bottom up, the rect flips it
+    return glm::vec4{x / atlas_size, (y + glyph.size.y) / atlas_size, glyph.size.x / atlas_size, -glyph.size.y / atlas_size};
+}
+
+void Font::end_frame() {
+    ++frame;
+
+    // Swept only every so often, an idle layout costs nothing but memory until then
+    if (frame % TEXT_LAYOUT_IDLE_FRAMES == 0) {
+        std::erase_if(layouts, [this](const auto& entry) {
+            return frame - entry.second.last_used_frame > TEXT_LAYOUT_IDLE_FRAMES;
+        });
+    }
+}
+
+void Font::glyph_box(int glyph_index, int& x0, int& y0, int& width, int& height) const {
+    int x1, y1;
+    stbtt_GetGlyphBitmapBox(&font_info, glyph_index, scale, scale, &x0, &y0, &x1, &y1);
+
+    const int inner_size = cell_size - GLYPH_PADDING * 2;
+    width = std::min(x1 - x0, inner_size);
+    height = std::min(y1 - y0, inner_size);
+}
+
+std::optional<uint32_t> Font::rasterize(int glyph_index) {
+    uint32_t cell_index;
+
+    if (next_free_cell < cells.size()) {
+        cell_index = next_free_cell++;
+    } else {
+        cell_index = lru_tail;
+
+        // Even the least recently used glyph is part of this frame, its quads are already recorded
+        if (cells[cell_index].last_used_frame == frame) {
+            return std::nullopt;
+        }
+
+        resident_glyphs.erase(cells[cell_index].glyph_index);
+        unlink(cell_index);
+        ++stats.glyphs_evicted;
+    }
+
+    Cell& cell = cells[cell_index];
+    cell.glyph_index = glyph_index;
+    ++cell.generation;
+
+    int x0, y0, width, height;
+    glyph_box(glyph_index, x0, y0, width, height);
+
+    // The whole cell is written, the padding has to be cleared of the glyph that held it before
+    std::fill(scratch_cell.begin(), scratch_cell.end(), 0);
+    stbtt_MakeGlyphBitmap(&font_info, &scratch_cell[GLYPH_PADDING * cell_size + GLYPH_PADDING], width, height, cell_size, scale, scale, glyph_index);
+
+    const int x = (int) (cell_index % cells_per_row) * cell_size;
+    const int y = (int) (cell_index / cells_per_row) * cell_size;
+
+    // Rows of a single channel cell are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(atlas_texture.id, 0, x, y, cell_size, cell_size, GL_RED, GL_UNSIGNED_BYTE, scratch_cell.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    resident_glyphs[glyph_index] = cell_index;
+    ++stats.glyphs_rasterized;
+
+    RTC_PROFILE_COUNT(GLYPHS_RASTERIZED, 1);
+    RTC_PROFILE_COUNT(BYTES_UPLOADED, scratch_cell.size());
+
+    return cell_index;
+}
+
+void Font::touch(uint32_t cell_index) {
+    Cell& cell = cells[cell_index];
+    cell.last_used_frame = frame;
+
+    if (lru_head == cell_index) {
+        return;
+    }
+
+    // Anything linked but the head has a previous cell
+    if (cell.previous != NO_CELL) {
+        unlink(cell_index);
+    }
+
+    cell.previous = NO_CELL;
+    cell.next = lru_head;
+
+    if (lru_head != NO_CELL) {
+        cells[lru_head].previous = cell_index;
+    }
+
+    lru_head = cell_index;
+
+    if (lru_tail == NO_CELL) {
+        lru_tail = cell_index;
+    }
+}
+
+void Font::unlink(uint32_t cell_index) {
+    Cell& cell = cells[cell_index];
+
+    if (cell.previous != NO_CELL) {
+        cells[cell.previous].next = cell.next;
+    } else {
+        lru_head = cell.next;
+    }
+
+    if (cell.next != NO_CELL) {
+        cells[cell.next].previous = cell.previous;
+    } else {
+        lru_tail = cell.previous;
+    }
+
+    cell.previous = NO_CELL;
+    cell.next = NO_CELL;
+}
+
+void Font::build_layout(std::string_view text, Font::Layout& text_layout) const {
+    text_layout.glyphs.clear();
+
+    float pen_x = 0.0F;
+    float width = 0.0F;
+    size_t lines = 1;
+    int previous_glyph = 0;
+    size_t index = 0;
+
+    while (index < text.size()) {
+        const int codepoint = next_codepoint(text, index);
+
+        if (codepoint == '\n') {
+            width = std::max(width, pen_x);
+            pen_x = 0.0F;
+            previous_glyph = 0;
+            ++lines;
+
+            continue;
+        }
+
+        const int glyph_index = stbtt_FindGlyphIndex(&font_info, codepoint);
+
+        if (previous_glyph != 0) {
+            pen_x += scale * (float) stbtt_GetGlyphKernAdvance(&font_info, previous_glyph, glyph_index);
+        }
+
+        int x0, y0, glyph_width, glyph_height;
+        glyph_box(glyph_index, x0, y0, glyph_width, glyph_height);
+
+        if (glyph_width > 0 && glyph_height > 0) {
+            // Lines are laid out downwards from the top of the text, the box of the glyph is y down from the baseline
+            const float baseline = -ascent - (float) (lines - 1) * line_height();
+
+            text_layout.glyphs.push_back(LayoutGlyph{
+                    glm::vec2{std::round(pen_x) + (float) x0, baseline - (float) (y0 + glyph_height)},
+                    glm::vec2{(float) glyph_width, (float) glyph_height},
+                    glyph_index,
+                    NO_CELL,
+                    0
+            });
+        }
+
+        int advance, left_side_bearing;
+        stbtt_GetGlyphHMetrics(&font_info, glyph_index, &advance, &left_side_bearing);
+        pen_x += scale * (float) advance;
+        previous_glyph = glyph_index;
+    }
+
+    const float height = (float) lines * line_height();
+
+    // Moves the origin from the top left to the bottom left of the text
+    for (LayoutGlyph& glyph: text_layout.glyphs) {
+        glyph.offset.y += height;
+    }
+
+    text_layout.size = glm::vec2{std::max(width, pen_x), height};
+}
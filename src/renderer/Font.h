@@ -0,0 +1,162 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <stb_truetype.h>
+#include "Texture.h"
+
+
+// Side of the square glyph atlas of a font, in texels
+static constexpr const int GLYPH_ATLAS_SIZE = 1024;
+
+// Empty texels around every glyph, so linear filtering never bleeds into a neighbouring cell
+static constexpr const int GLYPH_PADDING = 1;
+
+// Cached layouts not drawn for this many frames are dropped, text that changes every frame does not pile up
+static constexpr const uint64_t TEXT_LAYOUT_IDLE_FRAMES = 600;
+
+// A TrueType font rasterized at one pixel height. Glyphs are rasterized with stb_truetype the first time they are drawn,
+// into the fixed size cells of a single channel atlas texture. Once every cell is taken the least recently drawn glyph
+// gives up its cell. The layout of a string is cached by its text, drawing an unchanged label again does not lay it out.
+class Font {
+public:
+    // A glyph of a laid out text, in pixels relative to the bottom left of the text
+    struct LayoutGlyph {
+        glm::vec2 offset;
+        glm::vec2 size;
+        int glyph_index;
+        // Atlas cell the glyph was last found in, only valid while the cell has the same generation
+        uint32_t cell;
+        uint32_t cell_generation;
+    };
+
+    struct Layout {
+        // Glyphs with pixels, spaces only advance the pen
+        std::vector<LayoutGlyph> glyphs;
+        // Of the whole text in pixels, lines are line_height() apart
+        glm::vec2 size;
+        uint64_t last_used_frame;
+    };
+
+    struct Stats {
+        size_t glyphs_rasterized;
+        size_t glyphs_evicted;
+        // Glyphs not drawn because every cell held a glyph of the same frame
+        size_t glyphs_dropped;
+        size_t layouts_built;
+        size_t layouts_reused;
+    };
+
+    Font() : font_data {}, font_info {}, scale { 0.0F }, ascent { 0.0F }, descent { 0.0F }, line_gap { 0.0F },
+             cell_size { 0 }, cells_per_row { 0 }, atlas_texture { 0 }, cells {}, next_free_cell { 0 }, lru_head { NO_CELL },
+             lru_tail { NO_CELL }, resident_glyphs {}, layouts {}, frame { 1 }, stats {}, scratch_cell {} {
+
+    }
+
+    Font(const Font&) = delete;
+
+    Font& operator=(const Font&) = delete;
+
+    // Loads the font file and creates its empty atlas, needs a current GL context. False when the file is no usable font.
+    bool init(const char* file_name, float pixel_height);
+
+    void shutdown();
+
+    // The cached layout of the text, laid out on the first call. Lines break at '\n', the text is UTF-8.
+    Layout& layout(std::string_view text);
+
+    // Where the glyph is in the atlas (see FULL_UV_RECT), rasterized again when its cell was given to another glyph.
+    // Empty when the atlas is full of glyphs drawn this frame.
+    std::optional<glm::vec4> glyph_uv_rect(LayoutGlyph& glyph);
+
+    // Whether the glyph still has its cell, without touching or rasterizing it
+    [[nodiscard]] bool resident(const LayoutGlyph& glyph) const {
+        return glyph.cell != NO_CELL && cells[glyph.cell].generation == glyph.cell_generation;
+    }
+
+    // Called by the Renderer after the frame the font was drawn in, drops the layouts that went unused for long
+    void end_frame();
+
+    [[nodiscard]] Texture texture() const {
+        return atlas_texture;
+    }
+
+    [[nodiscard]] float line_height() const {
+        return ascent - descent + line_gap;
+    }
+
+    [[nodiscard]] const Stats& font_stats() const {
+        return stats;
+    }
+
+private:
+    static constexpr const uint32_t NO_CELL = UINT32_MAX;
+
+    struct Cell {
+        int glyph_index = 0;
+        // Bumped whenever the cell gets another glyph
+        uint32_t generation = 0;
+        uint64_t last_used_frame = 0;
+        // Least recently used order, the head was drawn last
+        uint32_t previous = NO_CELL;
+        uint32_t next = NO_CELL;
+    };
+
+    // Hashes string views too, looking up a cached layout does not copy the text
+    struct TextHash {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view text) const {
+            return std::hash<std::string_view>{}(text);
+        }
+    };
+
+    // Bitmap box of the glyph relative to its pen position, y down like stb_truetype. Clipped to the cell.
+    void glyph_box(int glyph_index, int& x0, int& y0, int& width, int& height) const;
+
+    // Rasterizes the glyph into a free cell or the least recently used one
+    std::optional<uint32_t> rasterize(int glyph_index);
+
+    // Moves the cell to the head of the least recently used order
+    void touch(uint32_t cell_index);
+
+    void unlink(uint32_t cell_index);
+
+    void build_layout(std::string_view text, Layout& text_layout) const;
+
+private:
+    // stb_truetype reads the glyphs from it until shutdown
+    std::vector<unsigned char> font_data;
+    stbtt_fontinfo font_info;
+
+    float scale;
+    // In pixels, descent is negative
+    float ascent;
+    float descent;
+    float line_gap;
+
+    int cell_size;
+    int cells_per_row;
+    Texture atlas_texture;
+    std::vector<Cell> cells;
+    uint32_t next_free_cell;
+    uint32_t lru_head;
+    uint32_t lru_tail;
+    std::unordered_map<int, uint32_t> resident_glyphs;
+
+    std::unordered_map<std::string, Layout, TextHash, std::equal_to<>> layouts;
+
+    uint64_t frame;
+    Stats stats;
+
+    std::vector<unsigned char> scratch_cell;
+};
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cstdint>
+#include "FrameArena.h"
+
+
+void FrameArena::init(size_t capacity) {
+    for (Region& region: regions) {
+        region.memory = std::make_unique_for_overwrite<std::byte[]>(capacity);
+        region.capacity = capacity;
+        region.cursor = 0;
+        region.overflow.clear();
+        region.overflow_bytes = 0;
+    }
+
+    current = 0;
+    stats = Stats{capacity, 0, 0, 0};
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    Region& region = regions[current];
+
+    const auto base = (uintptr_t) region.memory.get();
+    const uintptr_t aligned = (base + region.cursor + alignment - 1) & ~(uintptr_t) (alignment - 1);
+    const size_t end = aligned - base + bytes;
+
+    if (region.memory != nullptr && end <= region.capacity) {
+        region.cursor = end;
+
+        return (void*) aligned;
+    }
+
+    // Full, served from the heap for the rest of the frame and counted towards the size of the next reset
+    std::unique_ptr<std::byte[]>& block = region.overflow.emplace_back(std::make_unique_for_overwrite<std::byte[]>(bytes + alignment));
+    const auto block_base = (uintptr_t) block.get();
+
+    region.overflow_bytes += bytes + alignment;
+    ++stats.overflow_allocations;
+
+    return (void*) ((block_base + alignment - 1) & ~(uintptr_t) (alignment - 1));
+}
+
+void FrameArena::end_frame() {
+    Region& region = regions[current];
+
+    stats.last_frame_bytes = region.cursor + region.overflow_bytes;
+    stats.high_water = std::max(stats.high_water, stats.last_frame_bytes);
+
+    current = (current + 1) % FRAME_ARENA_FRAMES;
+    reset(regions[current]);
+}
+
+void FrameArena::reset(FrameArena::Region& region) {
+    // Grows once to what the frame actually needed, with some headroom so a slowly growing scene does not regrow every frame
+    if (region.overflow_bytes > 0) {
+        const size_t needed = region.cursor + region.overflow_bytes;
+        region.capacity = std::max(needed + needed / 4, region.capacity * 2);
+        region.memory = std::make_unique_for_overwrite<std::byte[]>(region.capacity);
+        region.overflow.clear();
+        region.overflow_bytes = 0;
+
+        stats.capacity = std::max(stats.capacity, region.capacity);
+    }
+
+    region.cursor = 0;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <array>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+
+// Regions the arena cycles through, memory of a frame stays valid while the next one is recorded
+static constexpr const size_t FRAME_ARENA_FRAMES = 2;
+
+// Arrays start on their own cache line, the transform kernels stream through them
+static constexpr const size_t FRAME_ARENA_ALIGNMENT = 64;
+
+// Linear allocator for memory that lives for a frame. Allocating bumps a cursor and nothing is freed one by one,
+// end_frame() moves to the next region and resets it with a single cursor reset. A region that ran out during its
+// frame served the rest from overflow blocks, the next time it is reset it grows to the high water mark instead, so
+// a steady scene stops touching the heap after its first frames.
+//
+// Only the render thread allocates, the memory may be read and written by the build jobs of the frame.
+class FrameArena {
+public:
+    struct Stats {
+        // Bytes of one region
+        size_t capacity;
+        // Most bytes a single frame used, overflow included
+        size_t high_water;
+        size_t last_frame_bytes;
+        // Allocations served outside of the region since init, non zero means the capacity is too small
+        size_t overflow_allocations;
+    };
+
+    FrameArena() : regions {}, current { 0 }, stats {} {
+
+    }
+
+    FrameArena(const FrameArena&) = delete;
+
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void init(size_t capacity);
+
+    // Valid until the end_frame() after the next one
+    [[nodiscard]] void* allocate(size_t bytes, size_t alignment = FRAME_ARENA_ALIGNMENT);
+
+    template<typename T>
+    [[nodiscard]] T* allocate_array(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "Frame memory is dropped without running destructors");
+
+        return (T*) allocate(count * sizeof(T), std::max(alignof(T), FRAME_ARENA_ALIGNMENT));
+    }
+
+    // Ends the current frame, the frame before it is released and its region starts the next frame
+    void end_frame();
+
+    [[nodiscard]] const Stats& frame_stats() const {
+        return stats;
+    }
+
+private:
+    struct Region {
+        std::unique_ptr<std::byte[]> memory;
+        size_t capacity = 0;
+        size_t cursor = 0;
+        // Served from the heap once the region was full, freed when the region is reset
+        std::vector<std::unique_ptr<std::byte[]>> overflow;
+        size_t overflow_bytes = 0;
+    };
+
+    void reset(Region& region);
+
+private:
+    std::array<Region, FRAME_ARENA_FRAMES> regions;
+    size_t current;
+    Stats stats;
+};
+
+// Fixed capacity array in frame memory. It is a plain view, copying it copies the pointer and dropping it frees
+// nothing, so containers of them can live in frame memory themselves. The element type must be trivially copyable.
+template<typename T>
+class FrameArray {
+    static_assert(std::is_trivially_copyable_v<T>, "FrameArray moves its elements with memcpy");
+
+public:
+    FrameArray() : items { nullptr }, count { 0 }, capacity { 0 } {
+
+    }
+
+    // Replaces the storage with room for capacity_ elements, the array starts empty
+    void allocate(FrameArena& arena, size_t capacity_) {
+        items = arena.allocate_array<T>(capacity_);
+        count = 0;
+        capacity = capacity_;
+    }
+
+    T& push_back(const T& item) {
+        assert(count < capacity);
+
+        items[count] = item;
+
+        return items[count++];
+    }
+
+    // Doubles the storage when full, the old storage is left to the arena
+    T& push_back(FrameArena& arena, const T& item) {
+        if (count == capacity) {
+            T* previous = items;
+            const size_t previous_count = count;
+
+            allocate(arena, std::max<size_t>(capacity * 2, 16));
+            if (previous_count > 0) {
+                memcpy((void*) items, previous, previous_count * sizeof(T));
+            }
+            count = previous_count;
+        }
+
+        return push_back(item);
+    }
+
+    // Appends added elements for the caller to write and returns the first, the storage grows like push_back(arena, item)
+    T* append(FrameArena& arena, size_t added) {
+        if (count + added > capacity) {
+            T* previous = items;
+            const size_t previous_count = count;
+
+            allocate(arena, std::max<size_t>(std::max(capacity * 2, count + added), 16));
+            if (previous_count > 0) {
+                memcpy((void*) items, previous, previous_count * sizeof(T));
+            }
+            count = previous_count;
+        }
+
+        T* first = items + count;
+        count += added;
+
+        return first;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+
+    [[nodiscard]] T* data() {
+        return items;
+    }
+
+    [[nodiscard]] const T* data() const {
+        return items;
+    }
+
+    // The whole storage, used or not, e.g. to be written by a kernel
+    [[nodiscard]] std::span<T> storage() {
+        return std::span{items, capacity};
+    }
+
+    T& operator[](size_t index) {
+        assert(index < count);
+
+        return items[index];
+    }
+
+    const T& operator[](size_t index) const {
+        assert(index < count);
+
+        return items[index];
+    }
+
+    T& back() {
+        assert(count > 0);
+
+        return items[count - 1];
+    }
+
+    T* begin() {
+        return items;
+    }
+
+    T* end() {
+        return items + count;
+    }
+
+    const T* begin() const {
+        return items;
+    }
+
+    const T* end() const {
+        return items + count;
+    }
+
+private:
+    T* items;
+    size_t count;
+    size_t capacity;
+};
@@ -0,0 +1,173 @@
+#include "JobSystem.h"
+
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+void JobSystem::init(size_t worker_count) {
+    shutdown();
+
+    stopping = false;
+
+    // Queue 0 belongs to the thread calling run()
+    for (size_t i = 0; i < worker_count + 1; ++i) {
+        queues.push_back(std::make_unique<JobQueue>());
+    }
+
+    for (size_t i = 1; i < worker_count + 1; ++i) {
+        workers.emplace_back(&JobSystem::worker_loop, this, i);
+    }
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard lock{wake_mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& worker: workers) {
+        worker.join();
+    }
+
+    workers.clear();
+    queues.clear();
+}
+
+void JobSystem::run(std::span<const Job> jobs) {
+    if (jobs.empty()) {
+        return;
+    }
+
+    pending.fetch_add(jobs.size(), std::memory_order_relaxed);
+
+    // Spread the jobs over every queue, a full queue runs its job right away
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const Job& job = jobs[i];
+
+        if (!queues[i % queues.size()]->push(job)) {
+            job.function(job.context, job.index);
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    {
+        std::lock_guard lock{wake_mutex};
+        ++generation;
+    }
+    wake.notify_all();
+
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!execute_one(0)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::dispatch(const Job& job) {
+    if (workers.empty()) {
+        job.function(job.context, job.index);
+
+        return;
+    }
+
+    pending.fetch_add(1, std::memory_order_relaxed);
+
+    // Round robin over the worker queues, queue 0 only gets drained by run()
+    dispatch_queue = dispatch_queue % workers.size() + 1;
+    if (!queues[dispatch_queue]->push(job)) {
+        job.function(job.context, job.index);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+
+        return;
+    }
+
+    {
+        std::lock_guard lock{wake_mutex};
+        ++generation;
+    }
+    wake.notify_one();
+}
+
+size_t JobSystem::thread_count() const {
+    return workers.size() + 1;
+}
+
+void JobSystem::worker_loop(size_t queue_index) {
+    size_t seen_generation = 0;
+
+    while (true) {
+        while (execute_one(queue_index)) {
+        }
+
+        std::unique_lock lock{wake_mutex};
+        wake.wait(lock, [&]() {
+            return stopping || generation != seen_generation;
+        });
+
+        if (stopping) {
+            return;
+        }
+
+        seen_generation = generation;
+    }
+}
+
+bool JobSystem::execute_one(size_t queue_index) {
+    Job job{};
+    bool found = queues[queue_index]->pop(job);
+
+    for (size_t i = 1; !found && i < queues.size(); ++i) {
+        found = queues[(queue_index + i) % queues.size()]->steal(job);
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    job.function(job.context, job.index);
+    pending.fetch_sub(1, std::memory_order_acq_rel);
+
+    return true;
+}
+
+bool JobSystem::JobQueue::push(const Job& job) {
+    std::lock_guard lock{mutex};
+
+    if (size == jobs.size()) {
+        return false;
+    }
+
+    jobs[(head + size) % jobs.size()] = job;
+    ++size;
+
+    return true;
+}
+
+bool JobSystem::JobQueue::pop(Job& job) {
+    std::lock_guard lock{mutex};
+
+    if (size == 0) {
+        return false;
+    }
+
+    --size;
+    job = jobs[(head + size) % jobs.size()];
+
+    return true;
+}
+
+bool JobSystem::JobQueue::steal(Job& job) {
+    std::lock_guard lock{mutex};
+
+    if (size == 0) {
+        return false;
+    }
+
+    job = jobs[head];
+    head = (head + 1) % jobs.size();
+    --size;
+
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+
+static constexpr const size_t JOB_QUEUE_CAPACITY = 4096;
+
+// A small work-stealing job system. Every thread, including the one calling run(), owns a queue. Owners pop from the
+// back of their queue, idle threads steal from the front of the others.
+class JobSystem {
+public:
+    // Jobs are plain function pointers with a context so queuing them never allocates
+    struct Job {
+        void (* function)(void* context, size_t index);
+        void* context;
+        size_t index;
+    };
+
+    JobSystem() : queues {}, workers {}, pending { 0 }, dispatch_queue { 0 }, generation { 0 }, stopping { false } {
+
+    }
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Starts worker_count threads next to the calling thread. Zero runs every job on the calling thread.
+    void init(size_t worker_count);
+
+    void shutdown();
+
+    // Runs all jobs and returns once every one of them finished. The calling thread works on them as well.
+    void run(std::span<const Job> jobs);
+
+    // Queues a job and returns right away, a worker thread picks it up. Without workers the job runs on the calling
+    // thread before this returns. Dispatched jobs count as pending for run(), so a system should be used for one or the other.
+    void dispatch(const Job& job);
+
+    // Number of threads executing jobs, the calling thread included
+    [[nodiscard]] size_t thread_count() const;
+
+private:
+    // Fixed capacity ring of jobs guarded by a mutex
+    struct JobQueue {
+        std::mutex mutex;
+        std::vector<Job> jobs = std::vector<Job>(JOB_QUEUE_CAPACITY);
+        size_t head = 0;
+        size_t size = 0;
+
+        bool push(const Job& job);
+
+        bool pop(Job& job);
+
+        bool steal(Job& job);
+    };
+
+    void worker_loop(size_t queue_index);
+
+    // Executes one job from the queue at queue_index or, if it is empty, one stolen from another queue
+    bool execute_one(size_t queue_index);
+
+private:
+    std::vector<std::unique_ptr<JobQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<size_t> pending;
+    // Worker queue the next dispatched job goes to
+    size_t dispatch_queue;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    size_t generation;
+    bool stopping;
+};
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cassert>
+#include "MultiDraw.h"
+#include "RenderBatch.h"
+#include "Texture.h"
+#include "Profiler.h"
+
+
+void MultiDraw::init() {
+    this->gpu = Gpu{0, 0, 0, 0, 0};
+
+    glCreateVertexArrays(1, &gpu.gl_vao_id);
+    glCreateBuffers(1, &gpu.gl_vbo_id);
+    glCreateBuffers(1, &gpu.gl_ibo_id);
+    glCreateBuffers(1, &gpu.gl_draw_vbo_id);
+    glCreateBuffers(1, &gpu.gl_indirect_id);
+
+    vertex_stream.init(gpu.gl_vbo_id, sizeof(Shape::BatchVertex), MAX_VERTICES * MULTI_DRAW_SEGMENT_RENDER_BUFFERS);
+    index_stream.init(gpu.gl_ibo_id, sizeof(BatchIndex), MAX_INDICES * MULTI_DRAW_SEGMENT_RENDER_BUFFERS);
+    draw_stream.init(gpu.gl_draw_vbo_id, sizeof(MultiDrawData), MULTI_DRAW_SEGMENT_COMMANDS);
+    command_stream.init(gpu.gl_indirect_id, sizeof(DrawElementsIndirectCommand), MULTI_DRAW_SEGMENT_COMMANDS);
+
+    set_vertex_format<Shape::BatchVertex>(gpu.gl_vao_id, 0, gpu.gl_vbo_id);
+    set_vertex_format<MultiDrawData>(gpu.gl_vao_id, 1, gpu.gl_draw_vbo_id, 1);
+    glVertexArrayElementBuffer(gpu.gl_vao_id, gpu.gl_ibo_id);
+
+    shader_program.init("shader/multi_draw_quad.vert", "shader/filled_quad.frag");
+}
+
+void MultiDraw::add(const RenderBatch& batch, size_t first_buffer, size_t end_buffer) {
+    const Pipeline& pipeline = batch.pipeline();
+
+    for (size_t i = first_buffer; i < end_buffer; ++i) {
+        const RenderBatch::IndirectBuffer buffer = batch.indirect_buffer(i);
+
+        RTC_PROFILE_COUNT(VERTICES, buffer.vertices_count);
+        RTC_PROFILE_COUNT(INDICES, buffer.indices_count);
+        RTC_PROFILE_COUNT(BYTES_UPLOADED, buffer.vertices_count * sizeof(Shape::BatchVertex) + buffer.indices_count * sizeof(BatchIndex));
+
+        // The base instance is only known once the draw data is allocated
+        draws.push_back(Draw{pipeline.gl_render_mode,
+                             pipeline.blend_mode,
+                             DrawElementsIndirectCommand{(GLuint) buffer.indices_count, 1, (GLuint) buffer.first_index, (GLint) buffer.first_vertex, 0},
+                             buffer.textures});
+    }
+}
+
+size_t MultiDraw::submit() {
+    if (draws.empty()) {
+        return 0;
+    }
+
+    RTC_PROFILE_SCOPE("MultiDraw::submit");
+    RTC_PROFILE_GPU_BEGIN("MultiDraw::submit");
+    RTC_PROFILE_COUNT(INDIRECT_DRAWS, draws.size());
+
+    shader_program.bind();
+    glBindVertexArray(gpu.gl_vao_id);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpu.gl_indirect_id);
+
+    size_t draw_calls = 0;
+
+    for (size_t first_draw = 0; first_draw < draws.size(); first_draw += MULTI_DRAW_SEGMENT_COMMANDS) {
+        draw_calls += submit_part(first_draw, std::min(first_draw + MULTI_DRAW_SEGMENT_COMMANDS, draws.size()));
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    RTC_PROFILE_GPU_END();
+
+    draws.clear();
+
+    return draw_calls;
+}
+
+void MultiDraw::end_wave() {
+    vertex_stream.end_wave();
+    index_stream.end_wave();
+    draw_stream.end_wave();
+    command_stream.end_wave();
+}
+
+size_t MultiDraw::submit_part(size_t first_draw, size_t end_draw) {
+    const size_t count = end_draw - first_draw;
+
+    std::optional<StreamBuffer::Allocation> commands = command_stream.allocate(count);
+    std::optional<StreamBuffer::Allocation> draw_data = draw_stream.allocate(count);
+
+    // Every segment holds commands of this wave, fence what was issued and wait for the oldest segment instead
+    if (!commands.has_value() || !draw_data.has_value()) {
+        command_stream.end_wave();
+        draw_stream.end_wave();
+
+        commands = command_stream.allocate(count);
+        draw_data = draw_stream.allocate(count);
+    }
+
+    assert(commands.has_value() && draw_data.has_value());
+
+    auto* command_cursor = (DrawElementsIndirectCommand*) commands->data;
+    auto* draw_data_cursor = (MultiDrawData*) draw_data->data;
+
+    CallTextures call_textures{};
+    size_t call_first = 0;
+    size_t draw_calls = 0;
+
+    // Draws are written as they join the call, a draw that does not fit issues the call first
+    const auto issue_call = [&](size_t call_end) {
+        const Draw& first = draws[first_draw + call_first];
+        const size_t first_command = commands->first_element + call_first;
+
+        bind_textures(call_textures);
+        apply_blend_mode(first.blend_mode);
+        glMultiDrawElementsIndirect(first.gl_render_mode, BATCH_INDEX_TYPE, (const void*) (first_command * sizeof(DrawElementsIndirectCommand)),
+                                    (GLsizei) (call_end - call_first), 0);
+
+        RTC_PROFILE_COUNT(DRAW_CALLS, 1);
+        ++draw_calls;
+    };
+
+    for (size_t d = 0; d < count; ++d) {
+        const Draw& draw = draws[first_draw + d];
+        uint32_t texture_units = 0;
+
+        const Draw& call = draws[first_draw + call_first];
+        const bool same_mode = draw.gl_render_mode == call.gl_render_mode && draw.blend_mode == call.blend_mode;
+
+        if (!same_mode || !assign_texture_units(draw, call_textures, texture_units)) {
+            issue_call(d);
+
+            call_first = d;
+            call_textures = CallTextures{};
+
+            // A single render buffer never binds more textures than there are slots
+            bool assigned = assign_texture_units(draw, call_textures, texture_units);
+            assert(assigned);
+            (void) assigned;
+        }
+
+        DrawElementsIndirectCommand command = draw.command;
+        command.base_instance = (GLuint) (draw_data->first_element + d);
+
+        *command_cursor++ = command;
+        *draw_data_cursor++ = MultiDrawData{texture_units};
+    }
+
+    issue_call(count);
+
+    RTC_PROFILE_COUNT(BYTES_UPLOADED, count * (sizeof(DrawElementsIndirectCommand) + sizeof(MultiDrawData)));
+
+    return draw_calls;
+}
+
+bool MultiDraw::assign_texture_units(const MultiDraw::Draw& draw, MultiDraw::CallTextures& call_textures, uint32_t& texture_units) {
+    CallTextures joined = call_textures;
+    uint32_t units = 0;
+
+    for (size_t slot = 0; slot < draw.textures.size(); ++slot) {
+        const GLuint texture_id = draw.textures[slot];
+        const GLuint* bound_begin = joined.texture_ids.data();
+        const GLuint* bound_end = bound_begin + joined.count;
+        const GLuint* bound = std::find(bound_begin, bound_end, texture_id);
+
+        if (bound == bound_end) {
+            if (joined.count == MAX_TEXTURES) {
+                return false;
+            }
+
+            joined.texture_ids[joined.count++] = texture_id;
+        }
+
+        // Slot s of the render buffer is slot s + 1 in the material, unit u of the call is unit u + 1
+        const auto unit = (uint32_t) (bound - bound_begin + 1);
+        units |= unit << (4 * slot);
+    }
+
+    call_textures = joined;
+    texture_units = units;
+
+    return true;
+}
+
+void MultiDraw::bind_textures(const MultiDraw::CallTextures& call_textures) {
+    glBindTextureUnit(0, Texture::empty_texture.id);
+
+    for (size_t i = 0; i < call_textures.count; ++i) {
+        glBindTextureUnit(i + 1, call_textures.texture_ids[i]);
+    }
+
+    RTC_PROFILE_COUNT(TEXTURE_BINDS, call_textures.count + 1);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "ShaderProgram.h"
+#include "Pipeline.h"
+#include "StreamBuffer.h"
+#include "VertexFormat.h"
+
+
+class RenderBatch;
+
+// Render buffers of all batches together that one segment of the shared vertex and index rings holds
+static constexpr const size_t MULTI_DRAW_SEGMENT_RENDER_BUFFERS = 32;
+
+// Indirect draws per segment of the command ring, a wave with more is submitted in parts
+static constexpr const size_t MULTI_DRAW_SEGMENT_COMMANDS = 4096;
+
+// Record of glMultiDrawElementsIndirect, the layout is fixed by GL
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match the GL layout");
+
+// Per draw input of multi_draw_quad.vert. Every command draws a single instance with its own index as base instance,
+// so the attribute advances once per draw.
+struct MultiDrawData {
+    // Texture unit of every render buffer slot, four bits per slot starting with slot 1. Slot 0 is always unit 0.
+    uint32_t texture_units;
+};
+
+static_assert(MAX_TEXTURES <= 8, "The texture units of a draw are packed into four bits per slot");
+
+template<>
+struct VertexFormat<MultiDrawData> {
+    static constexpr const VertexAttribute ATTRIBUTES[] = {
+            {5, 1, GL_UNSIGNED_INT, GL_FALSE, true, offsetof(MultiDrawData, texture_units)}
+    };
+};
+
+// Draws the render buffers of every batch out of one shared vertex and index arena. The render buffers of a wave are
+// turned into indirect commands and drawn with as few glMultiDrawElementsIndirect calls as possible, one program and
+// one vertex array serve all shapes. A call ends where the render or blend mode changes or where the textures of its
+// draws no longer fit the texture units, every draw maps its texture slots onto the units of its call.
+class MultiDraw {
+public:
+    MultiDraw() : gpu {}, vertex_stream {}, index_stream {}, draw_stream {}, command_stream {}, shader_program {}, draws {} {
+
+    }
+
+    MultiDraw(const MultiDraw&) = delete;
+
+    MultiDraw& operator=(const MultiDraw&) = delete;
+
+    // Creates the shared arena and the program that replaces the shape programs
+    void init();
+
+    // Rings the batches reserve their render buffers from instead of their own
+    [[nodiscard]] StreamBuffer& vertices() {
+        return vertex_stream;
+    }
+
+    [[nodiscard]] StreamBuffer& indices() {
+        return index_stream;
+    }
+
+    // Queues the built render buffers in [first_buffer, end_buffer) of the batch for the next submit()
+    void add(const RenderBatch& batch, size_t first_buffer, size_t end_buffer);
+
+    // Draws everything added since the last submit in order, returns the GL draw calls that took
+    size_t submit();
+
+    // Fences the ring memory of everything submitted since the last wave
+    void end_wave();
+
+private:
+    struct Gpu {
+        GLuint gl_vao_id;
+        GLuint gl_vbo_id;
+        GLuint gl_ibo_id;
+        GLuint gl_draw_vbo_id;
+        GLuint gl_indirect_id;
+    };
+
+    // A render buffer waiting for submit(), its textures live in frame memory until the batch ends the frame
+    struct Draw {
+        GLenum gl_render_mode;
+        BlendMode blend_mode;
+        DrawElementsIndirectCommand command;
+        std::span<const GLuint> textures;
+    };
+
+    // Textures bound for the call being assembled, unit 0 is the empty texture
+    struct CallTextures {
+        std::array<GLuint, MAX_TEXTURES> texture_ids;
+        size_t count;
+    };
+
+    // Writes the commands of draws [first_draw, end_draw) and issues them, returns the GL draw calls that took
+    size_t submit_part(size_t first_draw, size_t end_draw);
+
+    // Units of the draw's textures within the call, false when they do not all fit next to the bound ones
+    static bool assign_texture_units(const Draw& draw, CallTextures& call_textures, uint32_t& texture_units);
+
+    static void bind_textures(const CallTextures& call_textures);
+
+private:
+    Gpu gpu;
+    StreamBuffer vertex_stream;
+    StreamBuffer index_stream;
+    StreamBuffer draw_stream;
+    StreamBuffer command_stream;
+
+    ShaderProgram shader_program;
+
+    // Cleared every submit but keeping its memory
+    std::vector<Draw> draws;
+};
@@ -0,0 +1,26 @@
+#include "Pipeline.h"
+
+
+void apply_blend_mode(BlendMode blend_mode) {
+    switch (blend_mode) {
+        case BlendMode::ALPHA:
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+        case BlendMode::ADDITIVE:
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+            break;
+    }
+}
+
+void apply_render_pass(RenderPass pass) {
+    switch (pass) {
+        case RenderPass::OPAQUE:
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+            break;
+        case RenderPass::BLENDED:
+            glDepthMask(GL_FALSE);
+            glEnable(GL_BLEND);
+            break;
+    }
+}
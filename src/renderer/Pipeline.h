@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+
+struct Shape;
+
+// How the fragments of a shape are combined with what is already drawn
+enum class BlendMode : uint8_t {
+    // Translucent sprites and the anti-aliased edges of primitives cover what is below by their alpha
+    ALPHA,
+    // Adds onto what is below, e.g. lights and glows
+    ADDITIVE
+};
+
+// Sets the GL blend function of the mode, blending itself stays enabled
+void apply_blend_mode(BlendMode blend_mode);
+
+// Draws of a frame are split in two passes, both depth tested. Opaque draws are drawn first, front to back, so the
+// depth test rejects the fragments of everything they hide before it is shaded. Blended draws follow back to front.
+enum class RenderPass : uint8_t {
+    // Cover their whole shape with full alpha, write depth and skip blending
+    OPAQUE,
+    // Everything else, blended over what is drawn without writing depth
+    BLENDED
+};
+
+// Sets the depth writes and blending of the pass
+void apply_render_pass(RenderPass pass);
+
+// The GL state draws of one RenderBatch share. Shapes with equal pipelines go into the same render buffers, whatever
+// their geometry.
+struct Pipeline {
+    GLuint shader_program;
+    GLenum gl_render_mode;
+    BlendMode blend_mode;
+    // Instanced draws read the geometry of a single shape, so there it is part of the pipeline. nullptr when batched,
+    // the batched vertices are the same layout for every shape.
+    const Shape* instanced_shape;
+
+    bool operator==(const Pipeline& other) const {
+        return shader_program == other.shader_program &&
+               gl_render_mode == other.gl_render_mode &&
+               blend_mode == other.blend_mode &&
+               instanced_shape == other.instanced_shape;
+    }
+
+    struct Hash {
+        size_t operator()(const Pipeline& pipeline) const {
+            size_t hash = std::hash<const Shape*>{}(pipeline.instanced_shape);
+            hash = hash * 31 + pipeline.shader_program;
+            hash = hash * 31 + pipeline.gl_render_mode;
+            hash = hash * 31 + (size_t) pipeline.blend_mode;
+
+            return hash;
+        }
+    };
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+
+// Shapes evaluated per pixel by a signed distance in filled_quad.frag. A primitive is drawn on a single quad and batches
+// with every other drawable of that quad, its edge is anti-aliased over one screen pixel.
+enum class PrimitiveKind {
+    // Plain quad, the values must match the PRIMITIVE_* constants of filled_quad.frag
+    NONE = 0,
+    // The circle inscribed in the quad
+    CIRCLE = 1,
+    // Outline of the inscribed circle, thickness wide
+    RING = 2,
+    // The quad with its corners rounded by corner_radius
+    ROUNDED_RECT = 3
+};
+
+// Drawables that are not a primitive
+static constexpr const glm::vec4 NO_PRIMITIVE = glm::vec4{0.0F, 0.0F, 0.0F, 0.0F};
+
+struct Primitive {
+    PrimitiveKind kind = PrimitiveKind::CIRCLE;
+    // In world units, like the scale of the quad
+    float corner_radius = 0.0F;
+    float thickness = 0.0F;
+
+    // Packed per drawable: kind, then corner radius and thickness relative to the quad width, so the shader can scale
+    // them by the on screen size of the quad.
+    [[nodiscard]] glm::vec4 shape_params(glm::vec2 scale) const {
+        const float width = scale.x != 0.0F ? scale.x : 1.0F;
+
+        return glm::vec4{(float) kind, corner_radius / width, thickness / width, 0.0F};
+    }
+};
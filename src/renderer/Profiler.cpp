@@ -0,0 +1,358 @@
+#include "Profiler.h"
+
+#ifdef RTC_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include <glad/glad.h>
+
+
+namespace {
+    // Trace track of the GPU timers, CPU threads are numbered from 1 in the order they first record an event
+    constexpr const uint32_t GPU_TRACK = 0;
+
+    struct TraceEvent {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        uint32_t track;
+    };
+
+    struct CapturedFrame {
+        uint64_t end_ns;
+        Profiler::FrameStats stats;
+    };
+
+    // The timer queries of one frame in flight, every timer owns a begin and an end timestamp query
+    struct GpuFrame {
+        std::array<GLuint, PROFILER_MAX_GPU_TIMERS * 2> queries;
+        std::array<const char*, PROFILER_MAX_GPU_TIMERS> names;
+        size_t timer_count;
+        uint64_t frame;
+    };
+
+    bool gpu_ready = false;
+    std::array<GpuFrame, PROFILER_GPU_LATENCY> gpu_frames{};
+    size_t gpu_frame = 0;
+    bool gpu_timer_open = false;
+    // GPU timestamps plus this offset land on the CPU clock of the trace
+    int64_t gpu_to_cpu_ns = 0;
+
+    uint64_t frame = 0;
+    uint64_t frame_start_ns = 0;
+    std::array<uint64_t, Profiler::COUNTER_COUNT> frame_counters{};
+    std::array<Profiler::FrameStats, PROFILER_FRAME_HISTORY> frame_history{};
+
+    std::atomic<bool> capturing{false};
+    size_t capture_frames_left = 0;
+    bool captured = false;
+    std::mutex capture_mutex;
+    std::vector<TraceEvent> trace_events;
+    std::vector<CapturedFrame> captured_frames;
+
+    std::atomic<uint32_t> next_track{GPU_TRACK + 1};
+    thread_local uint32_t thread_track = 0;
+
+    uint64_t now_ns() {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t current_track() {
+        if (thread_track == 0) {
+            thread_track = next_track.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return thread_track;
+    }
+
+    void record_event(const char* name, uint64_t start_ns, uint64_t duration_ns, uint32_t track) {
+        if (!capturing.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        std::lock_guard lock{capture_mutex};
+        if (trace_events.size() < PROFILER_MAX_TRACE_EVENTS) {
+            trace_events.push_back(TraceEvent{name, start_ns, duration_ns, track});
+        }
+    }
+
+    // Blocks until the queries of the frame are done. They were issued PROFILER_GPU_LATENCY frames ago, so this
+    // normally returns right away.
+    void read_gpu_frame(GpuFrame& gpu) {
+        if (gpu.timer_count == 0) {
+            return;
+        }
+
+        uint64_t gpu_ns = 0;
+        for (size_t t = 0; t < gpu.timer_count; ++t) {
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(gpu.queries[t * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(gpu.queries[t * 2 + 1], GL_QUERY_RESULT, &end);
+
+            gpu_ns += end - begin;
+            record_event(gpu.names[t], (uint64_t) ((int64_t) begin + gpu_to_cpu_ns), end - begin, GPU_TRACK);
+        }
+
+        // The frame may already have left the history when the latency is larger than it
+        if (frame - gpu.frame < PROFILER_FRAME_HISTORY) {
+            frame_history[gpu.frame % PROFILER_FRAME_HISTORY].gpu_ms = (double) gpu_ns / 1.0e6;
+        }
+
+        gpu.timer_count = 0;
+    }
+}
+
+Profiler::ScopedTimer::ScopedTimer(const char* name_) : name { name_ }, start_ns { now_ns() } {
+
+}
+
+Profiler::ScopedTimer::~ScopedTimer() {
+    if (capturing.load(std::memory_order_relaxed)) {
+        record_event(name, start_ns, now_ns() - start_ns, current_track());
+    }
+}
+
+void Profiler::init() {
+    for (GpuFrame& gpu: gpu_frames) {
+        glGenQueries((GLsizei) gpu.queries.size(), gpu.queries.data());
+        gpu.timer_count = 0;
+    }
+
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_to_cpu_ns = (int64_t) now_ns() - gpu_now;
+
+    gpu_ready = true;
+    frame_start_ns = now_ns();
+}
+
+void Profiler::shutdown() {
+    if (!gpu_ready) {
+        return;
+    }
+
+    for (GpuFrame& gpu: gpu_frames) {
+        glDeleteQueries((GLsizei) gpu.queries.size(), gpu.queries.data());
+    }
+
+    gpu_ready = false;
+}
+
+void Profiler::count(Profiler::Counter counter, uint64_t amount) {
+    frame_counters[(size_t) counter] += amount;
+}
+
+void Profiler::begin_gpu_timer(const char* name) {
+    GpuFrame& gpu = gpu_frames[gpu_frame];
+    if (!gpu_ready || gpu.timer_count == PROFILER_MAX_GPU_TIMERS) {
+        return;
+    }
+
+    gpu.names[gpu.timer_count] = name;
+    glQueryCounter(gpu.queries[gpu.timer_count * 2], GL_TIMESTAMP);
+    gpu_timer_open = true;
+}
+
+void Profiler::end_gpu_timer() {
+    if (!gpu_timer_open) {
+        return;
+    }
+
+    GpuFrame& gpu = gpu_frames[gpu_frame];
+    glQueryCounter(gpu.queries[gpu.timer_count * 2 + 1], GL_TIMESTAMP);
+    ++gpu.timer_count;
+    gpu_timer_open = false;
+}
+
+void Profiler::end_frame() {
+    uint64_t end_ns = now_ns();
+
+    FrameStats& stats = frame_history[frame % PROFILER_FRAME_HISTORY];
+    stats.frame = frame;
+    stats.cpu_ms = (double) (end_ns - frame_start_ns) / 1.0e6;
+    stats.gpu_ms = -1.0;
+    stats.counters = frame_counters;
+
+    if (gpu_ready) {
+        gpu_frames[gpu_frame].frame = frame;
+
+        // The oldest frame in flight makes room for the next one
+        gpu_frame = (gpu_frame + 1) % PROFILER_GPU_LATENCY;
+        read_gpu_frame(gpu_frames[gpu_frame]);
+    }
+
+    if (capturing.load(std::memory_order_relaxed)) {
+        std::lock_guard lock{capture_mutex};
+        captured_frames.push_back(CapturedFrame{end_ns, stats});
+
+        if (--capture_frames_left == 0) {
+            capturing.store(false, std::memory_order_relaxed);
+            captured = true;
+        }
+    }
+
+    frame_counters.fill(0);
+    frame_start_ns = end_ns;
+    ++frame;
+}
+
+const Profiler::FrameStats* Profiler::frame_stats(size_t frames_ago) {
+    if (frames_ago >= PROFILER_FRAME_HISTORY || frames_ago >= frame) {
+        return nullptr;
+    }
+
+    return &frame_history[(frame - 1 - frames_ago) % PROFILER_FRAME_HISTORY];
+}
+
+const char* Profiler::counter_name(Profiler::Counter counter) {
+    switch (counter) {
+        case Counter::DRAW_CALLS:
+            return "draw_calls";
+        case Counter::VERTICES:
+            return "vertices";
+        case Counter::INDICES:
+            return "indices";
+        case Counter::INSTANCES:
+            return "instances";
+        case Counter::BYTES_UPLOADED:
+            return "bytes_uploaded";
+        case Counter::TEXTURE_BINDS:
+            return "texture_binds";
+        case Counter::SPLITS_SORT_ORDER:
+            return "splits_sort_order";
+        case Counter::SPLITS_VERTEX_LIMIT:
+            return "splits_vertex_limit";
+        case Counter::SPLITS_INDEX_LIMIT:
+            return "splits_index_limit";
+        case Counter::SPLITS_TEXTURE_SLOTS:
+            return "splits_texture_slots";
+        case Counter::TILE_CELLS_UPLOADED:
+            return "tile_cells_uploaded";
+        case Counter::DRAWS_CULLED:
+            return "draws_culled";
+        case Counter::GLYPHS_RASTERIZED:
+            return "glyphs_rasterized";
+        case Counter::UI_WIDGETS_REBUILT:
+            return "ui_widgets_rebuilt";
+        case Counter::INDIRECT_DRAWS:
+            return "indirect_draws";
+        default:
+            return "unknown";
+    }
+}
+
+void Profiler::capture(size_t frame_count) {
+    if (frame_count == 0) {
+        return;
+    }
+
+    std::lock_guard lock{capture_mutex};
+
+    // Reserved up front so recording never allocates in the middle of a frame
+    trace_events.clear();
+    trace_events.reserve(PROFILER_MAX_TRACE_EVENTS);
+    captured_frames.clear();
+    captured_frames.reserve(frame_count);
+
+    capture_frames_left = frame_count;
+    captured = false;
+    capturing.store(true, std::memory_order_relaxed);
+}
+
+bool Profiler::capture_finished() {
+    return captured;
+}
+
+bool Profiler::write_chrome_trace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open trace file: %s\n", path);
+
+        return false;
+    }
+
+    std::lock_guard lock{capture_mutex};
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU_TRACK);
+
+    // Timestamps are in microseconds
+    for (const TraceEvent& event: trace_events) {
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, event.track, (double) event.start_ns / 1.0e3, (double) event.duration_ns / 1.0e3);
+    }
+
+    for (const CapturedFrame& captured_frame: captured_frames) {
+        fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{", (double) captured_frame.end_ns / 1.0e3);
+
+        for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+            fprintf(file, "%s\"%s\":%llu", c == 0 ? "" : ",", counter_name((Counter) c),
+                    (unsigned long long) captured_frame.stats.counters[c]);
+        }
+
+        fprintf(file, "}}");
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    return true;
+}
+
+#else
+
+Profiler::ScopedTimer::ScopedTimer(const char* name_) : name { name_ }, start_ns { 0 } {
+
+}
+
+Profiler::ScopedTimer::~ScopedTimer() = default;
+
+void Profiler::init() {
+
+}
+
+void Profiler::shutdown() {
+
+}
+
+void Profiler::count(Profiler::Counter, uint64_t) {
+
+}
+
+void Profiler::begin_gpu_timer(const char*) {
+
+}
+
+void Profiler::end_gpu_timer() {
+
+}
+
+void Profiler::end_frame() {
+
+}
+
+const Profiler::FrameStats* Profiler::frame_stats(size_t) {
+    return nullptr;
+}
+
+const char* Profiler::counter_name(Profiler::Counter) {
+    return "unknown";
+}
+
+void Profiler::capture(size_t) {
+
+}
+
+bool Profiler::capture_finished() {
+    return false;
+}
+
+bool Profiler::write_chrome_trace(const char*) {
+    return false;
+}
+
+#endif
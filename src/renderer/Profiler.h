@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+// Frames of statistics kept around for the caller to read
+static constexpr const size_t PROFILER_FRAME_HISTORY = 256;
+
+// Upper bound of CPU and GPU events recorded by one capture, events past it are dropped
+static constexpr const size_t PROFILER_MAX_TRACE_EVENTS = 1 << 16;
+
+// GPU timers that can be open in a single frame
+static constexpr const size_t PROFILER_MAX_GPU_TIMERS = 256;
+
+// Frames the GPU timer queries of a frame stay in flight before they are read back
+static constexpr const size_t PROFILER_GPU_LATENCY = 3;
+
+// Instrumentation of the renderer: scoped CPU timers, per frame counters and GL timer queries. Frame statistics go into
+// a ring of the last PROFILER_FRAME_HISTORY frames, a capture of events can be written as a Chrome trace (JSON, open it
+// in chrome://tracing or Perfetto).
+//
+// Only compiled in when the build defines RTC_PROFILE (CMake option of the same name). Without it the RTC_PROFILE_*
+// macros expand to nothing and the renderer carries no instrumentation at all.
+namespace Profiler {
+    enum class Counter {
+        DRAW_CALLS,
+        VERTICES,
+        INDICES,
+        INSTANCES,
+        BYTES_UPLOADED,
+        TEXTURE_BINDS,
+        // Render buffer splits by reason
+        SPLITS_SORT_ORDER,
+        SPLITS_VERTEX_LIMIT,
+        SPLITS_INDEX_LIMIT,
+        SPLITS_TEXTURE_SLOTS,
+        // Tile map cells whose vertices were uploaded again
+        TILE_CELLS_UPLOADED,
+        // Draws skipped because they are outside of the camera view
+        DRAWS_CULLED,
+        // Glyphs rasterized into a font atlas, by first use or after their cell was evicted
+        GLYPHS_RASTERIZED,
+        // Retained UI widgets laid out and uploaded again after they changed
+        UI_WIDGETS_REBUILT,
+        // Render buffers drawn as commands of a multi draw indirect call
+        INDIRECT_DRAWS,
+        COUNT
+    };
+
+    static constexpr const size_t COUNTER_COUNT = (size_t) Counter::COUNT;
+
+    struct FrameStats {
+        uint64_t frame;
+        double cpu_ms;
+        // Negative until the timer queries of the frame were read back
+        double gpu_ms;
+        std::array<uint64_t, COUNTER_COUNT> counters;
+    };
+
+    // Times the scope it lives in. The name must outlive the capture, string literals are expected.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(const char* name_);
+
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        const char* name;
+        uint64_t start_ns;
+    };
+
+    // Creates the GL timer queries, needs a current context
+    void init();
+
+    void shutdown();
+
+    // Counters and GPU timers belong to the render thread, scoped timers may be used from any thread
+    void count(Counter counter, uint64_t amount);
+
+    // GPU timers may not nest, every begin has to be followed by an end in the same frame
+    void begin_gpu_timer(const char* name);
+
+    void end_gpu_timer();
+
+    // Closes the statistics of the current frame and reads back the GPU timers that completed
+    void end_frame();
+
+    // Statistics of the frame that ended frames_ago frames before the last one, nullptr if it is not in the history
+    [[nodiscard]] const FrameStats* frame_stats(size_t frames_ago);
+
+    [[nodiscard]] const char* counter_name(Counter counter);
+
+    // Records the events of the next frame_count frames for write_chrome_trace()
+    void capture(size_t frame_count);
+
+    // True once a capture has recorded all of its frames
+    [[nodiscard]] bool capture_finished();
+
+    [[nodiscard]] bool write_chrome_trace(const char* path);
+}
+
+#ifdef RTC_PROFILE
+
+#define RTC_PROFILE_CONCAT_INNER(a, b) a##b
+#define RTC_PROFILE_CONCAT(a, b) RTC_PROFILE_CONCAT_INNER(a, b)
+
+#define RTC_PROFILE_SCOPE(name) Profiler::ScopedTimer RTC_PROFILE_CONCAT(profile_scope_, __LINE__){name}
+#define RTC_PROFILE_COUNT(counter, amount) Profiler::count(Profiler::Counter::counter, (uint64_t) (amount))
+#define RTC_PROFILE_GPU_BEGIN(name) Profiler::begin_gpu_timer(name)
+#define RTC_PROFILE_GPU_END() Profiler::end_gpu_timer()
+
+#else
+
+#define RTC_PROFILE_SCOPE(name) ((void) 0)
+#define RTC_PROFILE_COUNT(counter, amount) ((void) 0)
+#define RTC_PROFILE_GPU_BEGIN(name) ((void) 0)
+#define RTC_PROFILE_GPU_END() ((void) 0)
+
+#endif
@@ -1,25 +1,50 @@
-#include <glm/ext/matrix_clip_space.hpp>
-#include <glm/ext/matrix_transform.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <glm/packing.hpp>
 #include "RenderBatch.h"
-#include "Screen.h"
+#include "MultiDraw.h"
+#include "Profiler.h"
 
 
 void RenderBatch::init() {
-    assert(shape != nullptr);
+    assert(shader_program != nullptr);
+    assert(batch_pipeline.instanced_shape == nullptr || batch_pipeline.instanced_shape->vertices.size() < MAX_VERTICES);
 
     init_gpu_buffer();
 }
 
-void RenderBatch::queue(glm::vec2 position, glm::vec2 scale, glm::vec4 tint_color, std::optional<Texture> texture) {
-    Transform transform{position, 0.0F, scale};
+void RenderBatch::queue(const Shape* shape, glm::vec3 position, glm::vec2 scale, float rotation, glm::vec4 tint_color, std::optional<Texture> texture,
+                        glm::vec4 uv_rect, glm::vec4 shape_params) {
+    queue_drawable(shape, Transform{position, rotation, scale}, tint_color, texture, uv_rect, -1.0F, shape_params);
+}
+
+void RenderBatch::queue(const Shape* shape, glm::vec3 position, glm::vec2 scale, float rotation, glm::vec4 tint_color, const AtlasSprite& sprite,
+                        glm::vec4 shape_params) {
+    // Atlas sprites sample the atlas texture unit and never need one of the render buffer texture slots
+    queue_drawable(shape, Transform{position, rotation, scale}, tint_color, std::nullopt, sprite.uv_rect, (float) sprite.layer, shape_params);
+}
+
+void RenderBatch::queue(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, std::optional<Texture> texture, glm::vec4 uv_rect,
+                        std::optional<Primitive> primitive) {
+    queue_instances(shape, instances, clip_depth, texture, uv_rect, -1.0F, primitive);
+}
+
+void RenderBatch::queue(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, const AtlasSprite& sprite) {
+    queue_instances(shape, instances, clip_depth, std::nullopt, sprite.uv_rect, (float) sprite.layer, std::nullopt);
+}
+
+void RenderBatch::queue_drawable(const Shape* shape, RenderBatch::Transform transform, glm::vec4 tint_color, std::optional<Texture> texture,
+                                 glm::vec4 uv_rect, float texture_layer, glm::vec4 shape_params) {
+    assert(shape->pipeline(settings->instancing) == batch_pipeline);
+    assert(shape->vertices.size() < MAX_VERTICES && shape->indices.size() < MAX_INDICES);
 
     // No render buffer exist, create a new render buffer and push the drawable
     if (render_buffers.empty()) {
-        // FUTURE TODO: Optimize these buffers with pre-allocation
-        RenderBuffer& render_buffer = render_buffers.emplace_back();
-        add_to_render_buffer(transform, tint_color, texture, render_buffer);
-
-        printf("Queing batch: %d.\n", render_buffers.size());
+        RenderBuffer& render_buffer = acquire_render_buffer(shape);
+        add_to_render_buffer(shape, transform, tint_color, texture, uv_rect, texture_layer, shape_params, render_buffer);
 
         return;
     }
@@ -29,130 +54,537 @@ void RenderBatch::queue(glm::vec2 position, glm::vec2 scale, glm::vec4 tint_colo
     size_t new_vertices_count = last_render_buffer.vertices_count + shape->vertices.size();
     size_t new_indices_count = last_render_buffer.indices_count + shape->indices.size();
 
+    // Only a texture the render buffer has not bound yet needs a free slot
+    bool needs_texture_slot = texture.has_value() &&
+                              std::find(last_render_buffer.textures.begin(), last_render_buffer.textures.end(), texture->id) == last_render_buffer.textures.end();
+
     // Check for conditions to either use the last render buffer or create a new render buffer
-    if (new_vertices_count >= MAX_VERTICES ||
+    if (split_requested ||
+        new_vertices_count >= MAX_VERTICES ||
         new_indices_count >= MAX_INDICES ||
-        last_render_buffer.textures.size() >= MAX_TEXTURES) {
-        RenderBuffer& new_render_buffer = render_buffers.emplace_back();
-        add_to_render_buffer(transform, tint_color, texture, new_render_buffer);
+        (needs_texture_slot && last_render_buffer.textures.size() >= MAX_TEXTURES)) {
+        count_split(new_vertices_count, new_indices_count);
+
+        RenderBuffer& new_render_buffer = acquire_render_buffer(shape);
+        add_to_render_buffer(shape, transform, tint_color, texture, uv_rect, texture_layer, shape_params, new_render_buffer);
+    } else {
+        add_to_render_buffer(shape, transform, tint_color, texture, uv_rect, texture_layer, shape_params, last_render_buffer);
+    }
+}
+
+void RenderBatch::queue_instances(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, std::optional<Texture> texture,
+                                  glm::vec4 uv_rect, float texture_layer, std::optional<Primitive> primitive) {
+    assert(shape->pipeline(settings->instancing) == batch_pipeline);
+    assert(shape->vertices.size() < MAX_VERTICES && shape->indices.size() < MAX_INDICES);
+
+    size_t queued = 0;
+
+    // The conditions of queue_drawable(), checked once for as many instances as the render buffer takes
+    while (queued < instances.size()) {
+        RenderBuffer* render_buffer = render_buffers.empty() ? nullptr : &render_buffers.back();
+        size_t room = render_buffer != nullptr ? drawables_left(*render_buffer, shape) : 0;
+
+        bool needs_texture_slot = render_buffer != nullptr && texture.has_value() &&
+                                  std::find(render_buffer->textures.begin(), render_buffer->textures.end(), texture->id) == render_buffer->textures.end();
+
+        if (render_buffer == nullptr ||
+            split_requested ||
+            room == 0 ||
+            (needs_texture_slot && render_buffer->textures.size() >= MAX_TEXTURES)) {
+            if (render_buffer != nullptr) {
+                count_split(render_buffer->vertices_count + shape->vertices.size(), render_buffer->indices_count + shape->indices.size());
+            }
+
+            render_buffer = &acquire_render_buffer(shape);
+            room = drawables_left(*render_buffer, shape);
+        }
+
+        const size_t count = std::min(room, instances.size() - queued);
+        add_instances_to_render_buffer(shape, instances.subspan(queued, count), clip_depth, texture, uv_rect, texture_layer, primitive, *render_buffer);
+
+        queued += count;
+    }
+}
+
+void RenderBatch::count_split(size_t new_vertices_count, size_t new_indices_count) const {
+    // Attributed to the first reason that applies, in the order they are checked
+    if (split_requested) {
+        RTC_PROFILE_COUNT(SPLITS_SORT_ORDER, 1);
+    } else if (new_vertices_count >= MAX_VERTICES) {
+        RTC_PROFILE_COUNT(SPLITS_VERTEX_LIMIT, 1);
+    } else if (new_indices_count >= MAX_INDICES) {
+        RTC_PROFILE_COUNT(SPLITS_INDEX_LIMIT, 1);
     } else {
-        add_to_render_buffer(transform, tint_color, texture, last_render_buffer);
+        RTC_PROFILE_COUNT(SPLITS_TEXTURE_SLOTS, 1);
     }
 
-    printf("Queing batch: %d.\n", render_buffers.size());
+    (void) new_vertices_count;
+    (void) new_indices_count;
+}
+
+void RenderBatch::split() {
+    split_requested = !render_buffers.empty();
 }
 
-void RenderBatch::flush() {
-    printf("Flushing batch: %d.\n", render_buffers.size());
+size_t RenderBatch::render_buffer_count() const {
+    return render_buffers.size();
+}
+
+size_t RenderBatch::reserve(size_t first_buffer, size_t end_buffer) {
+    size_t reserved_end = first_buffer;
+
+    while (reserved_end < end_buffer && reserve_destination(render_buffers[reserved_end])) {
+        ++reserved_end;
+    }
+
+    return reserved_end;
+}
+
+void RenderBatch::build(size_t buffer_index) {
+    RTC_PROFILE_SCOPE("RenderBatch::build");
+
+    RenderBuffer& render_buffer = render_buffers[buffer_index];
+    const Destination& destination = render_buffer.destination;
+
+    if (settings->instancing) {
+        generate_instance_buffer(render_buffer, destination.instances);
+    } else {
+        generate_batched_buffer(render_buffer, destination.vertices, destination.indices);
+    }
+}
+
+void RenderBatch::build_job(void* render_batch, size_t buffer_index) {
+    static_cast<RenderBatch*>(render_batch)->build(buffer_index);
+}
+
+void RenderBatch::submit(size_t first_buffer, size_t end_buffer) {
+    if (first_buffer == end_buffer) {
+        return;
+    }
 
-    shape->shader_program.bind();
+    // The multi draw draws the render buffers of the shared arena
+    assert(multi_draw == nullptr);
+
+    RTC_PROFILE_SCOPE("RenderBatch::submit");
+    RTC_PROFILE_GPU_BEGIN("RenderBatch::submit");
+
+    active_shader_program().bind();
+    apply_blend_mode(batch_pipeline.blend_mode);
 
     glBindVertexArray(gpu.gl_vao_id);
     glBindBuffer(GL_ARRAY_BUFFER, gpu.gl_vbo_id);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.gl_ibo_id);
 
     // Each render buffer is subject to a draw call
-    for (const RenderBuffer& render_buffer: render_buffers) {
-        printf("Drawing buffer.\n");
-        // Draw call
-        BatchedBuffer batched_buffer = generate_batched_buffer(render_buffer);
-        batched_buffer.vertices[7] = 0.0F;
-        batched_buffer.vertices[8] = 0.0F;
-        batched_buffer.vertices[17] = 1.0F;
-        batched_buffer.vertices[18] = 0.0F;
-        batched_buffer.vertices[27] = 0.0F;
-        batched_buffer.vertices[28] = 1.0F;
-        batched_buffer.vertices[37] = 1.0F;
-        batched_buffer.vertices[38] = 1.0F;
-        glBufferSubData(GL_ARRAY_BUFFER, 0, batched_buffer.vertices_size, batched_buffer.vertices.data());
-
-        const std::vector<int>& gpu_index_buffer = batched_buffer.indices;
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, gpu_index_buffer.size() * sizeof(int), gpu_index_buffer.data());
-
-        set_shader_projection(shape->shader_program);
+    for (size_t i = first_buffer; i < end_buffer; ++i) {
+        const RenderBuffer& render_buffer = render_buffers[i];
+
         set_shader_textures(render_buffer);
 
-        glDrawElements(shape->gl_render_mode, render_buffer.indices_count, GL_UNSIGNED_INT, 0);
-        // ---
+        if (settings->upload_mode == UploadMode::BUFFER_SUB_DATA) {
+            upload_buffer_sub_data(render_buffer);
+        }
+
+        draw(render_buffer);
     }
 
-    render_buffers.clear();
+    RTC_PROFILE_GPU_END();
+}
 
-    printf("Clearing batch.\n");
+void RenderBatch::end_wave() {
+    if (settings->upload_mode == UploadMode::PERSISTENT_MAPPED && multi_draw == nullptr) {
+        if (settings->instancing) {
+            instance_stream.end_wave();
+        } else {
+            vertex_stream.end_wave();
+            index_stream.end_wave();
+        }
+    }
 }
 
-RenderBatch::BatchedBuffer RenderBatch::generate_batched_buffer(const RenderBatch::RenderBuffer& render_buffer) const {
-    // Reserve enough gpu vertices buffer for all the cpu vertices
-    std::vector<float> gpu_vertex_buffer;
-    gpu_vertex_buffer.reserve(render_buffer.vertices_count * shape->vertex_layout.vertex_components);
+RenderBatch::IndirectBuffer RenderBatch::indirect_buffer(size_t buffer_index) const {
+    assert(multi_draw != nullptr);
 
-    // Reserve enough gpu indices buffer for all the cpu indices
-    std::vector<int> gpu_index_buffer;
-    gpu_index_buffer.reserve(render_buffer.indices_count);
+    const RenderBuffer& render_buffer = render_buffers[buffer_index];
+    const Destination& destination = render_buffer.destination;
 
-    int vertex_offset = 0;
-    // Each shape needs to be added to the gpu vertex buffer
-    for (const Drawable& drawable: render_buffer.draw_buffer) {
-        std::vector<float> vertex_buffer = generate_vertex_buffer(drawable);
-        gpu_vertex_buffer.insert(gpu_vertex_buffer.end(), vertex_buffer.begin(), vertex_buffer.end());
+    return IndirectBuffer{
+            render_buffer.vertices_count,
+            render_buffer.indices_count,
+            destination.first_vertex,
+            destination.first_index,
+            std::span{render_buffer.textures.begin(), render_buffer.textures.size()}
+    };
+}
+
+void RenderBatch::end_frame() {
+    // Nothing to free, the arena takes the memory back as a whole
+    render_buffers = FrameArray<RenderBuffer>{};
+}
 
-        for (int index: shape->indices) {
-            gpu_index_buffer.push_back(index + vertex_offset);
+void RenderBatch::generate_batched_buffer(RenderBatch::RenderBuffer& render_buffer, std::span<Shape::BatchVertex> vertices, std::span<BatchIndex> indices) const {
+    assert(vertices.size() >= render_buffer.vertices_count);
+    assert(indices.size() >= render_buffer.indices_count);
+
+    BatchedBuffer& batched_buffer = render_buffer.batched_buffer;
+    const DrawableStream& drawables = render_buffer.drawables;
+    const float* rotations = drawables.rotation.data();
+    float* rotation_cos = batched_buffer.rotation_cos.storage().data();
+    float* rotation_sin = batched_buffer.rotation_sin.storage().data();
+
+    for (size_t d = 0; d < drawables.size(); ++d) {
+        rotation_cos[d] = std::cos(rotations[d]);
+        rotation_sin[d] = std::sin(rotations[d]);
+    }
+
+    // Transform every run of the buffer in one pass each, then interleave the streams into the vertex layout
+    for (const ShapeRun& run: render_buffer.runs) {
+        TransformKernel::transform(drawables.transform_streams(run.first_drawable, run.drawable_count, rotation_cos, rotation_sin), run.shape->vertices,
+                                   batched_buffer.positions_x.storage().data() + run.first_vertex,
+                                   batched_buffer.positions_y.storage().data() + run.first_vertex);
+    }
+    generate_vertex_buffer(render_buffer, vertices);
+
+    BatchIndex* index_cursor = indices.data();
+    // Each shape needs to be added to the gpu index buffer, rebased onto where the vertices of its drawable start
+    for (const ShapeRun& run: render_buffer.runs) {
+        size_t vertex_offset = run.first_vertex;
+
+        for (size_t d = 0; d < run.drawable_count; ++d) {
+            for (int index: run.shape->indices) {
+                *index_cursor++ = (BatchIndex) (index + vertex_offset);
+            }
+
+            vertex_offset += run.shape->vertices.size();
         }
+    }
+}
 
-        vertex_offset += shape->vertices.size();
+void RenderBatch::generate_vertex_buffer(const RenderBatch::RenderBuffer& render_buffer, std::span<Shape::BatchVertex> vertices) const {
+    const DrawableStream& drawables = render_buffer.drawables;
+    const BatchedBuffer& batched_buffer = render_buffer.batched_buffer;
+
+    Shape::BatchVertex* vertex_cursor = vertices.data();
+
+    for (const ShapeRun& run: render_buffer.runs) {
+        const std::vector<Shape::Vertex>& shape_vertices = run.shape->vertices;
+        // Vertex major within the run, as the kernel wrote them
+        const float* positions_x = batched_buffer.positions_x.data() + run.first_vertex;
+        const float* positions_y = batched_buffer.positions_y.data() + run.first_vertex;
+
+        for (size_t r = 0; r < run.drawable_count; ++r) {
+            const size_t d = run.first_drawable + r;
+            const float position_z = drawables.position_z[d];
+            const uint32_t tint_color = drawables.tint_colors[d];
+            const glm::vec4 uv_rect = drawables.uv_rects[d];
+            const Shape::Material material = drawables.materials[d];
+            const uint32_t primitive_params = drawables.primitive_params[d];
+
+            for (size_t v = 0; v < shape_vertices.size(); ++v) {
+                vertex_cursor->position = glm::vec3{
+                        positions_x[v * run.drawable_count + r],
+                        positions_y[v * run.drawable_count + r],
+                        position_z
+                };
+                vertex_cursor->tint_color = tint_color;
+                vertex_cursor->uv = glm::packUnorm2x16(glm::vec2{uv_rect.x, uv_rect.y} + shape_vertices[v].uvs * glm::vec2{uv_rect.z, uv_rect.w});
+                vertex_cursor->material = material;
+                vertex_cursor->primitive_params = primitive_params;
+
+                ++vertex_cursor;
+            }
+        }
     }
+}
+
+bool RenderBatch::reserve_destination(RenderBatch::RenderBuffer& render_buffer) {
+    Destination& destination = render_buffer.destination;
+    destination = Destination{};
+
+    BatchedBuffer& batched_buffer = render_buffer.batched_buffer;
+
+    // Written by the transform kernel on the way into any destination
+    if (!settings->instancing && batched_buffer.positions_x.data() == nullptr) {
+        batched_buffer.positions_x.allocate(*frame_arena, render_buffer.vertices_count);
+        batched_buffer.positions_y.allocate(*frame_arena, render_buffer.vertices_count);
+        batched_buffer.rotation_cos.allocate(*frame_arena, render_buffer.drawables.size());
+        batched_buffer.rotation_sin.allocate(*frame_arena, render_buffer.drawables.size());
+    }
+
+    // Uploaded with glBufferSubData right before its draw, the staging buffers are the destination
+    if (settings->upload_mode == UploadMode::BUFFER_SUB_DATA) {
+        if (settings->instancing) {
+            batched_buffer.instances.allocate(*frame_arena, render_buffer.drawables.size());
+            destination.instances = batched_buffer.instances.storage();
+        } else {
+            batched_buffer.vertices.allocate(*frame_arena, render_buffer.vertices_count);
+            batched_buffer.indices.allocate(*frame_arena, render_buffer.indices_count);
+            destination.vertices = batched_buffer.vertices.storage();
+            destination.indices = batched_buffer.indices.storage();
+        }
+
+        return true;
+    }
+
+    if (settings->instancing) {
+        std::optional<StreamBuffer::Allocation> instances = instance_stream.allocate(render_buffer.drawables.size());
 
-    return BatchedBuffer{gpu_vertex_buffer, gpu_index_buffer,
-            gpu_vertex_buffer.size() * sizeof(float)};
+        if (!instances.has_value()) {
+            return false;
+        }
+
+        destination.instances = std::span{(Shape::InstanceData*) instances->data, render_buffer.drawables.size()};
+        destination.first_instance = instances->first_element;
+
+        return true;
+    }
+
+    // With a multi draw every batch shares its rings, so all of their render buffers can be drawn together
+    StreamBuffer& vertex_ring = multi_draw != nullptr ? multi_draw->vertices() : vertex_stream;
+    StreamBuffer& index_ring = multi_draw != nullptr ? multi_draw->indices() : index_stream;
+
+    std::optional<StreamBuffer::Allocation> vertices = vertex_ring.allocate(render_buffer.vertices_count);
+    std::optional<StreamBuffer::Allocation> indices = index_ring.allocate(render_buffer.indices_count);
+
+    // Space that was reserved in only one of the rings is released when the wave ends
+    if (!vertices.has_value() || !indices.has_value()) {
+        return false;
+    }
+
+    destination.vertices = std::span{(Shape::BatchVertex*) vertices->data, render_buffer.vertices_count};
+    destination.indices = std::span{(BatchIndex*) indices->data, render_buffer.indices_count};
+    destination.first_vertex = vertices->first_element;
+    destination.first_index = indices->first_element;
+
+    return true;
 }
 
-std::vector<float> RenderBatch::generate_vertex_buffer(const RenderBatch::Drawable& drawable) const {
-    // FUTURE TODO: Profile this! Shapes with tons of vertices might be slow to render
-    size_t vertices_count = shape->vertices.size();
-    std::vector<float> vertices;
-    vertices.reserve(vertices_count * shape->vertex_layout.vertex_components);
-    Transform transform = drawable.transform;
+void RenderBatch::upload_buffer_sub_data(const RenderBatch::RenderBuffer& render_buffer) const {
+    const Destination& destination = render_buffer.destination;
 
-    for (const Shape::Vertex& vertex: shape->vertices) {
-        // FUTURE TODO: Profile if we should do transformation in the graphics card at the cost of more memory
-        glm::mat4 transformation_matrix = glm::mat4{1.0F};
-        transformation_matrix = glm::translate(transformation_matrix, glm::vec3{transform.position.x, transform.position.y, 0.0F});
-        transformation_matrix = glm::rotate(transformation_matrix, glm::degrees(transform.rotation), glm::vec3{0.0F, 1.0F, 0.0F});
-        transformation_matrix = glm::scale(transformation_matrix, glm::vec3{transform.scale.x, transform.scale.y, 1.0F});
-        glm::vec3 transformed_position = transformation_matrix * glm::vec4{vertex.points.x, vertex.points.y, 0.0F, 1.0F};
-        // FUTURE TODO: How to deal with z?
+    if (settings->instancing) {
+        glNamedBufferSubData(gpu.gl_instance_vbo_id, 0, destination.instances.size_bytes(), destination.instances.data());
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, destination.vertices.size_bytes(), destination.vertices.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, destination.indices.size_bytes(), destination.indices.data());
+    }
+}
+
+void RenderBatch::draw(const RenderBatch::RenderBuffer& render_buffer) const {
+    const Destination& destination = render_buffer.destination;
+
+    // Uploaded either by glBufferSubData or by the build writing into mapped memory
+    RTC_PROFILE_COUNT(DRAW_CALLS, 1);
+    RTC_PROFILE_COUNT(BYTES_UPLOADED, destination.vertices.size_bytes() + destination.indices.size_bytes() + destination.instances.size_bytes());
+
+    if (settings->instancing) {
+        const Shape* shape = batch_pipeline.instanced_shape;
+
+        RTC_PROFILE_COUNT(INSTANCES, render_buffer.drawables.size());
+        RTC_PROFILE_COUNT(VERTICES, render_buffer.vertices_count);
+        RTC_PROFILE_COUNT(INDICES, render_buffer.indices_count);
 
-        std::vector<float> generated_vertices = shape->generate_vertex(transformed_position, drawable.tint_color, vertex.uvs, (float) (drawable.texture_index + 1));
-        vertices.insert(vertices.end(), generated_vertices.begin(), generated_vertices.end());
+        glDrawElementsInstancedBaseInstance(batch_pipeline.gl_render_mode, shape->indices.size(), BATCH_INDEX_TYPE, 0,
+                                            render_buffer.drawables.size(), destination.first_instance);
+
+        return;
     }
 
-    return vertices;
+    RTC_PROFILE_COUNT(VERTICES, render_buffer.vertices_count);
+    RTC_PROFILE_COUNT(INDICES, render_buffer.indices_count);
+
+    // Indices are generated relative to the render buffer, the base vertex moves them to where its vertices landed
+    glDrawElementsBaseVertex(batch_pipeline.gl_render_mode, render_buffer.indices_count, BATCH_INDEX_TYPE,
+                             (const void*) (destination.first_index * sizeof(BatchIndex)), (GLint) destination.first_vertex);
 }
 
-void RenderBatch::add_to_render_buffer(RenderBatch::Transform transform, glm::vec4 tint_color, std::optional<Texture> texture, RenderBatch::RenderBuffer& render_buffer) {
-    Drawable& drawable = render_buffer.draw_buffer.emplace_back(transform);
+void RenderBatch::generate_instance_buffer(const RenderBatch::RenderBuffer& render_buffer, std::span<Shape::InstanceData> instances) const {
+    const DrawableStream& drawables = render_buffer.drawables;
+    assert(instances.size() >= drawables.size());
+
+    Shape::InstanceData* instance = instances.data();
+
+    for (size_t d = 0; d < drawables.size(); ++d) {
+        instance->position = glm::vec3{drawables.position_x[d], drawables.position_y[d], drawables.position_z[d]};
+        instance->scale = glm::vec2{drawables.scale_x[d], drawables.scale_y[d]};
+        instance->rotation = drawables.rotation[d];
+        instance->tint_color = drawables.tint_colors[d];
+        instance->uv_offset = glm::packUnorm2x16(glm::vec2{drawables.uv_rects[d].x, drawables.uv_rects[d].y});
+        instance->uv_size = glm::packSnorm2x16(glm::vec2{drawables.uv_rects[d].z, drawables.uv_rects[d].w});
+        instance->material = drawables.materials[d];
+        instance->primitive_params = drawables.primitive_params[d];
+
+        ++instance;
+    }
+}
+
+const ShaderProgram& RenderBatch::active_shader_program() const {
+    if (settings->instancing) {
+        return *instanced_shader;
+    }
+
+    return *shader_program;
+}
+
+size_t RenderBatch::max_drawables(const Shape* shape) {
+    return MAX_VERTICES / shape->vertices.size();
+}
+
+size_t RenderBatch::drawables_left(const RenderBatch::RenderBuffer& render_buffer, const Shape* shape) {
+    // The counts have to stay below the limits, the same check queue_drawable() does
+    size_t room = (MAX_VERTICES - 1 - render_buffer.vertices_count) / shape->vertices.size();
+
+    if (!shape->indices.empty()) {
+        room = std::min(room, (MAX_INDICES - 1 - render_buffer.indices_count) / shape->indices.size());
+    }
+
+    return room;
+}
+
+int RenderBatch::texture_slot(RenderBatch::RenderBuffer& render_buffer, std::optional<Texture> texture) {
+    if (!texture.has_value()) {
+        return -1;
+    }
+
+    auto it = std::find(render_buffer.textures.begin(), render_buffer.textures.end(), texture->id);
+
+    if (it == render_buffer.textures.end()) {
+        render_buffer.textures.push_back(texture->id);
+
+        return (int) render_buffer.textures.size() - 1;
+    }
+
+    return (int) std::distance(render_buffer.textures.begin(), it);
+}
+
+RenderBatch::RenderBuffer& RenderBatch::acquire_render_buffer(const Shape* shape) {
+    split_requested = false;
+
+    // The staging buffers are only taken once the buffer is complete and reserved, the persistent mapped path never needs them
+    RenderBuffer& render_buffer = render_buffers.push_back(*frame_arena, RenderBuffer{});
+    render_buffer.drawables.allocate(*frame_arena, max_drawables(shape));
+    render_buffer.runs.allocate(*frame_arena, 1);
+    render_buffer.textures.allocate(*frame_arena, MAX_TEXTURES);
+
+    return render_buffer;
+}
+
+void RenderBatch::add_to_render_buffer(const Shape* shape, RenderBatch::Transform transform, glm::vec4 tint_color, std::optional<Texture> texture,
+                                       glm::vec4 uv_rect, float texture_layer, glm::vec4 shape_params, RenderBatch::RenderBuffer& render_buffer) {
+    // Draws of another shape than the one before start a run, the order of the draws is kept
+    if (render_buffer.runs.empty() || render_buffer.runs.back().shape != shape) {
+        render_buffer.runs.push_back(*frame_arena, ShapeRun{shape, render_buffer.drawables.size(), 0, render_buffer.vertices_count});
+    }
+
+    ++render_buffer.runs.back().drawable_count;
+
     render_buffer.vertices_count += shape->vertices.size();
     render_buffer.indices_count += shape->indices.size();
-    drawable.tint_color = tint_color;
 
-    if (texture.has_value()) {
-        auto it = std::find(render_buffer.textures.begin(), render_buffer.textures.end(), texture->id);
+    const int texture_index = texture_slot(render_buffer, texture);
 
-        if (it == render_buffer.textures.end()) {
-            size_t texture_index = render_buffer.textures.size();
-            render_buffer.textures.push_back(texture->id);
-            drawable.texture_index = texture_index;
-        } else {
-            drawable.texture_index = std::distance(render_buffer.textures.begin(), it);
-            printf("Texture already exists at: %zu\n", drawable.texture_index);
+    render_buffer.drawables.push(*frame_arena, transform, tint_color, texture_index, uv_rect, texture_layer, shape_params);
+}
+
+void RenderBatch::add_instances_to_render_buffer(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth,
+                                                 std::optional<Texture> texture, glm::vec4 uv_rect, float texture_layer, std::optional<Primitive> primitive,
+                                                 RenderBatch::RenderBuffer& render_buffer) {
+    assert(instances.size() <= drawables_left(render_buffer, shape));
+
+    if (render_buffer.runs.empty() || render_buffer.runs.back().shape != shape) {
+        render_buffer.runs.push_back(*frame_arena, ShapeRun{shape, render_buffer.drawables.size(), 0, render_buffer.vertices_count});
+    }
+
+    render_buffer.runs.back().drawable_count += instances.size();
+
+    render_buffer.vertices_count += instances.size() * shape->vertices.size();
+    render_buffer.indices_count += instances.size() * shape->indices.size();
+
+    const int texture_index = texture_slot(render_buffer, texture);
+
+    render_buffer.drawables.append(*frame_arena, instances, clip_depth, texture_index, uv_rect, texture_layer, primitive);
+}
+
+void RenderBatch::DrawableStream::allocate(FrameArena& arena, size_t capacity) {
+    position_x.allocate(arena, capacity);
+    position_y.allocate(arena, capacity);
+    position_z.allocate(arena, capacity);
+    scale_x.allocate(arena, capacity);
+    scale_y.allocate(arena, capacity);
+    rotation.allocate(arena, capacity);
+    tint_colors.allocate(arena, capacity);
+    uv_rects.allocate(arena, capacity);
+    materials.allocate(arena, capacity);
+    primitive_params.allocate(arena, capacity);
+}
+
+void RenderBatch::DrawableStream::push(FrameArena& arena, RenderBatch::Transform transform, glm::vec4 tint_color, int texture_index, glm::vec4 uv_rect,
+                                       float texture_layer, glm::vec4 shape_params_) {
+    position_x.push_back(arena, transform.position.x);
+    position_y.push_back(arena, transform.position.y);
+    position_z.push_back(arena, transform.position.z);
+    scale_x.push_back(arena, transform.scale.x);
+    scale_y.push_back(arena, transform.scale.y);
+    rotation.push_back(arena, transform.rotation);
+    tint_colors.push_back(arena, glm::packUnorm4x8(tint_color));
+    uv_rects.push_back(arena, uv_rect);
+    materials.push_back(arena, Shape::make_material(texture_index, texture_layer, shape_params_));
+    primitive_params.push_back(arena, Shape::pack_primitive_params(shape_params_));
+}
+
+void RenderBatch::DrawableStream::append(FrameArena& arena, std::span<const DrawInstance> instances, float position_z_, int texture_index,
+                                         glm::vec4 uv_rect, float texture_layer, std::optional<Primitive> primitive) {
+    const size_t count = instances.size();
+
+    float* xs = position_x.append(arena, count);
+    float* ys = position_y.append(arena, count);
+    float* scales_x = scale_x.append(arena, count);
+    float* scales_y = scale_y.append(arena, count);
+    float* rotations = rotation.append(arena, count);
+    uint32_t* tints = tint_colors.append(arena, count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const DrawInstance& instance = instances[i];
+
+        xs[i] = instance.position.x;
+        ys[i] = instance.position.y;
+        scales_x[i] = instance.scale.x;
+        scales_y[i] = instance.scale.y;
+        rotations[i] = instance.rotation;
+        tints[i] = glm::packUnorm4x8(instance.tint_color);
+    }
+
+    const glm::vec4 shape_params_ = primitive.has_value() ? primitive->shape_params(glm::vec2{1.0F, 1.0F}) : NO_PRIMITIVE;
+
+    std::fill_n(position_z.append(arena, count), count, position_z_);
+    std::fill_n(uv_rects.append(arena, count), count, uv_rect);
+    std::fill_n(materials.append(arena, count), count, Shape::make_material(texture_index, texture_layer, shape_params_));
+
+    uint32_t* params = primitive_params.append(arena, count);
+
+    // Corner radius and thickness are relative to the width of every drawable, plain circles have neither
+    if (primitive.has_value() && (primitive->corner_radius != 0.0F || primitive->thickness != 0.0F)) {
+        for (size_t i = 0; i < count; ++i) {
+            params[i] = Shape::pack_primitive_params(primitive->shape_params(instances[i].scale));
         }
+    } else {
+        std::fill_n(params, count, Shape::pack_primitive_params(shape_params_));
     }
 }
 
-void RenderBatch::set_shader_projection(const ShaderProgram& shader) {
-    glm::mat4 projection = glm::ortho(0.0F, (float) Screen::WIDTH, 0.0F, (float) Screen::HEIGHT);
-    shader.setMatrix("u_projection", projection);
+TransformKernel::TransformStreams RenderBatch::DrawableStream::transform_streams(size_t first, size_t count, const float* rotation_cos,
+                                                                                const float* rotation_sin) const {
+    assert(first + count <= size());
+
+    return TransformKernel::TransformStreams{
+            position_x.data() + first,
+            position_y.data() + first,
+            scale_x.data() + first,
+            scale_y.data() + first,
+            rotation_cos + first,
+            rotation_sin + first,
+            count
+    };
 }
 
 void RenderBatch::set_shader_textures(const RenderBuffer& render_buffer) {
@@ -162,19 +594,28 @@ void RenderBatch::set_shader_textures(const RenderBuffer& render_buffer) {
     for (GLuint texture_id: render_buffer.textures) {
         glBindTextureUnit(tex_index, texture_id);
 
-        printf("Loading Texture(%d): %d\n", tex_index, texture_id);
-
         ++tex_index;
     }
+
+    RTC_PROFILE_COUNT(TEXTURE_BINDS, render_buffer.textures.size() + 1);
 }
 
 void RenderBatch::init_gpu_buffer() {
-    this->gpu = Gpu{0, 0};
+    this->gpu = Gpu{0, 0, 0, 0};
+
+    // Reserves in the shared arena of the multi draw instead
+    if (multi_draw != nullptr) {
+        return;
+    }
 
     glGenVertexArrays(1, &gpu.gl_vao_id);
     glBindVertexArray(gpu.gl_vao_id);
-    init_batch_vbo();
-    init_batch_ibo();
+    if (settings->instancing) {
+        init_instanced_buffers();
+    } else {
+        init_batch_vbo();
+        init_batch_ibo();
+    }
     glBindVertexArray(0);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -185,25 +626,50 @@ void RenderBatch::init_batch_vbo() {
     glGenBuffers(1, &gpu.gl_vbo_id);
     glBindBuffer(GL_ARRAY_BUFFER, gpu.gl_vbo_id);
 
-    const Shape::VertexLayout& vertex_layout = shape->vertex_layout;
-
-    glBufferData(GL_ARRAY_BUFFER, (vertex_layout.vertex_components * sizeof(float)) * MAX_VERTICES, nullptr, GL_DYNAMIC_DRAW);
-    size_t prev_size_in_bytes = 0;
+    if (settings->upload_mode == UploadMode::PERSISTENT_MAPPED) {
+        vertex_stream.init(gpu.gl_vbo_id, sizeof(Shape::BatchVertex), MAX_VERTICES * STREAM_SEGMENT_RENDER_BUFFERS);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Shape::BatchVertex) * MAX_VERTICES, nullptr, GL_DYNAMIC_DRAW);
+    }
 
-    for (size_t i = 0; i < vertex_layout.attributes.size(); ++i) {
-        const Shape::VertexAttrib& vertex_attrib = vertex_layout.attributes[i];
+    set_vertex_format<Shape::BatchVertex>(gpu.gl_vao_id, 0, gpu.gl_vbo_id);
+}
 
-        glEnableVertexAttribArray(i);
-        glVertexAttribPointer(i, vertex_attrib.gl_component_count, vertex_attrib.gl_data_type, GL_FALSE, (vertex_layout.vertex_components * sizeof(float)),
-                              (const void*) prev_size_in_bytes);
+void RenderBatch::init_batch_ibo() {
+    glGenBuffers(1, &gpu.gl_ibo_id);
 
-        prev_size_in_bytes += vertex_attrib.bytes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.gl_ibo_id);
+    if (settings->upload_mode == UploadMode::PERSISTENT_MAPPED) {
+        index_stream.init(gpu.gl_ibo_id, sizeof(BatchIndex), MAX_INDICES * STREAM_SEGMENT_RENDER_BUFFERS);
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(BatchIndex) * MAX_INDICES, nullptr, GL_DYNAMIC_DRAW);
     }
 }
 
-void RenderBatch::init_batch_ibo() {
-    glGenBuffers(1, &gpu.gl_ibo_id);
+void RenderBatch::init_instanced_buffers() {
+    const Shape* shape = batch_pipeline.instanced_shape;
+    assert(shape != nullptr);
+
+    // The shape geometry never changes, it is uploaded once and shared by every instance
+    glGenBuffers(1, &gpu.gl_vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.gl_vbo_id);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Shape::Vertex) * shape->vertices.size(), shape->vertices.data(), GL_STATIC_DRAW);
+
+    const std::vector<BatchIndex> indices{shape->indices.begin(), shape->indices.end()};
 
+    glGenBuffers(1, &gpu.gl_ibo_id);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.gl_ibo_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int) * MAX_INDICES, nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(BatchIndex) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &gpu.gl_instance_vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.gl_instance_vbo_id);
+
+    if (settings->upload_mode == UploadMode::PERSISTENT_MAPPED) {
+        instance_stream.init(gpu.gl_instance_vbo_id, sizeof(Shape::InstanceData), max_drawables(shape) * STREAM_SEGMENT_RENDER_BUFFERS);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Shape::InstanceData) * max_drawables(shape), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    set_vertex_format<Shape::Vertex>(gpu.gl_vao_id, 0, gpu.gl_vbo_id);
+    set_vertex_format<Shape::InstanceData>(gpu.gl_vao_id, 1, gpu.gl_instance_vbo_id, 1);
 }
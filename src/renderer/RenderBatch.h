@@ -1,75 +1,254 @@
 #pragma once
 
+#include <cstdint>
 #include <optional>
+#include <span>
 #include "Shape.h"
 #include "Texture.h"
+#include "RenderSettings.h"
+#include "StreamBuffer.h"
+#include "TransformKernel.h"
+#include "TextureAtlas.h"
+#include "Primitive.h"
+#include "FrameArena.h"
+#include "Pipeline.h"
 
 
+class MultiDraw;
+
 static constexpr const size_t MAX_VERTICES = 4000;
 static constexpr const size_t MAX_INDICES = 6000;
 
+// Indices are relative to their render buffer and the draw adds the base vertex, so 16 bits address all of its vertices
+using BatchIndex = uint16_t;
+static constexpr const GLenum BATCH_INDEX_TYPE = GL_UNSIGNED_SHORT;
+
+static_assert(MAX_VERTICES <= 65536, "Render buffer vertices must be addressable by a BatchIndex");
+
+// How many full render buffers fit in one segment of the persistently mapped ring
+static constexpr const size_t STREAM_SEGMENT_RENDER_BUFFERS = 8;
+
+// Samples the whole texture
+static constexpr const glm::vec4 FULL_UV_RECT = glm::vec4{0.0F, 0.0F, 1.0F, 1.0F};
+
+// One drawable of a bulk draw, see Renderer::draw_instances()
+struct DrawInstance {
+    glm::vec2 position;
+    glm::vec2 scale;
+    // In radians around the shape origin
+    float rotation;
+    glm::vec4 tint_color;
+};
+
 struct RenderBatch {
 private:
     struct Gpu {
         GLuint gl_vao_id;
         GLuint gl_vbo_id;
         GLuint gl_ibo_id;
+        // Only used when instancing, the vbo and ibo then hold the static shape geometry
+        GLuint gl_instance_vbo_id;
     };
 
     struct Transform {
-        // FUTURE TODO: This should be 3d coordinate to take 'Z' for z-sorting
-        glm::vec2 position = glm::vec2{0.0F, 0.0F};
+        // z is the clip space depth the renderer assigned from layer and depth, see SortKey::clip_depth()
+        glm::vec3 position = glm::vec3{0.0F, 0.0F, 0.0F};
         float rotation = 0.0F;
         glm::vec2 scale = glm::vec2{1.0F, 1.0F};
     };
 
-    struct Drawable {
-        explicit Drawable(Transform transform_)
-                : transform{transform_}, tint_color{1.0F, 1.0F, 1.0F, 1.0F}, texture_index{-1} {
+    // Drawables stored as structure of arrays so the transform kernel can process a whole run of a shape at once
+    struct DrawableStream {
+        FrameArray<float> position_x;
+        FrameArray<float> position_y;
+        // Passed through untransformed, the kernel only works in the plane
+        FrameArray<float> position_z;
+        FrameArray<float> scale_x;
+        FrameArray<float> scale_y;
+        FrameArray<float> rotation;
+        // Packed once per drawable like the vertices hold them, building the vertices only copies them
+        FrameArray<uint32_t> tint_colors;
+        FrameArray<glm::vec4> uv_rects;
+        FrameArray<Shape::Material> materials;
+        FrameArray<uint32_t> primitive_params;
 
+        [[nodiscard]] size_t size() const {
+            return position_x.size();
         }
 
-        Transform transform;
-        glm::vec4 tint_color;
-        int texture_index;
+        // Frame memory for capacity drawables, the streams grow past it when smaller shapes follow
+        void allocate(FrameArena& arena, size_t capacity);
+
+        void push(FrameArena& arena, Transform transform, glm::vec4 tint_color, int texture_index, glm::vec4 uv_rect, float texture_layer,
+                  glm::vec4 shape_params_);
+
+        // Appends the instances column by column, what they share is filled in once
+        void append(FrameArena& arena, std::span<const DrawInstance> instances, float position_z_, int texture_index, glm::vec4 uv_rect,
+                    float texture_layer, std::optional<Primitive> primitive);
+
+        // The transforms of count drawables starting at first, rotation_cos/rotation_sin hold every drawable of the stream
+        [[nodiscard]] TransformKernel::TransformStreams transform_streams(size_t first, size_t count, const float* rotation_cos,
+                                                                          const float* rotation_sin) const;
+    };
+
+    // Consecutive drawables of the same shape in a render buffer. Shapes of one pipeline share render buffers, every
+    // run is transformed and indexed with the geometry of its own shape.
+    struct ShapeRun {
+        const Shape* shape;
+        size_t first_drawable;
+        size_t drawable_count;
+        // Of the run's vertices within the render buffer
+        size_t first_vertex;
+    };
+
+    // Staging memory the vertex writer fills in place. Taken from the frame arena once the render buffer is complete,
+    // so it is sized for exactly what the buffer holds.
+    struct BatchedBuffer {
+        FrameArray<Shape::BatchVertex> vertices;
+        FrameArray<BatchIndex> indices;
+        FrameArray<Shape::InstanceData> instances;
+
+        // Vertex major positions written by the transform kernel before they are interleaved into vertices
+        FrameArray<float> positions_x;
+        FrameArray<float> positions_y;
+        // Of every drawable, taken from the rotations right before the kernel runs so queueing a draw does no trig
+        FrameArray<float> rotation_cos;
+        FrameArray<float> rotation_sin;
+    };
+
+    // Where build() writes a render buffer this frame, either its staging buffers or memory mapped from the rings
+    struct Destination {
+        std::span<Shape::BatchVertex> vertices;
+        std::span<BatchIndex> indices;
+        std::span<Shape::InstanceData> instances;
+
+        size_t first_vertex;
+        size_t first_index;
+        size_t first_instance;
     };
 
+    // Lives in frame memory like everything it points to
     struct RenderBuffer {
-        std::vector<Drawable> draw_buffer;
-        std::vector<GLuint> textures;
+        DrawableStream drawables;
+        FrameArray<ShapeRun> runs;
+        FrameArray<GLuint> textures;
 
         size_t vertices_count;
         size_t indices_count;
-    };
-
-    struct BatchedBuffer {
-        std::vector<float> vertices;
-        std::vector<int> indices;
 
-        size_t vertices_size;
+        BatchedBuffer batched_buffer;
+        Destination destination;
     };
 
 public:
 
-    explicit RenderBatch(const Shape* shape_) : render_buffers { }, gpu {}, shape { shape_ }
+    // A built render buffer as MultiDraw sees it, its geometry lies in the shared arena
+    struct IndirectBuffer {
+        size_t vertices_count;
+        size_t indices_count;
+        size_t first_vertex;
+        size_t first_index;
+        std::span<const GLuint> textures;
+    };
+
+    // The id orders the batch in the sort keys. The shader program is the one of the pipeline, shared by all of its
+    // shapes. With a multi draw the batch reserves its render buffers in the shared arena and leaves drawing them to it.
+    RenderBatch(uint32_t id_, Pipeline pipeline_, const ShaderProgram* shader_program_, const RenderSettings* settings_,
+                const ShaderProgram* instanced_shader_, FrameArena* frame_arena_, MultiDraw* multi_draw_ = nullptr)
+            : render_buffers { }, split_requested { false }, gpu {}, vertex_stream {}, index_stream {}, instance_stream {},
+              batch_id { id_ }, batch_pipeline { pipeline_ }, shader_program { shader_program_ }, settings { settings_ },
+              instanced_shader { instanced_shader_ }, frame_arena { frame_arena_ }, multi_draw { multi_draw_ }
     {
     }
 
     // Initializes the GPU buffers
     void init();
 
-    // Queues to the RenderBuffer
-    void queue(glm::vec2 position, glm::vec2 scale, glm::vec4 tint_color, std::optional<Texture> = std::nullopt);
+    // Queues to the RenderBuffer, the uv rect selects the region of the texture the shape is mapped onto. The shape
+    // has to be of the batch's pipeline. The z of the position is the clip space depth the drawable is tested with.
+    void queue(const Shape* shape, glm::vec3 position, glm::vec2 scale, float rotation, glm::vec4 tint_color, std::optional<Texture> = std::nullopt,
+               glm::vec4 uv_rect = FULL_UV_RECT, glm::vec4 shape_params = NO_PRIMITIVE);
+
+    // Queues a sprite of the TextureAtlas
+    void queue(const Shape* shape, glm::vec3 position, glm::vec2 scale, float rotation, glm::vec4 tint_color, const AtlasSprite& sprite,
+               glm::vec4 shape_params = NO_PRIMITIVE);
+
+    // Queues drawables of the shape that share texture, uv rect, primitive and clip depth. The texture slot and the room
+    // left in a render buffer are worked out once for every render buffer the instances spread over.
+    void queue(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, std::optional<Texture> texture = std::nullopt,
+               glm::vec4 uv_rect = FULL_UV_RECT, std::optional<Primitive> primitive = std::nullopt);
+
+    // Queues instances of a sprite of the TextureAtlas
+    void queue(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, const AtlasSprite& sprite);
+
+    // The next queued drawable opens a new render buffer, so draws of other batches can be ordered in between
+    void split();
 
-    // Executes a draw call
-    void flush();
+    [[nodiscard]] size_t render_buffer_count() const;
+
+    // Reserves GPU memory for the render buffers in [first_buffer, end_buffer). Returns the end of the reserved range,
+    // which stops early when the rings are full until the reserved buffers are submitted.
+    [[nodiscard]] size_t reserve(size_t first_buffer, size_t end_buffer);
+
+    // Generates the vertex data of a reserved render buffer. Touches only that buffer, so it is safe to run in parallel.
+    void build(size_t buffer_index);
+
+    // JobSystem entry point for build()
+    static void build_job(void* render_batch, size_t buffer_index);
+
+    // Uploads and draws the built render buffers in [first_buffer, end_buffer). Needs the GL context.
+    void submit(size_t first_buffer, size_t end_buffer);
+
+    // Fences the ring memory of everything submitted since the last wave
+    void end_wave();
+
+    // Where a render buffer built into the shared arena of the multi draw landed
+    [[nodiscard]] IndirectBuffer indirect_buffer(size_t buffer_index) const;
+
+    [[nodiscard]] uint32_t id() const {
+        return batch_id;
+    }
+
+    [[nodiscard]] const Pipeline& pipeline() const {
+        return batch_pipeline;
+    }
+
+    // Forgets the render buffers of the frame, their memory goes back with the frame arena
+    void end_frame();
 
 private:
-    [[nodiscard]] BatchedBuffer generate_batched_buffer(const RenderBuffer& render_buffer) const;
+    // Writes the transformed vertices and rebased indices of the render buffer into the given spans
+    void generate_batched_buffer(RenderBuffer& render_buffer, std::span<Shape::BatchVertex> vertices, std::span<BatchIndex> indices) const;
+
+    // Interleaves the kernel output with the packed tint, uv and material streams into the final vertices
+    void generate_vertex_buffer(const RenderBuffer& render_buffer, std::span<Shape::BatchVertex> vertices) const;
+
+    // Writes one instance record per drawable of the render buffer into the given span
+    void generate_instance_buffer(const RenderBuffer& render_buffer, std::span<Shape::InstanceData> instances) const;
+
+    // Opens a new render buffer in frame memory, sized for drawables of the shape
+    RenderBuffer& acquire_render_buffer(const Shape* shape);
+
+    // Points the destination at staging buffers taken from the frame arena or at freshly allocated ring memory, false
+    // when the rings are full
+    bool reserve_destination(RenderBuffer& render_buffer);
 
-    [[nodiscard]] std::vector<float> generate_vertex_buffer(const RenderBatch::Drawable& drawable) const;
+    // Uploads the staging buffers into the shared VBO/IBO, stalling if the previous draw still reads them
+    void upload_buffer_sub_data(const RenderBuffer& render_buffer) const;
 
-    void set_shader_projection(const ShaderProgram& shader);
+    // Draws the render buffer from where its destination placed it, as vertices or as instances of the shape
+    void draw(const RenderBuffer& render_buffer) const;
+
+    [[nodiscard]] const ShaderProgram& active_shader_program() const;
+
+    // The most drawables of the shape a single render buffer can hold before the vertex limit splits it
+    [[nodiscard]] static size_t max_drawables(const Shape* shape);
+
+    // Drawables of the shape the render buffer still takes before the vertex or index limit splits it
+    [[nodiscard]] static size_t drawables_left(const RenderBuffer& render_buffer, const Shape* shape);
+
+    // Slot of the texture in the render buffer, bound to the next free one when it is new. -1 without a texture.
+    [[nodiscard]] static int texture_slot(RenderBuffer& render_buffer, std::optional<Texture> texture);
 
     void set_shader_textures(const RenderBuffer& render_buffer);
 
@@ -79,15 +258,50 @@ private:
 
     void init_batch_ibo();
 
-    void add_to_render_buffer(Transform transform, glm::vec4 tint_color, std::optional<Texture> texture, RenderBuffer& render_buffer);
+    void init_instanced_buffers();
+
+    void queue_drawable(const Shape* shape, Transform transform, glm::vec4 tint_color, std::optional<Texture> texture, glm::vec4 uv_rect,
+                        float texture_layer, glm::vec4 shape_params);
+
+    void queue_instances(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, std::optional<Texture> texture,
+                         glm::vec4 uv_rect, float texture_layer, std::optional<Primitive> primitive);
+
+    // Records why the last render buffer could not take the next drawable
+    void count_split(size_t new_vertices_count, size_t new_indices_count) const;
+
+    void add_to_render_buffer(const Shape* shape, Transform transform, glm::vec4 tint_color, std::optional<Texture> texture, glm::vec4 uv_rect,
+                              float texture_layer, glm::vec4 shape_params, RenderBuffer& render_buffer);
+
+    // The instances have to fit, see drawables_left()
+    void add_instances_to_render_buffer(const Shape* shape, std::span<const DrawInstance> instances, float clip_depth, std::optional<Texture> texture,
+                                        glm::vec4 uv_rect, float texture_layer, std::optional<Primitive> primitive, RenderBuffer& render_buffer);
 
 private:
-    // This buffer exists only on CPU
-    std::vector<RenderBuffer> render_buffers;
+    // This buffer exists only on CPU, in frame memory
+    FrameArray<RenderBuffer> render_buffers;
+    bool split_requested;
 
     // Gpu Data
     Gpu gpu;
+    StreamBuffer vertex_stream;
+    StreamBuffer index_stream;
+    StreamBuffer instance_stream;
+
+    uint32_t batch_id;
+
+    // Every different pipeline has its own RenderBatch
+    Pipeline batch_pipeline;
+
+    const ShaderProgram* shader_program;
+
+    const RenderSettings* settings;
+
+    // Transforms instances on the GPU, replaces the shape's own program when instancing
+    const ShaderProgram* instanced_shader;
+
+    // Owned by the Renderer, reset after every flush
+    FrameArena* frame_arena;
 
-    // Every different shape has its own RenderBatch
-    const Shape* shape;
+    // Owned by the Renderer, nullptr unless multi draw indirect is enabled
+    MultiDraw* multi_draw;
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+
+// How RenderBatch moves the generated vertices and indices to the GPU
+enum class UploadMode {
+    // Re-uploads into a single VBO/IBO with glBufferSubData before every draw
+    BUFFER_SUB_DATA,
+    // Writes straight into persistently mapped, fence guarded ring buffers and draws with a base vertex
+    PERSISTENT_MAPPED
+};
+
+struct RenderSettings {
+    UploadMode upload_mode = UploadMode::PERSISTENT_MAPPED;
+
+    // Uploads each shape once and draws one compact instance record per drawable instead of transformed vertices
+    bool instancing = false;
+
+    // Builds the render buffers of all batches into one shared arena and draws each wave with glMultiDrawElementsIndirect.
+    // Needs persistent mapped uploads and the batched path, it is ignored when instancing.
+    bool multi_draw_indirect = false;
+
+    // Draws opaque drawables front to back with depth writes before the blended ones, see RenderPass. Without it every
+    // draw is blended back to front with the depth test off, the framebuffer needs no depth attachment then.
+    bool depth_test = true;
+
+    // Counts the fragments that pass the depth test every frame with an occlusion query, see
+    // Renderer::last_frame_overdraw()
+    bool count_overdraw = false;
+
+    // Threads building vertex data next to the main thread, GL calls always stay on the main thread
+    size_t worker_threads = 0;
+
+    // Initial bytes of each frame arena region, a region grows to the high water mark when a frame overflows it
+    size_t frame_arena_capacity = 8 * 1024 * 1024;
+};
@@ -1,34 +1,659 @@
+#include <algorithm>
 #include <glad/glad.h>
 #include <stb_image.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
 #include "Renderer.h"
 #include "Screen.h"
+#include "AllocationCounter.h"
+#include "TransformKernel.h"
+#include "Profiler.h"
 
 
-void Renderer::init(void* (* proc)(const char*)) {
+void Renderer::init(void* (* proc)(const char*), RenderSettings settings_) {
+    this->settings = settings_;
+
     init_gl(proc);
 
     Texture::init();
+
+    Profiler::init();
+
+    init_frame_data();
+
+    frame_arena.init(settings.frame_arena_capacity);
+
+    job_system.init(settings.worker_threads);
+    printf("Job threads      : %zu\n", job_system.thread_count());
+
+    printf("Transform kernel : %s\n", TransformKernel::active_name());
+
+    if (settings.instancing) {
+        instanced_shader.init("shader/instanced_quad.vert", "shader/filled_quad.frag");
+    }
+
+    // Indirect draws read the shared arena the batches write into mapped memory, instances are drawn per batch
+    if (settings.multi_draw_indirect && (settings.instancing || settings.upload_mode != UploadMode::PERSISTENT_MAPPED)) {
+        printf("Multi draw indirect needs persistent mapped batched uploads, disabled\n");
+        settings.multi_draw_indirect = false;
+    }
+
+    if (settings.multi_draw_indirect) {
+        multi_draw.init();
+    }
+    printf("Multi draw       : %s\n", settings.multi_draw_indirect ? "indirect" : "off");
+    printf("Depth test       : %s\n", settings.depth_test ? "opaque front to back" : "off");
+
+    tile_shader.init("shader/tile.vert", "shader/filled_quad.frag");
+
+    // UI vertices are built like the batched ones, in screen space
+    ui_shader.init("shader/filled_quad.vert", "shader/filled_quad.frag");
 }
 
-void Renderer::draw(const Shape* shape, glm::vec2 position, glm::vec2 scale, glm::vec4 tint_color, std::optional<Texture> texture) {
-    // Batch not found for this shape. Create one!
-    if (batches.find(shape->id) == batches.end()) {
-        auto [batch, _] = batches.emplace(shape->id, RenderBatch{shape});
-        batch->second.init();
+void Renderer::draw(const Shape* shape, glm::vec2 position, glm::vec2 scale, float rotation, glm::vec4 tint_color, std::optional<Texture> texture, uint8_t layer,
+                    float depth) {
+    AllocationCounter::Scope allocation_scope;
+    record(shape, DrawCommand{nullptr, nullptr, position, scale, rotation, tint_color, texture, std::nullopt, FULL_UV_RECT, NO_PRIMITIVE}, layer, depth);
+}
+
+void Renderer::draw(const Shape* shape, glm::vec2 position, glm::vec2 scale, float rotation, glm::vec4 tint_color, const AtlasSprite& sprite, uint8_t layer,
+                    float depth) {
+    AllocationCounter::Scope allocation_scope;
+    record(shape, DrawCommand{nullptr, nullptr, position, scale, rotation, tint_color, std::nullopt, sprite, FULL_UV_RECT, NO_PRIMITIVE}, layer, depth);
+}
+
+void Renderer::draw_primitive(const Shape* quad, const Primitive& primitive, glm::vec2 position, glm::vec2 scale, float rotation, glm::vec4 tint_color,
+                              uint8_t layer, float depth) {
+    AllocationCounter::Scope allocation_scope;
+    record(quad, DrawCommand{nullptr, nullptr, position, scale, rotation, tint_color, std::nullopt, std::nullopt, FULL_UV_RECT, primitive.shape_params(scale)}, layer, depth);
+}
+
+void Renderer::draw_text(const Shape* quad, Font* font, std::string_view text, glm::vec2 position, float scale, glm::vec4 tint_color, uint8_t layer,
+                         float depth) {
+    AllocationCounter::Scope allocation_scope;
+    Font::Layout& text_layout = font->layout(text);
 
-        printf("Initializing batch.\n");
+    // Labels outside of the view neither record their glyphs nor keep them in the atlas
+    if (!visible(position, text_layout.size * scale, 0.0F)) {
+        culled_draws += text_layout.glyphs.size();
+
+        return;
     }
 
-    RenderBatch& batch = batches.at(shape->id);
-    batch.queue(
-            position, scale, tint_color, texture
-    );
+    const Texture font_texture = font->texture();
+
+    for (Font::LayoutGlyph& glyph: text_layout.glyphs) {
+        std::optional<glm::vec4> uv_rect = font->glyph_uv_rect(glyph);
+
+        if (!uv_rect.has_value()) {
+            continue;
+        }
+
+        record(quad, DrawCommand{nullptr, nullptr, position + glyph.offset * scale, glyph.size * scale, 0.0F, tint_color, font_texture, std::nullopt, *uv_rect,
+                                 NO_PRIMITIVE}, layer, depth);
+    }
+
+    if (std::find(fonts.begin(), fonts.end(), font) == fonts.end()) {
+        fonts.push_back(font);
+    }
+}
+
+MaterialHandle Renderer::material(const Shape* shape, std::optional<Texture> texture) {
+    return add_material(ResolvedMaterial{shape, nullptr, texture, std::nullopt, std::nullopt, RenderPass::BLENDED});
+}
+
+MaterialHandle Renderer::material(const Shape* shape, const AtlasSprite& sprite) {
+    return add_material(ResolvedMaterial{shape, nullptr, std::nullopt, sprite, std::nullopt, RenderPass::BLENDED});
+}
+
+MaterialHandle Renderer::primitive_material(const Shape* quad, const Primitive& primitive) {
+    return add_material(ResolvedMaterial{quad, nullptr, std::nullopt, std::nullopt, primitive, RenderPass::BLENDED});
+}
+
+MaterialHandle Renderer::add_material(Renderer::ResolvedMaterial material_) {
+    material_.batch = &find_batch(material_.shape);
+    material_.pass = render_pass(material_.shape, instance_command(material_, DrawInstance{{0.0F, 0.0F}, {1.0F, 1.0F}, 0.0F, {1.0F, 1.0F, 1.0F, 1.0F}}));
+
+    materials.push_back(material_);
+
+    return MaterialHandle{(uint32_t) (materials.size() - 1)};
+}
+
+Renderer::DrawCommand Renderer::instance_command(const Renderer::ResolvedMaterial& material_, const DrawInstance& instance) {
+    const glm::vec4 shape_params = material_.primitive.has_value() ? material_.primitive->shape_params(instance.scale) : NO_PRIMITIVE;
+
+    return DrawCommand{material_.shape, material_.batch, instance.position, instance.scale, instance.rotation, instance.tint_color, material_.texture,
+                       material_.sprite, FULL_UV_RECT, shape_params};
+}
+
+void Renderer::draw_instances(MaterialHandle material_, std::span<const DrawInstance> instances_, uint8_t layer, float depth) {
+    AllocationCounter::Scope allocation_scope;
+    const ResolvedMaterial& resolved = materials[material_.index];
+
+    if (capture.is_open()) {
+        for (const DrawInstance& instance: instances_) {
+            capture_command(resolved.shape, instance_command(resolved, instance), layer, depth);
+        }
+    }
+
+    const size_t first_instance = instances.size();
+    size_t instance_count = 0;
+    bool copied = false;
+    bool opaque_tints = true;
+
+    for (size_t i = 0; i < instances_.size(); ++i) {
+        const DrawInstance& instance = instances_[i];
+
+        if (!visible(instance.position, instance.scale, instance.rotation)) {
+            // From the first culled instance on the visible ones are copied, the ones before it all were visible
+            if (!copied) {
+                instances.insert(instances.end(), instances_.begin(), instances_.begin() + (std::ptrdiff_t) i);
+                copied = true;
+            }
+
+            continue;
+        }
+
+        opaque_tints = opaque_tints && instance.tint_color.w >= 1.0F;
+        ++instance_count;
+
+        if (copied) {
+            instances.push_back(instance);
+        }
+    }
+
+    culled_draws += instances_.size() - instance_count;
+
+    if (instance_count == 0) {
+        return;
+    }
+
+    // Stands for all instances, they share everything the sort key is made of
+    DrawCommand command = instance_command(resolved, copied ? instances[first_instance] : instances_.front());
+    command.clip_depth = SortKey::clip_depth(layer, depth);
+    command.pass = opaque_tints ? resolved.pass : RenderPass::BLENDED;
+    command.material = material_;
+    command.caller_instances = copied ? nullptr : instances_.data();
+    command.first_instance = copied ? first_instance : 0;
+    command.instance_count = instance_count;
+
+    uint32_t texture_id = command.texture.has_value() ? command.texture->id : 0;
+
+    sort_keys.push_back(SortKey::make(command.pass, layer, depth, command.batch->id(), texture_id));
+    commands.push_back(command);
+}
+
+void Renderer::draw_captured(const Shape* shape, const DrawCaptureFormat::Command& command, std::optional<Texture> texture) {
+    AllocationCounter::Scope allocation_scope;
+    const glm::vec4 uv_rect{command.uv_rect[0], command.uv_rect[1], command.uv_rect[2], command.uv_rect[3]};
+    std::optional<AtlasSprite> sprite;
+
+    // Stand-in textures are opaque checkers, the draw keeps the pass of the texture it was captured with
+    if (texture.has_value()) {
+        texture->opaque = command.opaque != 0;
+    }
+
+    if (command.atlas_layer >= 0) {
+        sprite = AtlasSprite{command.atlas_layer, uv_rect, command.opaque != 0};
+        texture = std::nullopt;
+    }
+
+    record(shape, DrawCommand{nullptr, nullptr,
+                              glm::vec2{command.position[0], command.position[1]},
+                              glm::vec2{command.scale[0], command.scale[1]},
+                              command.rotation,
+                              glm::vec4{command.tint_color[0], command.tint_color[1], command.tint_color[2], command.tint_color[3]},
+                              texture,
+                              sprite,
+                              sprite.has_value() ? FULL_UV_RECT : uv_rect,
+                              glm::vec4{command.shape_params[0], command.shape_params[1], command.shape_params[2], command.shape_params[3]}}, command.layer,
+           command.depth);
+}
+
+void Renderer::record(const Shape* shape, Renderer::DrawCommand command, uint8_t layer, float depth) {
+    // Captured before culling, a replay culls against the captured camera again
+    if (capture.is_open()) {
+        capture_command(shape, command, layer, depth);
+    }
+
+    if (!visible(command.position, command.scale, command.rotation)) {
+        ++culled_draws;
+
+        return;
+    }
+
+    command.shape = shape;
+    command.batch = &find_batch(shape);
+    command.clip_depth = SortKey::clip_depth(layer, depth);
+    command.pass = render_pass(shape, command);
+
+    // Atlas sprites share the atlas texture unit, they never switch textures
+    uint32_t texture_id = command.texture.has_value() ? command.texture->id : 0;
+
+    sort_keys.push_back(SortKey::make(command.pass, layer, depth, command.batch->id(), texture_id));
+    commands.push_back(command);
+}
+
+RenderPass Renderer::render_pass(const Shape* shape, const Renderer::DrawCommand& command) const {
+    if (!settings.depth_test || shape->blend_mode != BlendMode::ALPHA || command.tint_color.w < 1.0F || command.shape_params != NO_PRIMITIVE) {
+        return RenderPass::BLENDED;
+    }
+
+    // Untextured draws sample the white empty texture
+    bool opaque = true;
+
+    if (command.sprite.has_value()) {
+        opaque = command.sprite->opaque;
+    } else if (command.texture.has_value()) {
+        opaque = command.texture->opaque;
+    }
+
+    return opaque ? RenderPass::OPAQUE : RenderPass::BLENDED;
+}
+
+void Renderer::capture_command(const Shape* shape, const DrawCommand& command, uint8_t layer, float depth) {
+    const glm::vec4 uv_rect = command.sprite.has_value() ? command.sprite->uv_rect : command.uv_rect;
+
+    DrawCaptureFormat::Command captured{};
+    captured.shape_id = (uint32_t) shape->id;
+    captured.texture_id = command.texture.has_value() ? command.texture->id : 0;
+    captured.atlas_layer = command.sprite.has_value() ? command.sprite->layer : -1;
+    captured.opaque = command.sprite.has_value() ? command.sprite->opaque : command.texture.has_value() && command.texture->opaque;
+    captured.layer = layer;
+    captured.depth = depth;
+    captured.rotation = command.rotation;
+
+    for (int c = 0; c < 2; ++c) {
+        captured.position[c] = command.position[c];
+        captured.scale[c] = command.scale[c];
+    }
+
+    for (int c = 0; c < 4; ++c) {
+        captured.tint_color[c] = command.tint_color[c];
+        captured.uv_rect[c] = uv_rect[c];
+        captured.shape_params[c] = command.shape_params[c];
+    }
+
+    capture.record(shape, captured);
+}
+
+std::span<const DrawInstance> Renderer::command_instances(const Renderer::DrawCommand& command) const {
+    const DrawInstance* source = command.caller_instances != nullptr ? command.caller_instances : instances.data();
+
+    return std::span{source + command.first_instance, command.instance_count};
+}
+
+bool Renderer::visible(glm::vec2 position, glm::vec2 scale, float rotation) const {
+    const glm::vec2 view_min = camera->view_min();
+    const glm::vec2 view_max = camera->view_max();
+
+    // Shapes span [0, 1] in their own space, scaled and then rotated around that origin
+    glm::vec2 min = glm::min(position, position + scale);
+    glm::vec2 max = glm::max(position, position + scale);
+
+    if (rotation != 0.0F) {
+        const float radius = glm::length(scale);
+        min = position - radius;
+        max = position + radius;
+    }
+
+    return max.x >= view_min.x && min.x <= view_max.x && max.y >= view_min.y && min.y <= view_max.y;
+}
+
+void Renderer::draw_tile_map(TileMap* tile_map) {
+    AllocationCounter::Scope allocation_scope;
+    tile_maps.push_back(tile_map);
+}
+
+void Renderer::draw_ui(UiLayer* ui_layer) {
+    AllocationCounter::Scope allocation_scope;
+    ui_layers.push_back(ui_layer);
+}
+
+bool Renderer::start_capture(const char* file_name) {
+    return capture.open(file_name);
+}
+
+void Renderer::stop_capture() {
+    if (capture.is_open()) {
+        printf("Capture          : %zu frames\n", capture.captured_frames());
+    }
+
+    capture.close();
+}
+
+void Renderer::set_atlas(const TextureAtlas* atlas_) {
+    this->atlas = atlas_;
+}
+
+void Renderer::set_camera(const Camera* camera_) {
+    this->camera = camera_ != nullptr ? camera_ : &screen_camera;
+}
+
+RenderBatch& Renderer::find_batch(const Shape* shape) {
+    const Pipeline pipeline = shape->pipeline(settings.instancing);
+    auto batch = batches.find(pipeline);
+
+    // No batch for this pipeline yet. Create one!
+    if (batch == batches.end()) {
+        batch = batches.emplace(pipeline, RenderBatch{(uint32_t) batches.size(), pipeline, &shape->shader_program, &settings, &instanced_shader,
+                                                      &frame_arena, settings.multi_draw_indirect ? &multi_draw : nullptr}).first;
+        batch->second.init();
+    }
+
+    return batch->second;
 }
 
 void Renderer::flush() {
-    for (auto& [_, batch]: batches) {
-        batch.flush();
+    // Counts until the frame statistics below are taken
+    AllocationCounter::Scope allocation_scope;
+
+    // The frame timer has to close before the frame statistics do
+    {
+        RTC_PROFILE_SCOPE("Renderer::flush");
+
+        frame_draw_calls = 0;
+
+        update_frame_data();
+
+        if (atlas != nullptr) {
+            glBindTextureUnit(ATLAS_TEXTURE_UNIT, atlas->texture().id);
+            RTC_PROFILE_COUNT(TEXTURE_BINDS, 1);
+        }
+
+        sort_commands();
+        queue_sorted_commands();
+
+        const auto first_blended = std::partition_point(submissions.begin(), submissions.end(), [](const Submission& submission) {
+            return submission.pass == RenderPass::OPAQUE;
+        });
+        const auto first_blended_submission = (size_t) (first_blended - submissions.begin());
+
+        if (settings.count_overdraw) {
+            begin_overdraw_query();
+        }
+
+        // Depth only lives for the frame. The clear obeys the depth mask, which the blended pass of the last frame left off.
+        if (settings.depth_test) {
+            apply_render_pass(RenderPass::OPAQUE);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            submit_waves(0, first_blended_submission);
+
+            apply_render_pass(RenderPass::BLENDED);
+        }
+
+        draw_tile_maps();
+
+        submit_waves(first_blended_submission, submissions.size());
+
+        // Tile maps and UI layers blend like the default pipeline
+        apply_blend_mode(BlendMode::ALPHA);
+
+        if (settings.count_overdraw) {
+            end_overdraw_query();
+        }
+
+        draw_ui_layers();
+
+        for (auto& [_, batch]: batches) {
+            batch.end_frame();
+        }
+
+        frame_arena.end_frame();
+
+        for (Font* font: fonts) {
+            font->end_frame();
+        }
+
+        if (capture.is_open()) {
+            capture.end_frame(*camera);
+        }
+
+        RTC_PROFILE_COUNT(DRAWS_CULLED, culled_draws);
+        frame_culled_draws = culled_draws;
+        culled_draws = 0;
+
+        tile_maps.clear();
+        ui_layers.clear();
+        fonts.clear();
+        commands.clear();
+        instances.clear();
+        sort_keys.clear();
+        submissions.clear();
+    }
+
+    Profiler::end_frame();
+
+    size_t allocations = AllocationCounter::count();
+    frame_allocations = allocations - frame_allocations_start;
+    frame_allocations_start = allocations;
+}
+
+void Renderer::sort_commands() {
+    RTC_PROFILE_SCOPE("Renderer::sort_commands");
+
+    const size_t command_count = commands.size();
+
+    sorted_commands.resize(command_count);
+    for (size_t i = 0; i < command_count; ++i) {
+        sorted_commands[i] = (uint32_t) i;
+    }
+
+    sort_scratch_keys.resize(command_count);
+    sort_scratch_commands.resize(command_count);
+
+    SortKey::radix_sort(sort_keys, sorted_commands, sort_scratch_keys, sort_scratch_commands);
+}
+
+void Renderer::queue_sorted_commands() {
+    RTC_PROFILE_SCOPE("Renderer::queue_sorted_commands");
+
+    RenderBatch* run_batch = nullptr;
+    RenderPass run_pass = RenderPass::OPAQUE;
+
+    for (uint32_t command_index: sorted_commands) {
+        const DrawCommand& command = commands[command_index];
+
+        // A render buffer is drawn in one pass, so a batch drawn in both starts a new one at the change
+        if (command.batch != run_batch || command.pass != run_pass) {
+            // Draws of this batch queued by an earlier run were already ordered before the runs in between
+            command.batch->split();
+
+            run_batch = command.batch;
+            run_pass = command.pass;
+            submissions.push_back(Submission{run_batch, run_batch->render_buffer_count(), 0, run_pass});
+        }
+
+        const glm::vec3 position{command.position, command.clip_depth};
+
+        if (command.material.has_value()) {
+            const ResolvedMaterial& resolved = materials[command.material->index];
+            const std::span<const DrawInstance> run_instances = command_instances(command);
+
+            if (resolved.sprite.has_value()) {
+                run_batch->queue(command.shape, run_instances, command.clip_depth, *resolved.sprite);
+            } else {
+                run_batch->queue(command.shape, run_instances, command.clip_depth, resolved.texture, FULL_UV_RECT, resolved.primitive);
+            }
+        } else if (command.sprite.has_value()) {
+            run_batch->queue(command.shape, position, command.scale, command.rotation, command.tint_color, *command.sprite, command.shape_params);
+        } else {
+            run_batch->queue(command.shape, position, command.scale, command.rotation, command.tint_color, command.texture, command.uv_rect,
+                             command.shape_params);
+        }
+
+        submissions.back().end_buffer = run_batch->render_buffer_count();
+    }
+}
+
+void Renderer::submit_waves(size_t first_submission, size_t end_submission) {
+    RTC_PROFILE_SCOPE("Renderer::submit_waves");
+
+    size_t next_submission = first_submission;
+
+    // Every wave reserves GPU memory for as many submissions as fit, builds all of their render buffers in parallel
+    // and then uploads and draws them in order on this thread. More than one wave is only needed when the rings run full.
+    while (next_submission < end_submission) {
+        wave_submissions.clear();
+        build_jobs.clear();
+
+        while (next_submission < end_submission) {
+            Submission& submission = submissions[next_submission];
+            size_t reserved_end = submission.batch->reserve(submission.first_buffer, submission.end_buffer);
+
+            if (reserved_end > submission.first_buffer) {
+                wave_submissions.push_back(Submission{submission.batch, submission.first_buffer, reserved_end, submission.pass});
+            }
+
+            for (size_t i = submission.first_buffer; i < reserved_end; ++i) {
+                build_jobs.push_back(JobSystem::Job{RenderBatch::build_job, submission.batch, i});
+            }
+
+            // The rings of this batch are full, draw what is reserved and continue in the next wave
+            if (reserved_end < submission.end_buffer) {
+                submission.first_buffer = reserved_end;
+                break;
+            }
+
+            ++next_submission;
+        }
+
+        {
+            RTC_PROFILE_SCOPE("Renderer::build_wave");
+            job_system.run(build_jobs);
+        }
+
+        // All submissions of the wave lie in the shared arena and go out together, in their order
+        if (settings.multi_draw_indirect) {
+            for (const Submission& submission: wave_submissions) {
+                multi_draw.add(*submission.batch, submission.first_buffer, submission.end_buffer);
+            }
+
+            frame_draw_calls += multi_draw.submit();
+            multi_draw.end_wave();
+
+            continue;
+        }
+
+        for (const Submission& submission: wave_submissions) {
+            submission.batch->submit(submission.first_buffer, submission.end_buffer);
+            frame_draw_calls += submission.end_buffer - submission.first_buffer;
+        }
+
+        for (const Submission& submission: wave_submissions) {
+            submission.batch->end_wave();
+        }
+    }
+}
+
+void Renderer::draw_tile_maps() {
+    if (tile_maps.empty()) {
+        return;
+    }
+
+    RTC_PROFILE_SCOPE("Renderer::draw_tile_maps");
+
+    tile_shader.bind();
+
+    // Chunks outside of the view are neither uploaded nor drawn
+    for (TileMap* tile_map: tile_maps) {
+        frame_draw_calls += tile_map->draw(camera->view_min(), camera->view_max());
+    }
+}
+
+void Renderer::draw_ui_layers() {
+    if (ui_layers.empty()) {
+        return;
+    }
+
+    RTC_PROFILE_SCOPE("Renderer::draw_ui_layers");
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, gl_screen_frame_data_ubo_id);
+    ui_shader.bind();
+
+    // Over everything else whatever the depth of the world below
+    glDisable(GL_DEPTH_TEST);
+
+    for (UiLayer* ui_layer: ui_layers) {
+        ui_layer->update();
+        frame_draw_calls += ui_layer->draw();
+
+        // Their frame ends with the flush like the fonts text was drawn with
+        for (size_t f = 0; f < ui_layer->font_count(); ++f) {
+            if (std::find(fonts.begin(), fonts.end(), ui_layer->font(f)) == fonts.end()) {
+                fonts.push_back(ui_layer->font(f));
+            }
+        }
+    }
+
+    if (settings.depth_test) {
+        glEnable(GL_DEPTH_TEST);
+    }
+}
+
+void Renderer::init_frame_data() {
+    glCreateBuffers(1, &gl_frame_data_ubo_id);
+    glNamedBufferStorage(gl_frame_data_ubo_id, sizeof(FrameData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    const FrameData screen_frame_data{
+            screen_camera.projection()
+    };
+
+    glCreateBuffers(1, &gl_screen_frame_data_ubo_id);
+    glNamedBufferStorage(gl_screen_frame_data_ubo_id, sizeof(FrameData), &screen_frame_data, 0);
+}
+
+void Renderer::update_frame_data() {
+    FrameData frame_data{
+            camera->projection()
+    };
+
+    glNamedBufferSubData(gl_frame_data_ubo_id, 0, sizeof(FrameData), &frame_data);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, gl_frame_data_ubo_id);
+}
+
+void Renderer::begin_overdraw_query() {
+    if (overdraw_queries[0] == 0) {
+        glCreateQueries(GL_SAMPLES_PASSED, (GLsizei) overdraw_queries.size(), overdraw_queries.data());
     }
+
+    const GLuint query = overdraw_queries[overdraw_frame % OVERDRAW_QUERY_LATENCY];
+
+    // Issued OVERDRAW_QUERY_LATENCY frames ago, so this normally does not wait
+    if (overdraw_frame >= OVERDRAW_QUERY_LATENCY) {
+        GLuint64 samples = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+
+        frame_overdraw = (double) samples / (double) (Screen::WIDTH * Screen::HEIGHT);
+    }
+
+    glBeginQuery(GL_SAMPLES_PASSED, query);
+}
+
+void Renderer::end_overdraw_query() {
+    glEndQuery(GL_SAMPLES_PASSED);
+    ++overdraw_frame;
+}
+
+size_t Renderer::last_frame_allocations() const {
+    return frame_allocations;
+}
+
+size_t Renderer::last_frame_draw_calls() const {
+    return frame_draw_calls;
+}
+
+size_t Renderer::last_frame_culled_draws() const {
+    return frame_culled_draws;
+}
+
+double Renderer::last_frame_overdraw() const {
+    return frame_overdraw;
+}
+
+const FrameArena::Stats& Renderer::frame_arena_stats() const {
+    return frame_arena.frame_stats();
 }
 
 static void APIENTRY openglCallbackFunction(
@@ -70,6 +695,16 @@ void Renderer::init_gl(void* (* proc)(const char*)) {
     );
 
     glViewport(0, 0, Screen::WIDTH, Screen::HEIGHT); // Rendering Viewport
+
+    // Anti-aliased primitive edges and translucent sprites blend over what is already drawn
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Nearer draws have the smaller clip depth, draws at an equal depth cover each other in draw order
+    if (settings.depth_test) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+    }
     // 28, 44, 50
     glClearColor(0.11f, 0.172f, 0.196f, 1.0f); // Clear color for the color bit field
 
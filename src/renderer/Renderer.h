@@ -3,32 +3,304 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 #include <utility>
 #include <vector>
 #include <array>
 #include <unordered_set>
 #include <optional>
+#include <span>
+#include <string_view>
 #include <unordered_map>
 #include "ShaderProgram.h"
 #include "Texture.h"
 #include "Shape.h"
 #include "RenderBatch.h"
+#include "RenderSettings.h"
+#include "JobSystem.h"
+#include "SortKey.h"
+#include "TileMap.h"
+#include "Camera.h"
+#include "FrameArena.h"
+#include "Font.h"
+#include "UiLayer.h"
+#include "DrawCapture.h"
+#include "MultiDraw.h"
 
 
+// Frames an overdraw query stays in flight before its result is read back
+static constexpr const size_t OVERDRAW_QUERY_LATENCY = 3;
+
+// A shape with its texture, atlas sprite or primitive, resolved once by Renderer::material(). Valid as long as the
+// renderer that made it.
+struct MaterialHandle {
+    uint32_t index;
+};
+
 class Renderer {
 public:
-    void init(void* (* proc)(const char*));
+    void init(void* (* proc)(const char*), RenderSettings settings_ = {});
 
+    // Draws entirely outside of the camera view are dropped right away, before they cost any sorting or vertex work.
+    // Layers are drawn in increasing order. Within a layer, depth runs from 0 (front) to 1 (back) and farther draws
+    // come first. Draws with the same layer and depth may be reordered to save state changes.
+    // Draws that cover their shape with full alpha (untextured or with an opaque texture or sprite, full tint alpha, no
+    // primitive, alpha blended) are drawn before everything else, front to back with depth writes, so what they hide
+    // is never shaded. The result is the same as if they were drawn in order.
+    // The rotation is in radians around the shape origin
     void draw(const Shape* shape,
               glm::vec2 position,
               glm::vec2 scale,
+              float rotation = 0.0F,
               glm::vec4 tint_color = {1.0F, 1.0F, 1.0F, 1.0F},
-              std::optional<Texture> texture = std::nullopt); // Adds the shape for rendering
+              std::optional<Texture> texture = std::nullopt,
+              uint8_t layer = 0,
+              float depth = 0.0F); // Adds the shape for rendering
+
+    void draw(const Shape* shape,
+              glm::vec2 position,
+              glm::vec2 scale,
+              float rotation,
+              glm::vec4 tint_color,
+              const AtlasSprite& sprite,
+              uint8_t layer = 0,
+              float depth = 0.0F); // Adds the shape textured with a sprite of the atlas
+
+    // Draws a primitive on a quad shape, the primitive fills the quad the other draw calls would cover. Primitives batch
+    // with everything else drawn with that shape.
+    void draw_primitive(const Shape* quad,
+                        const Primitive& primitive,
+                        glm::vec2 position,
+                        glm::vec2 scale,
+                        float rotation = 0.0F,
+                        glm::vec4 tint_color = {1.0F, 1.0F, 1.0F, 1.0F},
+                        uint8_t layer = 0,
+                        float depth = 0.0F);
+
+    // Draws the text with the bottom left of its box at position, scale 1 draws it at the pixel height of the font. Every
+    // glyph is a quad textured from the font atlas, so text batches with the other draws of the quad shape. The font
+    // caches the layout, an unchanged text only looks up where its glyphs are in the atlas.
+    void draw_text(const Shape* quad,
+                   Font* font,
+                   std::string_view text,
+                   glm::vec2 position,
+                   float scale = 1.0F,
+                   glm::vec4 tint_color = {1.0F, 1.0F, 1.0F, 1.0F},
+                   uint8_t layer = 0,
+                   float depth = 0.0F);
+
+    // Resolves the batch, the texture and the pass of the shape once, so draw_instances() skips them for every drawable.
+    // Meant to be made while loading, every call adds a material.
+    [[nodiscard]] MaterialHandle material(const Shape* shape, std::optional<Texture> texture = std::nullopt);
+
+    [[nodiscard]] MaterialHandle material(const Shape* shape, const AtlasSprite& sprite);
+
+    // The primitive drawn on the quad shape, see draw_primitive()
+    [[nodiscard]] MaterialHandle primitive_material(const Shape* quad, const Primitive& primitive);
+
+    // Draws every instance with the material at one layer and depth. The instances sort as one draw, so they keep their
+    // order and reach the render buffers in chunks. The span has to stay valid until flush(), it is queued as it is
+    // while every instance is visible and only the visible ones are copied into frame memory otherwise. Culling is the
+    // only work done per instance before the render buffers are built.
+    void draw_instances(MaterialHandle material, std::span<const DrawInstance> instances_, uint8_t layer = 0, float depth = 0.0F);
+
+    // Draws the visible chunks of the tile map this frame, below everything else. Its changed chunks are uploaded first.
+    // They are drawn after the opaque draws, where those cover the map it is never shaded.
+    void draw_tile_map(TileMap* tile_map);
+
+    // Draws the UI layer this frame in screen space, over everything else and unaffected by the camera. Its dirty
+    // widgets are rebuilt first.
+    void draw_ui(UiLayer* ui_layer);
+
+    // Draws a command of a capture again, with texture standing in for the texture it was captured with
+    void draw_captured(const Shape* shape, const DrawCaptureFormat::Command& command, std::optional<Texture> texture);
+
+    // Records every draw reaching the renderer from now on into the file, one frame per flush. Tile maps and UI layers
+    // are retained on the GPU and not part of the capture.
+    [[nodiscard]] bool start_capture(const char* file_name);
+
+    void stop_capture();
+
+    // The atlas sprites are sampled from, bound once per frame
+    void set_atlas(const TextureAtlas* atlas_);
+
+    // The camera the frame is seen through, it must not move between the draws of a frame and its flush. Without one
+    // the world maps one to one onto the screen.
+    void set_camera(const Camera* camera_);
 
     void flush(); // Executes the actual draw command
 
+    // Heap allocations the draw calls and the flush made on the calling thread, between the end of the previous flush
+    // and the end of the last one. Only counted when built with RTC_COUNT_ALLOCATIONS, otherwise always zero.
+    [[nodiscard]] size_t last_frame_allocations() const;
+
+    // Draw calls issued by the last flush
+    [[nodiscard]] size_t last_frame_draw_calls() const;
+
+    // Draws of the last frame dropped for being outside of the camera view
+    [[nodiscard]] size_t last_frame_culled_draws() const;
+
+    // Fragments the world of a frame shaded per screen pixel, tile maps included and UI layers not. 1 means every pixel
+    // was shaded once. Only counted with RenderSettings::count_overdraw, the value is OVERDRAW_QUERY_LATENCY frames old.
+    [[nodiscard]] double last_frame_overdraw() const;
+
+    // Usage of the memory the render batches take per frame, the high water mark tells how large to make it
+    [[nodiscard]] const FrameArena::Stats& frame_arena_stats() const;
+
 private:
+    // The batch of the shape's pipeline, created on first use
+    RenderBatch& find_batch(const Shape* shape);
+
+    // What a MaterialHandle stands for
+    struct ResolvedMaterial {
+        const Shape* shape;
+        // Batches live as long as the renderer and never move
+        RenderBatch* batch;
+        std::optional<Texture> texture;
+        std::optional<AtlasSprite> sprite;
+        std::optional<Primitive> primitive;
+        // Of draws at full tint alpha, a translucent tint moves a draw into the blended pass
+        RenderPass pass;
+    };
+
+    // A draw recorded until the frame is sorted in flush()
+    struct DrawCommand {
+        const Shape* shape;
+        RenderBatch* batch;
+        glm::vec2 position;
+        glm::vec2 scale;
+        float rotation;
+        glm::vec4 tint_color;
+        std::optional<Texture> texture;
+        std::optional<AtlasSprite> sprite;
+        // Region of the texture, glyphs are a cell of their font atlas
+        glm::vec4 uv_rect;
+        glm::vec4 shape_params;
+        // Set when recorded, from the layer and depth of the draw
+        float clip_depth = 0.0F;
+        RenderPass pass = RenderPass::BLENDED;
+        // Only set for draw_instances(), its instances are [first_instance, first_instance + instance_count) of the
+        // caller's span, or of the frame's culled copies when there is none
+        std::optional<MaterialHandle> material = std::nullopt;
+        const DrawInstance* caller_instances = nullptr;
+        size_t first_instance = 0;
+        size_t instance_count = 0;
+    };
+
+    // A run of render buffers of one batch, submitted in the order of the sorted draws
+    struct Submission {
+        RenderBatch* batch;
+        size_t first_buffer;
+        size_t end_buffer;
+        RenderPass pass;
+    };
+
+    void record(const Shape* shape, DrawCommand command, uint8_t layer, float depth);
+
+    // Opaque when the draw covers every pixel of its shape with full alpha and depth testing is enabled
+    [[nodiscard]] RenderPass render_pass(const Shape* shape, const DrawCommand& command) const;
+
+    void capture_command(const Shape* shape, const DrawCommand& command, uint8_t layer, float depth);
+
+    MaterialHandle add_material(ResolvedMaterial material_);
+
+    // The single draw an instance of the material stands for
+    [[nodiscard]] static DrawCommand instance_command(const ResolvedMaterial& material_, const DrawInstance& instance);
+
+    [[nodiscard]] std::span<const DrawInstance> command_instances(const DrawCommand& command) const;
+
+    // Conservative test against the view, rotated shapes are bound by the circle they sweep around their origin
+    [[nodiscard]] bool visible(glm::vec2 position, glm::vec2 scale, float rotation) const;
+
+    void sort_commands();
+
+    // Queues the sorted draws into their batches, every change of batch or pass starts a new submission. The opaque
+    // submissions come first.
+    void queue_sorted_commands();
+
+    // Reserves, builds and draws the submissions in [first_submission, end_submission) in order
+    void submit_waves(size_t first_submission, size_t end_submission);
+
+    // Tile maps draw with the atlas bound, between the opaque and the blended draws
+    void draw_tile_maps();
+
+    // UI layers draw last, with the screen FrameData bound
+    void draw_ui_layers();
+
     void init_gl(void* (* proc)(const char*));
+
+    void init_frame_data();
+
+    // Uploads the per frame uniforms and binds them for every program
+    void update_frame_data();
+
+    // Counts the samples between begin and end into the query of this frame, reading back the one of
+    // OVERDRAW_QUERY_LATENCY frames ago first
+    void begin_overdraw_query();
+
+    void end_overdraw_query();
 private:
-    std::unordered_map<size_t, RenderBatch> batches;
+    // Mirrors the FrameData uniform block of the shaders, std140 layout
+    struct FrameData {
+        glm::mat4 projection;
+    };
+
+    RenderSettings settings;
+
+    // Shared by every batch when instancing is enabled
+    ShaderProgram instanced_shader;
+
+    ShaderProgram tile_shader;
+
+    ShaderProgram ui_shader;
+
+    std::unordered_map<Pipeline, RenderBatch, Pipeline::Hash> batches;
+
+    // Indexed by MaterialHandle
+    std::vector<ResolvedMaterial> materials;
+
+    // Draws the render buffers of all batches when multi draw indirect is enabled
+    MultiDraw multi_draw;
+
+    // Render buffers and their staging memory, dropped as a whole after every flush
+    FrameArena frame_arena;
+
+    const TextureAtlas* atlas = nullptr;
+
+    Camera screen_camera;
+    const Camera* camera = &screen_camera;
+
+    GLuint gl_frame_data_ubo_id = 0;
+    // Projection of the screen camera, for the UI layers. Never changes after init.
+    GLuint gl_screen_frame_data_ubo_id = 0;
+
+    // Frame data, cleared every flush but keeping its memory
+    std::vector<DrawCommand> commands;
+    std::vector<DrawInstance> instances;
+    std::vector<uint64_t> sort_keys;
+    std::vector<uint32_t> sorted_commands;
+    std::vector<uint64_t> sort_scratch_keys;
+    std::vector<uint32_t> sort_scratch_commands;
+    std::vector<Submission> submissions;
+    std::vector<Submission> wave_submissions;
+    std::vector<TileMap*> tile_maps;
+    std::vector<Font*> fonts;
+    std::vector<UiLayer*> ui_layers;
+
+    // Open while a capture is recording
+    DrawCapture capture;
+
+    JobSystem job_system;
+    std::vector<JobSystem::Job> build_jobs;
+
+    size_t frame_allocations_start = 0;
+    size_t frame_allocations = 0;
+    size_t frame_draw_calls = 0;
+    size_t culled_draws = 0;
+    size_t frame_culled_draws = 0;
+
+    // GL_SAMPLES_PASSED queries of the frames in flight, created on first use
+    std::array<GLuint, OVERDRAW_QUERY_LATENCY> overdraw_queries{};
+    uint64_t overdraw_frame = 0;
+    double frame_overdraw = 0.0;
 };
\ No newline at end of file
@@ -1,25 +1,82 @@
 #include <glad/glad.h>
 #include <cstdio>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include "ShaderProgram.h"
 
 
+// Relative to the working directory, like the shader files
+std::string ShaderProgram::binary_cache_directory = "shader_cache";
+
+
 void ShaderProgram::init(const char* vertex_shader_file, const char* fragment_shader_file) {
-    GLuint vertex_shader = load_shader(vertex_shader_file, GL_VERTEX_SHADER);
+    std::optional<std::string> vertex_shader_source = read_shader(vertex_shader_file);
 
-    if (vertex_shader == 0) {
+    if (!vertex_shader_source.has_value()) {
         return;
     }
 
-    GLuint fragment_shader = load_shader(fragment_shader_file, GL_FRAGMENT_SHADER);
+    std::optional<std::string> fragment_shader_source = read_shader(fragment_shader_file);
 
-    if (fragment_shader == 0) {
+    if (!fragment_shader_source.has_value()) {
         return;
     }
 
+    build(vertex_shader_file, *vertex_shader_source, fragment_shader_file, *fragment_shader_source);
+}
+
+void ShaderProgram::init_from_sources(std::string_view vertex_shader_source, std::string_view fragment_shader_source) {
+    build("vertex", vertex_shader_source, "fragment", fragment_shader_source);
+}
+
+void ShaderProgram::set_binary_cache(const char* directory) {
+    binary_cache_directory = directory != nullptr ? directory : "";
+}
+
+void ShaderProgram::build(const char* vertex_shader_name, std::string_view vertex_shader_source,
+                          const char* fragment_shader_name, std::string_view fragment_shader_source) {
+    const uint64_t cache_key = binary_cache_key(vertex_shader_source, fragment_shader_source);
+
+    GLuint program = load_binary(cache_key);
+
+    if (program == 0) {
+        GLuint vertex_shader = compile_shader(vertex_shader_name, vertex_shader_source, GL_VERTEX_SHADER);
+
+        if (vertex_shader == 0) {
+            return;
+        }
+
+        GLuint fragment_shader = compile_shader(fragment_shader_name, fragment_shader_source, GL_FRAGMENT_SHADER);
+
+        if (fragment_shader == 0) {
+            return;
+        }
+
+        program = link(vertex_shader, fragment_shader);
+
+        if (program == 0) {
+            return;
+        }
+
+        save_binary(program, cache_key);
+    }
+
+    this->program_id = program;
+
+    reflect_uniforms();
+
+    // FUTURE TODO: Maybe only certain shader needs this? Should we move this outside of here?
+    init_texture_slots();
+}
+
+GLuint ShaderProgram::link(GLuint vertex_shader, GLuint fragment_shader) {
     GLuint program = glCreateProgram();
+    // Lets the driver keep what glGetProgramBinary needs for the cache
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(program, vertex_shader);
     glAttachShader(program, fragment_shader);
     glLinkProgram(program);
@@ -33,8 +90,9 @@ void ShaderProgram::init(const char* vertex_shader_file, const char* fragment_sh
         printf("Error: Cannot link shaders to program: %s", message);
         glDeleteShader(vertex_shader);
         glDeleteShader(fragment_shader);
+        glDeleteProgram(program);
 
-        return;
+        return 0;
     }
 
     glValidateProgram(program);
@@ -48,8 +106,9 @@ void ShaderProgram::init(const char* vertex_shader_file, const char* fragment_sh
         printf("Error: Cannot validate shaders to program: %s", message);
         glDeleteShader(vertex_shader);
         glDeleteShader(fragment_shader);
+        glDeleteProgram(program);
 
-        return;
+        return 0;
     }
 
     glDeleteShader(vertex_shader);
@@ -57,10 +116,7 @@ void ShaderProgram::init(const char* vertex_shader_file, const char* fragment_sh
 
     printf("Loaded Main Program.\n");
 
-    this->program_id = program;
-
-    // FUTURE TODO: Maybe only certain shader needs this? Should we move this outside of here?
-    init_texture_slots();
+    return program;
 }
 
 void ShaderProgram::bind() const {
@@ -71,33 +127,50 @@ void ShaderProgram::unbind() const {
     glUseProgram(0);
 }
 
+GLint ShaderProgram::uniform_location(std::string_view uniform_name) const {
+    auto it = uniform_locations.find(uniform_name);
+
+    if (it == uniform_locations.end()) {
+        return -1;
+    }
+
+    return it->second;
+}
+
 void ShaderProgram::setMatrix(const char* uniform_name, glm::mat<4, 4, float> matrix) const {
-    glUniformMatrix4fv(glGetUniformLocation(this->program_id, uniform_name), 1, GL_FALSE, glm::value_ptr(matrix));
+    glProgramUniformMatrix4fv(program_id, uniform_location(uniform_name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void ShaderProgram::setIntArray(const char* uniform_name, const std::vector<int>& array) const {
-    glUniform1iv(glGetUniformLocation(this->program_id, uniform_name), array.size(), array.data());
+    glProgramUniform1iv(program_id, uniform_location(uniform_name), array.size(), array.data());
 }
 
-GLuint ShaderProgram::load_shader(const char* file_name, GLenum gl_shader_type) {
+void ShaderProgram::setInt(const char* uniform_name, int value) const {
+    glProgramUniform1i(program_id, uniform_location(uniform_name), value);
+}
+
+std::optional<std::string> ShaderProgram::read_shader(const char* file_name) {
     std::ifstream shader_file{file_name};
 
     if (!shader_file.good()) {
         printf("Failed to open %s\n", file_name);
 
-        return 0;
+        return std::nullopt;
     }
 
     std::stringstream shader_buffer;
     shader_buffer << shader_file.rdbuf();
     shader_file.close();
 
-    std::string shader_code = shader_buffer.str();
+    return shader_buffer.str();
+}
 
+GLuint ShaderProgram::compile_shader(const char* name, std::string_view shader_source, GLenum gl_shader_type) {
     GLuint shader_id;
     shader_id = glCreateShader(gl_shader_type);
-    const char* shader_src = shader_code.c_str();
-    glShaderSource(shader_id, 1, &shader_src, nullptr);
+    const char* shader_src = shader_source.data();
+    const auto shader_length = (GLint) shader_source.size();
+    glShaderSource(shader_id, 1, &shader_src, &shader_length);
     glCompileShader(shader_id);
 
     GLint shader_compiled;
@@ -106,7 +179,7 @@ GLuint ShaderProgram::load_shader(const char* file_name, GLenum gl_shader_type)
         GLsizei log_length = 0;
         GLchar message[1024];
         glGetShaderInfoLog(shader_id, 1024, &log_length, message);
-        printf("Error: Cannot compile %s shader: %s", file_name, message);
+        printf("Error: Cannot compile %s shader: %s", name, message);
 
         return 0;
     }
@@ -115,14 +188,163 @@ GLuint ShaderProgram::load_shader(const char* file_name, GLenum gl_shader_type)
 }
 
 void ShaderProgram::init_texture_slots() const {
-    bind();
     std::vector<int> textures{};
-    textures.reserve(MAX_TEXTURES);
+    textures.reserve(MAX_TEXTURES + 1);
 
     for (int i = 0; i < MAX_TEXTURES + 1; ++i) {
         textures.push_back(i);
     }
 
     setIntArray("u_textures", textures);
-    unbind();
+    setInt("u_atlas", ATLAS_TEXTURE_UNIT);
+}
+
+void ShaderProgram::reflect_uniforms() {
+    uniform_locations.clear();
+
+    GLint uniform_count = 0;
+    GLint max_name_length = 0;
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<GLchar> name_buffer(std::max(max_name_length, 1));
+
+    for (GLint i = 0; i < uniform_count; ++i) {
+        GLsizei name_length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program_id, (GLuint) i, (GLsizei) name_buffer.size(), &name_length, &size, &type, name_buffer.data());
+
+        std::string name{name_buffer.data(), (size_t) name_length};
+        GLint location = glGetUniformLocation(program_id, name.c_str());
+
+        // Members of uniform blocks have no location, they are set through their buffer
+        if (location < 0) {
+            continue;
+        }
+
+        // Arrays are reported as name[0] and set through their base name
+        if (name.ends_with("[0]")) {
+            name.resize(name.size() - 3);
+        }
+
+        uniform_locations.emplace(std::move(name), location);
+    }
+}
+
+uint64_t ShaderProgram::binary_cache_key(std::string_view vertex_shader_source, std::string_view fragment_shader_source) {
+    // FNV-1a over the sources and the driver, a driver update changes the key instead of failing to load
+    uint64_t hash = 14695981039346656037ULL;
+
+    auto mix = [&hash](std::string_view data) {
+        for (char c: data) {
+            hash ^= (unsigned char) c;
+            hash *= 1099511628211ULL;
+        }
+
+        hash ^= 0xFF;
+        hash *= 1099511628211ULL;
+    };
+
+    mix(vertex_shader_source);
+    mix(fragment_shader_source);
+    mix((const char*) glGetString(GL_VENDOR));
+    mix((const char*) glGetString(GL_RENDERER));
+    mix((const char*) glGetString(GL_VERSION));
+
+    return hash;
+}
+
+std::string ShaderProgram::binary_cache_path(uint64_t cache_key) {
+    char file_name[32];
+    snprintf(file_name, sizeof(file_name), "/%016llx.bin", (unsigned long long) cache_key);
+
+    return binary_cache_directory + file_name;
+}
+
+GLuint ShaderProgram::load_binary(uint64_t cache_key) {
+    if (binary_cache_directory.empty()) {
+        return 0;
+    }
+
+    const std::string cache_path = binary_cache_path(cache_key);
+    std::ifstream cache_file{cache_path, std::ios::binary};
+
+    if (!cache_file.good()) {
+        return 0;
+    }
+
+    ProgramBinaryHeader header{};
+    cache_file.read((char*) &header, sizeof(header));
+
+    if (!cache_file.good() || memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) != 0) {
+        return 0;
+    }
+
+    // A truncated or corrupt file must not make us allocate whatever length it claims
+    std::error_code error;
+    const std::uintmax_t file_size = std::filesystem::file_size(cache_path, error);
+
+    if (error || file_size != sizeof(header) + (std::uintmax_t) header.length) {
+        printf("Cached program binary has the wrong size, compiling from source.\n");
+
+        return 0;
+    }
+
+    std::vector<char> binary(header.length);
+    cache_file.read(binary.data(), (std::streamsize) binary.size());
+
+    if (!cache_file.good()) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+
+    // Drivers are free to reject binaries of another version, the program is then built from source again
+    GLint program_linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &program_linked);
+    if (program_linked != GL_TRUE) {
+        printf("Cached program binary rejected, compiling from source.\n");
+        glDeleteProgram(program);
+
+        return 0;
+    }
+
+    return program;
+}
+
+void ShaderProgram::save_binary(GLuint program, uint64_t cache_key) {
+    if (binary_cache_directory.empty()) {
+        return;
+    }
+
+    GLint binary_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+
+    GLint binary_length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+
+    if (binary_formats == 0 || binary_length == 0) {
+        return;
+    }
+
+    ProgramBinaryHeader header{};
+    memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+
+    std::vector<char> binary((size_t) binary_length);
+    GLsizei written_length = 0;
+    glGetProgramBinary(program, binary_length, &written_length, &header.format, binary.data());
+    header.length = (uint32_t) written_length;
+
+    std::error_code error;
+    std::filesystem::create_directories(binary_cache_directory, error);
+
+    std::ofstream cache_file{binary_cache_path(cache_key), std::ios::binary | std::ios::trunc};
+    cache_file.write((const char*) &header, sizeof(header));
+    cache_file.write(binary.data(), written_length);
+
+    if (!cache_file.good()) {
+        printf("Failed to write the program binary cache to %s\n", binary_cache_directory.c_str());
+    }
 }
@@ -2,33 +2,97 @@
 
 #include <SDL_opengl.h>
 #include <glm/detail/type_mat4x4.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
 
 static constexpr const size_t MAX_TEXTURES = 8;
 
+// The TextureAtlas is bound right after the texture slots (unit 0 is the empty texture)
+static constexpr const GLuint ATLAS_TEXTURE_UNIT = MAX_TEXTURES + 1;
+
+// Uniform buffer binding of the FrameData block, must match the binding declared in the shaders
+static constexpr const GLuint FRAME_DATA_BINDING = 0;
+
+static constexpr const char PROGRAM_BINARY_MAGIC[4] = {'R', 'T', 'C', 'B'};
+
 class ShaderProgram {
 public:
-    ShaderProgram() : program_id { 0 } {
+    ShaderProgram() : program_id { 0 }, uniform_locations {} {
 
     }
 
     void init(const char* vertex_shader_file, const char* fragment_shader_file);
 
+    // Same as init() with sources that are already in memory, e.g. from an AssetPack
+    void init_from_sources(std::string_view vertex_shader_source, std::string_view fragment_shader_source);
+
+    // Directory linked programs are cached in with glGetProgramBinary, nullptr disables the cache
+    static void set_binary_cache(const char* directory);
+
     void bind() const;
 
     void unbind() const;
 
+    [[nodiscard]] GLuint id() const {
+        return program_id;
+    }
+
+    // Location reflected at link time, -1 when the program has no such active uniform
+    [[nodiscard]] GLint uniform_location(std::string_view uniform_name) const;
+
     void setMatrix(const char* uniform_name, glm::mat<4, 4, float> matrix) const;
 
     void setIntArray(const char* uniform_name, const std::vector<int>& array) const;
 
+    void setInt(const char* uniform_name, int value) const;
+
 private:
-    static GLuint load_shader(const char* file_name, GLenum gl_shader_type);
+    struct ProgramBinaryHeader {
+        char magic[4];
+        GLenum format;
+        uint32_t length;
+    };
+
+    // Lets the location table be searched by string_view without building a std::string
+    struct UniformNameHash {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    static std::optional<std::string> read_shader(const char* file_name);
+
+    // The name only shows up in error messages
+    static GLuint compile_shader(const char* name, std::string_view shader_source, GLenum gl_shader_type);
+
+    static GLuint link(GLuint vertex_shader, GLuint fragment_shader);
+
+    void build(const char* vertex_shader_name, std::string_view vertex_shader_source,
+               const char* fragment_shader_name, std::string_view fragment_shader_source);
 
     void init_texture_slots() const;
 
+    void reflect_uniforms();
+
+    static uint64_t binary_cache_key(std::string_view vertex_shader_source, std::string_view fragment_shader_source);
+
+    static std::string binary_cache_path(uint64_t cache_key);
+
+    // Zero when there is no usable cached binary
+    static GLuint load_binary(uint64_t cache_key);
+
+    static void save_binary(GLuint program, uint64_t cache_key);
+
 private:
     GLuint program_id;
+    std::unordered_map<std::string, GLint, UniformNameHash, std::equal_to<>> uniform_locations;
+
+    static std::string binary_cache_directory;
 };
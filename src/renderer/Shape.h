@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ShaderProgram.h"
+#include "VertexFormat.h"
+#include "Pipeline.h"
+
+
+// Atlas layer of a drawable that samples its texture slot instead
+static constexpr const uint8_t NO_ATLAS_LAYER = 255;
+
+struct Shape {
+    struct Vertex {
+        glm::vec2 points;
+        glm::vec2 uvs;
+    };
+
+    // How the fragment shader colors a drawable, read as one uvec4
+    struct Material {
+        // Render buffer texture slot, 0 is the empty white texture
+        uint8_t texture_index;
+        // Layer of the TextureAtlas to sample from, NO_ATLAS_LAYER when the texture slot is used instead
+        uint8_t texture_layer;
+        // PrimitiveKind evaluated by the fragment shader
+        uint8_t primitive_kind;
+        uint8_t reserved;
+    };
+
+    // Interleaved vertex as it is written into the GPU buffers, see VertexFormat<BatchVertex> for how the shaders read
+    // it. Positions stay full floats, world coordinates span thousands of units. z is the clip space depth of the
+    // drawable, it is not projected.
+    struct BatchVertex {
+        glm::vec3 position;
+        // RGBA8
+        uint32_t tint_color;
+        // unorm16 per axis, uv rects keep the coordinates in [0, 1]
+        uint32_t uv;
+        Material material;
+        // See pack_primitive_params()
+        uint32_t primitive_params;
+    };
+
+    // Per drawable record of the instanced path. The shape geometry lives on the GPU once and the vertex shader
+    // expands every instance into transformed vertices.
+    struct InstanceData {
+        // z as in BatchVertex
+        glm::vec3 position;
+        glm::vec2 scale;
+        float rotation;
+        // RGBA8
+        uint32_t tint_color;
+        // unorm16 offset and snorm16 size of the uv rect, the size is negative where the rect flips the texture
+        uint32_t uv_offset;
+        uint32_t uv_size;
+        Material material;
+        uint32_t primitive_params;
+    };
+
+    // texture_index is the render buffer slot, -1 for none. texture_layer is negative when no atlas layer is sampled.
+    [[nodiscard]] static Material make_material(int texture_index, float texture_layer, glm::vec4 shape_params);
+
+    // Corner radius and thickness of Primitive::shape_params() as two half floats
+    [[nodiscard]] static uint32_t pack_primitive_params(glm::vec4 shape_params);
+
+    size_t id;
+    std::vector<Vertex> vertices;
+    std::vector<int> indices;
+    ShaderProgram shader_program;
+    GLenum gl_render_mode = GL_TRIANGLES;
+    BlendMode blend_mode = BlendMode::ALPHA;
+
+    // The batch the shape's draws go into, see Pipeline
+    [[nodiscard]] Pipeline pipeline(bool instancing) const {
+        return Pipeline{shader_program.id(), gl_render_mode, blend_mode, instancing ? this : nullptr};
+    }
+};
+
+static_assert(sizeof(Shape::BatchVertex) == 28, "BatchVertex must stay tightly packed");
+static_assert(sizeof(Shape::InstanceData) == 44, "InstanceData must stay tightly packed");
+
+// Locations 0 and 1 of instanced_quad.vert
+template<>
+struct VertexFormat<Shape::Vertex> {
+    static constexpr const VertexAttribute ATTRIBUTES[] = {
+            {0, 2, GL_FLOAT, GL_FALSE, false, offsetof(Shape::Vertex, points)},
+            {1, 2, GL_FLOAT, GL_FALSE, false, offsetof(Shape::Vertex, uvs)}
+    };
+};
+
+// Inputs of filled_quad.vert
+template<>
+struct VertexFormat<Shape::BatchVertex> {
+    static constexpr const VertexAttribute ATTRIBUTES[] = {
+            {0, 3, GL_FLOAT, GL_FALSE, false, offsetof(Shape::BatchVertex, position)},
+            {1, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, offsetof(Shape::BatchVertex, tint_color)},
+            {2, 2, GL_UNSIGNED_SHORT, GL_TRUE, false, offsetof(Shape::BatchVertex, uv)},
+            {3, 4, GL_UNSIGNED_BYTE, GL_FALSE, true, offsetof(Shape::BatchVertex, material)},
+            {4, 2, GL_HALF_FLOAT, GL_FALSE, false, offsetof(Shape::BatchVertex, primitive_params)}
+    };
+};
+
+// Per instance inputs of instanced_quad.vert, after the shape geometry
+template<>
+struct VertexFormat<Shape::InstanceData> {
+    static constexpr const VertexAttribute ATTRIBUTES[] = {
+            {2, 3, GL_FLOAT, GL_FALSE, false, offsetof(Shape::InstanceData, position)},
+            {3, 2, GL_FLOAT, GL_FALSE, false, offsetof(Shape::InstanceData, scale)},
+            {4, 1, GL_FLOAT, GL_FALSE, false, offsetof(Shape::InstanceData, rotation)},
+            {5, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, offsetof(Shape::InstanceData, tint_color)},
+            {6, 2, GL_UNSIGNED_SHORT, GL_TRUE, false, offsetof(Shape::InstanceData, uv_offset)},
+            {7, 2, GL_SHORT, GL_TRUE, false, offsetof(Shape::InstanceData, uv_size)},
+            {8, 4, GL_UNSIGNED_BYTE, GL_FALSE, true, offsetof(Shape::InstanceData, material)},
+            {9, 2, GL_HALF_FLOAT, GL_FALSE, false, offsetof(Shape::InstanceData, primitive_params)}
+    };
+};
@@ -16,7 +16,6 @@ namespace ShapeGenerator {
                 {
                         0, 1, 3, 0, 3, 2
                 },
-                {},
                 shader_program
         };
     }
@@ -32,7 +31,6 @@ namespace ShapeGenerator {
                 {
                         0, 1, 2
                 },
-                {},
                 shader_program
         };
     }
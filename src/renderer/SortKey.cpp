@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include "SortKey.h"
+
+
+// Back to front position of a layer and depth, nearer draws get larger values
+static uint32_t paint_order(uint8_t layer, float depth) {
+    const float clamped_depth = std::clamp(depth, 0.0F, 1.0F);
+
+    return ((uint32_t) layer << 16) | (uint32_t) std::lround((1.0F - clamped_depth) * 65535.0F);
+}
+
+uint64_t SortKey::make(RenderPass pass, uint8_t layer, float depth, uint32_t batch, uint32_t texture) {
+    uint64_t order = paint_order(layer, depth);
+
+    // Opaque draws run the other way around, the nearest ones first
+    if (pass == RenderPass::OPAQUE) {
+        order = 0xFFFFFF - order;
+    }
+
+    return ((uint64_t) (pass == RenderPass::BLENDED) << 63) |
+           (order << 39) |
+           ((uint64_t) (batch & 0x7FFFFF) << 16) |
+           (uint64_t) (texture & 0xFFFF);
+}
+
+RenderPass SortKey::pass(uint64_t key) {
+    return (key >> 63) != 0 ? RenderPass::BLENDED : RenderPass::OPAQUE;
+}
+
+uint8_t SortKey::layer(uint64_t key) {
+    const auto layer_bits = (uint8_t) (key >> 55);
+
+    return pass(key) == RenderPass::OPAQUE ? (uint8_t) (255 - layer_bits) : layer_bits;
+}
+
+float SortKey::clip_depth(uint8_t layer, float depth) {
+    // Window depth 1 - (order + 1) / 2^24 is exact in a float and in the depth buffer
+    const auto order = (float) paint_order(layer, depth);
+
+    return 1.0F - 2.0F * (order + 1.0F) / 16777216.0F;
+}
+
+void SortKey::radix_sort(std::span<uint64_t> keys, std::span<uint32_t> values, std::span<uint64_t> scratch_keys, std::span<uint32_t> scratch_values) {
+    assert(keys.size() == values.size());
+    assert(scratch_keys.size() >= keys.size() && scratch_values.size() >= keys.size());
+
+    const size_t count = keys.size();
+
+    if (count <= 1) {
+        return;
+    }
+
+    uint64_t* source_keys = keys.data();
+    uint32_t* source_values = values.data();
+    uint64_t* target_keys = scratch_keys.data();
+    uint32_t* target_values = scratch_values.data();
+
+    for (size_t shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 256> offsets{};
+
+        for (size_t i = 0; i < count; ++i) {
+            ++offsets[(source_keys[i] >> shift) & 0xFF];
+        }
+
+        // Every key has the same byte here, the pass would not change the order
+        if (offsets[(source_keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        size_t running_offset = 0;
+        for (size_t& offset: offsets) {
+            size_t bucket_size = offset;
+            offset = running_offset;
+            running_offset += bucket_size;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            size_t target = offsets[(source_keys[i] >> shift) & 0xFF]++;
+            target_keys[target] = source_keys[i];
+            target_values[target] = source_values[i];
+        }
+
+        std::swap(source_keys, target_keys);
+        std::swap(source_values, target_values);
+    }
+
+    // An odd number of passes left the sorted result in the scratch spans
+    if (source_keys != keys.data()) {
+        std::copy(source_keys, source_keys + count, keys.data());
+        std::copy(source_values, source_values + count, values.data());
+    }
+}
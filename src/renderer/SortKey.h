@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "Pipeline.h"
+
+
+// 64 bit keys that order the draws of a frame. From the most to the least significant bits:
+//   [63]     pass      - all opaque draws come before the blended ones, see RenderPass
+//   [62..55] layer     - blended draws of a lower layer are drawn first, opaque draws of a higher one
+//   [54..39] depth     - within a layer, blended draws go farther first and opaque draws nearer first
+//   [38..16] batch     - a pipeline maps to one RenderBatch, so draws of equal pipelines form one run whatever their shape
+//   [15..0]  texture   - texture switches inside a run only cost a texture slot, so they matter least
+// Opaque draws run front to back so the depth test rejects what they hide, blended draws back to front so they cover
+// what is behind them. Draws with equal keys keep their submission order.
+namespace SortKey {
+    // depth is clamped to [0, 1], 0 being the closest to the camera
+    [[nodiscard]] uint64_t make(RenderPass pass, uint8_t layer, float depth, uint32_t batch, uint32_t texture);
+
+    [[nodiscard]] RenderPass pass(uint64_t key);
+
+    [[nodiscard]] uint8_t layer(uint64_t key);
+
+    // Clip space z of a draw, in (-1, 1). Higher layers and nearer depths get smaller values, every step of the key's
+    // depth resolution is a distinct value of a 24 bit depth buffer. 1 is left for what lies behind every draw.
+    [[nodiscard]] float clip_depth(uint8_t layer, float depth);
+
+    // Stable LSD radix sort of keys together with their payload. The scratch spans need at least keys.size() elements.
+    // Passes over bytes that are equal for every key are skipped.
+    void radix_sort(std::span<uint64_t> keys, std::span<uint32_t> values, std::span<uint64_t> scratch_keys, std::span<uint32_t> scratch_values);
+}
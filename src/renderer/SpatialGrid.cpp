@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <glm/common.hpp>
+#include "SpatialGrid.h"
+
+
+void SpatialGrid::init(glm::vec2 world_min_, glm::vec2 world_max_, float cell_size_) {
+    assert(cell_size_ > 0.0F && world_max_.x > world_min_.x && world_max_.y > world_min_.y);
+
+    this->world_min = world_min_;
+    this->cell_size = cell_size_;
+
+    columns = std::max((int) std::ceil((world_max_.x - world_min_.x) / cell_size), 1);
+    rows = std::max((int) std::ceil((world_max_.y - world_min_.y) / cell_size), 1);
+
+    cells.clear();
+    cells.resize((size_t) columns * rows);
+    objects.clear();
+    free_ids.clear();
+    query_stamp = 0;
+    stats = {};
+}
+
+SpatialGrid::ObjectId SpatialGrid::insert(glm::vec2 min, glm::vec2 max) {
+    ObjectId id;
+
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+    } else {
+        id = (ObjectId) objects.size();
+        objects.emplace_back();
+    }
+
+    const CellRange range = cells_of(min, max);
+    objects[id] = Object{min, max, range, 0, true};
+    link(id, range);
+
+    return id;
+}
+
+void SpatialGrid::move(SpatialGrid::ObjectId id, glm::vec2 min, glm::vec2 max) {
+    assert(id < objects.size() && objects[id].alive);
+
+    Object& object = objects[id];
+    object.min = min;
+    object.max = max;
+
+    const CellRange range = cells_of(min, max);
+
+    if (range == object.cell_range) {
+        return;
+    }
+
+    unlink(id, object.cell_range);
+    link(id, range);
+    object.cell_range = range;
+}
+
+void SpatialGrid::remove(SpatialGrid::ObjectId id) {
+    assert(id < objects.size() && objects[id].alive);
+
+    unlink(id, objects[id].cell_range);
+    objects[id].alive = false;
+    free_ids.push_back(id);
+}
+
+void SpatialGrid::query(glm::vec2 min, glm::vec2 max, std::vector<ObjectId>& results) {
+    stats = {};
+
+    // Stamps start over once the counter wraps, the old ones could match again
+    if (++query_stamp == 0) {
+        for (Object& object: objects) {
+            object.stamp = 0;
+        }
+
+        query_stamp = 1;
+    }
+
+    const CellRange range = cells_of(min, max);
+
+    for (int y = range.first_y; y <= range.last_y; ++y) {
+        for (int x = range.first_x; x <= range.last_x; ++x) {
+            ++stats.cells_visited;
+
+            for (ObjectId id: cells[(size_t) y * columns + x]) {
+                Object& object = objects[id];
+
+                if (object.stamp == query_stamp) {
+                    continue;
+                }
+
+                object.stamp = query_stamp;
+                ++stats.candidates;
+
+                // Edge cells also hold objects clamped into them from outside of the world
+                if (object.max.x < min.x || object.min.x > max.x || object.max.y < min.y || object.min.y > max.y) {
+                    continue;
+                }
+
+                results.push_back(id);
+                ++stats.results;
+            }
+        }
+    }
+}
+
+SpatialGrid::CellRange SpatialGrid::cells_of(glm::vec2 min, glm::vec2 max) const {
+    const glm::vec2 first = glm::floor((min - world_min) / cell_size);
+    const glm::vec2 last = glm::floor((max - world_min) / cell_size);
+
+    // Clamped as floats first, far away bounds would overflow the int conversion
+    return CellRange{
+            (int) std::clamp(first.x, 0.0F, (float) (columns - 1)),
+            (int) std::clamp(first.y, 0.0F, (float) (rows - 1)),
+            (int) std::clamp(last.x, 0.0F, (float) (columns - 1)),
+            (int) std::clamp(last.y, 0.0F, (float) (rows - 1))
+    };
+}
+
+void SpatialGrid::link(SpatialGrid::ObjectId id, const SpatialGrid::CellRange& range) {
+    for (int y = range.first_y; y <= range.last_y; ++y) {
+        for (int x = range.first_x; x <= range.last_x; ++x) {
+            cells[(size_t) y * columns + x].push_back(id);
+        }
+    }
+}
+
+void SpatialGrid::unlink(SpatialGrid::ObjectId id, const SpatialGrid::CellRange& range) {
+    for (int y = range.first_y; y <= range.last_y; ++y) {
+        for (int x = range.first_x; x <= range.last_x; ++x) {
+            std::vector<ObjectId>& cell = cells[(size_t) y * columns + x];
+
+            // Order within a cell does not matter, swap with the last id
+            auto it = std::find(cell.begin(), cell.end(), id);
+            assert(it != cell.end());
+            *it = cell.back();
+            cell.pop_back();
+        }
+    }
+}
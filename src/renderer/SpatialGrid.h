@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Uniform grid over a world rectangle that finds the objects overlapping a region, e.g. the camera view. An object is
+// listed in every cell its bounds overlap, a query only visits the cells of its region, so its cost follows the size
+// of the region and the objects found, not the size of the world. Bounds outside of the world clamp to the edge cells.
+class SpatialGrid {
+public:
+    using ObjectId = uint32_t;
+
+    // What the last query did, to tell how well the cell size fits the scene
+    struct QueryStats {
+        size_t cells_visited;
+        // Objects listed in the visited cells, counting each one once
+        size_t candidates;
+        size_t results;
+    };
+
+    SpatialGrid() : world_min {}, cell_size { 0.0F }, columns { 0 }, rows { 0 }, cells {}, objects {}, free_ids {},
+                    query_stamp { 0 }, stats {} {
+
+    }
+
+    // Objects should be about as large as a cell or smaller, larger ones are listed in many cells
+    void init(glm::vec2 world_min_, glm::vec2 world_max_, float cell_size_);
+
+    [[nodiscard]] ObjectId insert(glm::vec2 min, glm::vec2 max);
+
+    // Only touches the cells when the object moved into others
+    void move(ObjectId id, glm::vec2 min, glm::vec2 max);
+
+    void remove(ObjectId id);
+
+    // Appends every object overlapping the region to results, each once and in no particular order
+    void query(glm::vec2 min, glm::vec2 max, std::vector<ObjectId>& results);
+
+    [[nodiscard]] size_t object_count() const {
+        return objects.size() - free_ids.size();
+    }
+
+    [[nodiscard]] const QueryStats& last_query_stats() const {
+        return stats;
+    }
+
+private:
+    struct CellRange {
+        int first_x;
+        int first_y;
+        int last_x;
+        int last_y;
+
+        bool operator==(const CellRange&) const = default;
+    };
+
+    struct Object {
+        glm::vec2 min;
+        glm::vec2 max;
+        CellRange cell_range;
+        // Query that last reported the object, so one listed in several cells is reported once
+        uint32_t stamp;
+        bool alive;
+    };
+
+    [[nodiscard]] CellRange cells_of(glm::vec2 min, glm::vec2 max) const;
+
+    void link(ObjectId id, const CellRange& range);
+
+    void unlink(ObjectId id, const CellRange& range);
+
+private:
+    glm::vec2 world_min;
+    float cell_size;
+    int columns;
+    int rows;
+
+    std::vector<std::vector<ObjectId>> cells;
+    std::vector<Object> objects;
+    std::vector<ObjectId> free_ids;
+
+    uint32_t query_stamp;
+    QueryStats stats;
+};
@@ -0,0 +1,120 @@
+#include <cassert>
+#include "StreamBuffer.h"
+
+
+void StreamBuffer::init(GLuint buffer_id, size_t element_size_, size_t segment_capacity_) {
+    this->gl_buffer_id = buffer_id;
+    this->element_size = element_size_;
+    this->segment_capacity = segment_capacity_;
+
+    // The first allocation enters segment 0
+    this->cursor = segment_capacity;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = (GLsizeiptr) (element_size * segment_capacity * STREAM_BUFFER_SEGMENTS);
+
+    glNamedBufferStorage(gl_buffer_id, size, nullptr, flags);
+    mapped = (unsigned char*) glMapNamedBufferRange(gl_buffer_id, 0, size, flags);
+
+    assert(mapped != nullptr);
+}
+
+std::optional<StreamBuffer::Allocation> StreamBuffer::allocate(size_t element_count) {
+    assert(element_count <= segment_capacity);
+
+    if (cursor + element_count > segment_capacity) {
+        // The next segment still holds data of this wave that has not been drawn yet
+        if (wave_segments == STREAM_BUFFER_SEGMENTS) {
+            return std::nullopt;
+        }
+
+        enter_next_segment();
+    }
+
+    return take(element_count);
+}
+
+std::optional<StreamBuffer::Allocation> StreamBuffer::try_allocate(size_t element_count) {
+    assert(element_count <= segment_capacity);
+
+    if (cursor + element_count > segment_capacity) {
+        if (wave_segments == STREAM_BUFFER_SEGMENTS || !segment_ready((segment + 1) % STREAM_BUFFER_SEGMENTS)) {
+            return std::nullopt;
+        }
+
+        enter_next_segment();
+    }
+
+    return take(element_count);
+}
+
+void StreamBuffer::end_wave() {
+    // Every draw reading from these segments has been issued, the fences signal once the GPU is done with them
+    for (size_t i = 0; i < wave_segments; ++i) {
+        size_t wave_segment = (segment + STREAM_BUFFER_SEGMENTS - i) % STREAM_BUFFER_SEGMENTS;
+        fences[wave_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    wave_segments = 0;
+    cursor = segment_capacity;
+}
+
+void StreamBuffer::enter_next_segment() {
+    segment = (segment + 1) % STREAM_BUFFER_SEGMENTS;
+    cursor = 0;
+    ++wave_segments;
+
+    wait_for_segment(segment);
+}
+
+void StreamBuffer::wait_for_segment(size_t segment_index) {
+    GLsync fence = fences[segment_index];
+
+    if (fence == nullptr) {
+        return;
+    }
+
+    // Flush on the first wait so the fence is guaranteed to be submitted, then keep waiting until it signals
+    GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum result = glClientWaitSync(fence, wait_flags, 1000000);
+
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+            break;
+        }
+
+        wait_flags = 0;
+    }
+
+    glDeleteSync(fence);
+    fences[segment_index] = nullptr;
+}
+
+bool StreamBuffer::segment_ready(size_t segment_index) {
+    GLsync fence = fences[segment_index];
+
+    if (fence == nullptr) {
+        return true;
+    }
+
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+    if (result == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+
+    glDeleteSync(fence);
+    fences[segment_index] = nullptr;
+
+    return true;
+}
+
+StreamBuffer::Allocation StreamBuffer::take(size_t element_count) {
+    size_t first_element = segment * segment_capacity + cursor;
+    cursor += element_count;
+
+    return Allocation{
+            mapped + first_element * element_size,
+            first_element
+    };
+}
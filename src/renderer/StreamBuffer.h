@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <cstddef>
+#include <optional>
+
+
+static constexpr const size_t STREAM_BUFFER_SEGMENTS = 3;
+
+// A persistently mapped GPU buffer used as a ring of segments. Memory is handed out in waves: everything allocated in
+// a wave is written, then drawn, then end_wave() fences the segments it touched. A segment is only rewritten after the
+// GPU signalled its fence.
+class StreamBuffer {
+public:
+    struct Allocation {
+        void* data;
+        size_t first_element;
+    };
+
+    StreamBuffer() : gl_buffer_id { 0 }, element_size { 0 }, segment_capacity { 0 }, mapped { nullptr },
+                     segment { STREAM_BUFFER_SEGMENTS - 1 }, cursor { 0 }, wave_segments { 0 }, fences {} {
+
+    }
+
+    // Allocates immutable storage for the buffer which must already be generated and maps it for the lifetime of the buffer
+    void init(GLuint buffer_id, size_t element_size_, size_t segment_capacity_);
+
+    // Returns mapped memory for element_count elements, moving to the next segment if the current one is full.
+    // Fails once every segment holds data of the current wave that has not been drawn yet.
+    [[nodiscard]] std::optional<Allocation> allocate(size_t element_count);
+
+    // Like allocate(), but also fails instead of waiting when the next segment is still in use by the GPU
+    [[nodiscard]] std::optional<Allocation> try_allocate(size_t element_count);
+
+    // Fences the segments of the current wave after all of its draws were issued, the next wave starts on a fresh segment
+    void end_wave();
+
+private:
+    void enter_next_segment();
+
+    void wait_for_segment(size_t segment_index);
+
+    // Whether the GPU is done with the segment, never blocks
+    [[nodiscard]] bool segment_ready(size_t segment_index);
+
+    [[nodiscard]] Allocation take(size_t element_count);
+
+private:
+    GLuint gl_buffer_id;
+    size_t element_size;
+    size_t segment_capacity;
+
+    unsigned char* mapped;
+    size_t segment;
+    size_t cursor;
+    size_t wave_segments;
+
+    std::array<GLsync, STREAM_BUFFER_SEGMENTS> fences;
+};
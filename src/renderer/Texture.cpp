@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <stb_image.h>
 #include "Texture.h"
 
@@ -14,25 +15,40 @@ void Texture::init() {
 }
 
 Texture Texture::load(const char* file_name) {
-    int width, height, channels;
-    unsigned char* data = stbi_load(file_name, &width, &height, &channels, 0);
-    GLuint format = GL_RGB;
-
-    if (channels == 4) {
-        format = GL_RGBA;
-    }
+    Image image = decode(file_name);
 
     GLuint texture_id;
     glGenTextures(1, &texture_id);
     glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get());
     glGenerateMipmap(GL_TEXTURE_2D);
 
     return Texture{
-            texture_id
+            texture_id,
+            image.opaque
+    };
+}
+
+Texture::Image Texture::decode(const char* file_name) {
+    int width = 0, height = 0, channels = 0;
+    unsigned char* pixels = stbi_load(file_name, &width, &height, &channels, 4);
+
+    if (pixels == nullptr) {
+        printf("Failed to decode %s: %s\n", file_name, stbi_failure_reason());
+    }
+
+    return Image{
+            width,
+            height,
+            std::unique_ptr<unsigned char, Image::PixelsDeleter>{pixels},
+            pixels != nullptr && opaque_pixels(pixels, (size_t) width * height)
     };
 }
 
+void Texture::Image::PixelsDeleter::operator()(unsigned char* pixels) const {
+    stbi_image_free(pixels);
+}
+
 Texture Texture::create_empty() {
     unsigned char data[] = {255, 255, 255};
 
@@ -43,6 +59,17 @@ Texture Texture::create_empty() {
     glGenerateMipmap(GL_TEXTURE_2D);
 
     return Texture{
-            texture_id
+            texture_id,
+            true
     };
 }
+
+bool Texture::opaque_pixels(const unsigned char* pixels, size_t pixel_count) {
+    for (size_t i = 0; i < pixel_count; ++i) {
+        if (pixels[i * 4 + 3] != 255) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -2,18 +2,40 @@
 
 
 #include <glad/glad.h>
+#include <cstddef>
+#include <memory>
 
 
 struct Texture {
+    // Pixels decoded from an image file, always 4 channel RGBA
+    struct Image {
+        struct PixelsDeleter {
+            void operator()(unsigned char* pixels) const;
+        };
+
+        int width;
+        int height;
+        std::unique_ptr<unsigned char, PixelsDeleter> pixels;
+        // No pixel is translucent, worked out while decoding so streamed images do not scan on the GL thread
+        bool opaque;
+    };
 
     static void init();
 
     static Texture load(const char* file_name);
 
+    // Decodes an image file without uploading it. Pixels are empty when the file could not be decoded.
+    static Image decode(const char* file_name);
+
     static Texture create_empty();
 
+    // True when every alpha of the RGBA pixels is 255
+    [[nodiscard]] static bool opaque_pixels(const unsigned char* pixels, size_t pixel_count);
+
 public:
     GLuint id;
+    // Draws of an opaque texture may write depth and skip blending, see RenderPass
+    bool opaque = false;
 
     static Texture empty_texture;
 };
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdio>
+#include "TextureAtlas.h"
+
+
+void TextureAtlas::init() {
+    // A layer is 16 MiB, most games never fill more than the first one
+    array_texture.id = create_array_texture(1);
+    allocated_layers = 1;
+
+    layers.resize(ATLAS_MAX_LAYERS);
+}
+
+std::optional<AtlasSprite> TextureAtlas::add(const char* file_name) {
+    Texture::Image image = Texture::decode(file_name);
+
+    if (image.pixels == nullptr) {
+        return std::nullopt;
+    }
+
+    std::optional<AtlasSprite> sprite = add(image.width, image.height, image.pixels.get());
+
+    if (!sprite.has_value()) {
+        printf("Texture atlas is full, cannot add %s\n", file_name);
+    }
+
+    return sprite;
+}
+
+std::optional<AtlasSprite> TextureAtlas::add(int width, int height, const unsigned char* pixels) {
+    const int padded_width = width + ATLAS_SPRITE_PADDING * 2;
+    const int padded_height = height + ATLAS_SPRITE_PADDING * 2;
+
+    std::optional<Placement> placement = pack(padded_width, padded_height);
+
+    if (!placement.has_value()) {
+        return std::nullopt;
+    }
+
+    if (placement->layer >= allocated_layers) {
+        grow(placement->layer + 1);
+    }
+
+    // Extrude the edge pixels into the padding
+    std::vector<unsigned char> padded_pixels((size_t) padded_width * padded_height * 4);
+    for (int y = 0; y < padded_height; ++y) {
+        int source_y = std::clamp(y - ATLAS_SPRITE_PADDING, 0, height - 1);
+
+        for (int x = 0; x < padded_width; ++x) {
+            int source_x = std::clamp(x - ATLAS_SPRITE_PADDING, 0, width - 1);
+
+            const unsigned char* source = pixels + ((size_t) source_y * width + source_x) * 4;
+            std::copy(source, source + 4, padded_pixels.data() + ((size_t) y * padded_width + x) * 4);
+        }
+    }
+
+    glTextureSubImage3D(array_texture.id, 0, placement->x, placement->y, placement->layer, padded_width, padded_height, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, padded_pixels.data());
+
+    const float layer_size = (float) ATLAS_LAYER_SIZE;
+
+    return AtlasSprite{
+            placement->layer,
+            glm::vec4{
+                    (float) (placement->x + ATLAS_SPRITE_PADDING) / layer_size,
+                    (float) (placement->y + ATLAS_SPRITE_PADDING) / layer_size,
+                    (float) width / layer_size,
+                    (float) height / layer_size
+            },
+            Texture::opaque_pixels(pixels, (size_t) width * height)
+    };
+}
+
+Texture TextureAtlas::texture() const {
+    return array_texture;
+}
+
+std::optional<TextureAtlas::Placement> TextureAtlas::pack(int width, int height) {
+    if (width > ATLAS_LAYER_SIZE || height > ATLAS_LAYER_SIZE) {
+        return std::nullopt;
+    }
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        std::optional<Placement> placement = pack_into_layer(layers[i], (int) i, width, height);
+
+        if (placement.has_value()) {
+            return placement;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<TextureAtlas::Placement> TextureAtlas::pack_into_layer(TextureAtlas::Layer& layer, int layer_index, int width, int height) {
+    // Best fit: the shortest existing shelf that is tall enough and still has room
+    Shelf* best_shelf = nullptr;
+    for (Shelf& shelf: layer.shelves) {
+        if (shelf.height >= height && ATLAS_LAYER_SIZE - shelf.cursor_x >= width &&
+            (best_shelf == nullptr || shelf.height < best_shelf->height)) {
+            best_shelf = &shelf;
+        }
+    }
+
+    if (best_shelf == nullptr) {
+        if (ATLAS_LAYER_SIZE - layer.next_shelf_y < height) {
+            return std::nullopt;
+        }
+
+        best_shelf = &layer.shelves.emplace_back(Shelf{layer.next_shelf_y, height, 0});
+        layer.next_shelf_y += height;
+    }
+
+    Placement placement{layer_index, best_shelf->cursor_x, best_shelf->y};
+    best_shelf->cursor_x += width;
+
+    return placement;
+}
+
+void TextureAtlas::grow(int layer_count) {
+    GLuint grown_texture = create_array_texture(layer_count);
+
+    glCopyImageSubData(array_texture.id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                       grown_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                       ATLAS_LAYER_SIZE, ATLAS_LAYER_SIZE, allocated_layers);
+    glDeleteTextures(1, &array_texture.id);
+
+    array_texture.id = grown_texture;
+    allocated_layers = layer_count;
+
+    printf("Texture atlas grown to %d layers\n", allocated_layers);
+}
+
+GLuint TextureAtlas::create_array_texture(int layer_count) {
+    GLuint texture_id = 0;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_id);
+    glTextureStorage3D(texture_id, 1, GL_RGBA8, ATLAS_LAYER_SIZE, ATLAS_LAYER_SIZE, layer_count);
+
+    // No mipmaps, neighbouring sprites would bleed into each other in the smaller levels
+    glTextureParameteri(texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return texture_id;
+}
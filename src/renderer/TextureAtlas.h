@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <optional>
+#include <vector>
+#include "Texture.h"
+
+
+static constexpr const int ATLAS_LAYER_SIZE = 2048;
+static constexpr const int ATLAS_MAX_LAYERS = 8;
+
+// Border around every sprite filled with its edge pixels, so linear filtering never bleeds into a neighbour
+static constexpr const int ATLAS_SPRITE_PADDING = 1;
+
+// Where a sprite lives inside the atlas
+struct AtlasSprite {
+    int layer;
+    // Offset (xy) and size (zw) of the sprite in normalized texture coordinates of its layer
+    glm::vec4 uv_rect;
+    // No pixel of the sprite is translucent
+    bool opaque = false;
+};
+
+// Packs many small sprites into the layers of a single GL_TEXTURE_2D_ARRAY. Drawables that sample from the atlas
+// do not take up one of the MAX_TEXTURES slots of a render buffer, so any number of them fit in one draw.
+class TextureAtlas {
+public:
+    TextureAtlas() : array_texture { 0 }, allocated_layers { 0 }, layers {} {
+
+    }
+
+    // Allocates the storage of the first layer, the others are allocated once the packer opens them
+    void init();
+
+    // Decodes the file and packs it into the first layer with room for it. Empty when it does not fit anywhere.
+    std::optional<AtlasSprite> add(const char* file_name);
+
+    // Packs already decoded RGBA pixels
+    std::optional<AtlasSprite> add(int width, int height, const unsigned char* pixels);
+
+    [[nodiscard]] Texture texture() const;
+
+private:
+    // Sprites are packed left to right into shelves, a new shelf opens below the last one when none has room
+    struct Shelf {
+        int y;
+        int height;
+        int cursor_x;
+    };
+
+    struct Layer {
+        std::vector<Shelf> shelves;
+        int next_shelf_y = 0;
+    };
+
+    struct Placement {
+        int layer;
+        int x;
+        int y;
+    };
+
+    std::optional<Placement> pack(int width, int height);
+
+    static std::optional<Placement> pack_into_layer(Layer& layer, int layer_index, int width, int height);
+
+    // Array textures cannot be resized, the layers are copied into a new array with room for layer_count layers
+    void grow(int layer_count);
+
+    static GLuint create_array_texture(int layer_count);
+
+private:
+    Texture array_texture;
+    // Layers with storage in array_texture
+    int allocated_layers;
+    std::vector<Layer> layers;
+};
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "TextureStreamer.h"
+#include "Profiler.h"
+
+
+TextureStreamer::~TextureStreamer() {
+    shutdown();
+}
+
+void TextureStreamer::init(size_t worker_count, size_t upload_budget_) {
+    this->upload_budget = upload_budget_;
+
+    // Decoding has to run next to the frame, it is never done on the calling thread
+    job_system.init(std::max<size_t>(worker_count, 1));
+
+    glCreateBuffers(1, &gl_upload_buffer_id);
+    upload_buffer.init(gl_upload_buffer_id, 1, upload_budget);
+}
+
+void TextureStreamer::shutdown() {
+    // Jobs still queued are dropped, the one running finishes before its worker is joined
+    job_system.shutdown();
+
+    // Textures still uploading are deleted as well, their slots go with them
+    for (const std::unique_ptr<Slot>& slot: slots) {
+        if (slot->texture.id != 0) {
+            glDeleteTextures(1, &slot->texture.id);
+        }
+    }
+    slots.clear();
+    decoding.clear();
+    uploading.clear();
+
+    if (gl_upload_buffer_id != 0) {
+        glDeleteBuffers(1, &gl_upload_buffer_id);
+        gl_upload_buffer_id = 0;
+    }
+}
+
+TextureHandle TextureStreamer::request(const char* file_name) {
+    auto index = (uint32_t) slots.size();
+
+    Slot& slot = *slots.emplace_back(std::make_unique<Slot>());
+    slot.file_name = file_name;
+
+    decoding.push_back(index);
+    job_system.dispatch(JobSystem::Job{decode_job, &slot, 0});
+
+    return TextureHandle{index};
+}
+
+void TextureStreamer::update() {
+    RTC_PROFILE_SCOPE("TextureStreamer::update");
+
+    collect_decoded();
+
+    if (uploading.empty()) {
+        return;
+    }
+
+    size_t budget = upload_budget;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gl_upload_buffer_id);
+
+    while (!uploading.empty() && budget > 0) {
+        Slot& slot = *slots[uploading.front()];
+        budget = upload_rows(slot, budget);
+
+        if (slot.state != State::UPLOADING) {
+            uploading.pop_front();
+        } else {
+            // Not even a row of the next texture fits anymore
+            break;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // The copies out of the buffer were issued, the segments of this frame are fenced
+    upload_buffer.end_wave();
+}
+
+Texture TextureStreamer::resolve(TextureHandle handle) const {
+    const Slot& slot = *slots[handle.index];
+
+    if (slot.state != State::READY) {
+        return Texture::empty_texture;
+    }
+
+    return slot.texture;
+}
+
+bool TextureStreamer::ready(TextureHandle handle) const {
+    return slots[handle.index]->state == State::READY;
+}
+
+size_t TextureStreamer::pending_count() const {
+    return decoding.size() + uploading.size();
+}
+
+void TextureStreamer::decode_job(void* slot, size_t) {
+    auto* decode_slot = static_cast<Slot*>(slot);
+
+    decode_slot->image = Texture::decode(decode_slot->file_name.c_str());
+    decode_slot->decoded.store(true, std::memory_order_release);
+}
+
+void TextureStreamer::collect_decoded() {
+    // Keeps the request order of the slots that are still decoding
+    auto still_decoding = std::stable_partition(decoding.begin(), decoding.end(), [&](uint32_t index) {
+        return !slots[index]->decoded.load(std::memory_order_acquire);
+    });
+
+    for (auto it = still_decoding; it != decoding.end(); ++it) {
+        Slot& slot = *slots[*it];
+
+        const size_t row_bytes = (size_t) slot.image.width * 4;
+
+        if (slot.image.pixels == nullptr || row_bytes > upload_budget) {
+            printf("Failed to stream texture: %s\n", slot.file_name.c_str());
+
+            slot.state = State::FAILED;
+            slot.image = Texture::Image{};
+
+            continue;
+        }
+
+        int levels = 1;
+        while ((std::max(slot.image.width, slot.image.height) >> levels) > 0) {
+            ++levels;
+        }
+
+        GLuint texture_id;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture_id);
+        glTextureStorage2D(texture_id, levels, GL_RGBA8, slot.image.width, slot.image.height);
+        glTextureParameteri(texture_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        slot.texture = Texture{texture_id, slot.image.opaque};
+        slot.state = State::UPLOADING;
+        uploading.push_back(*it);
+    }
+
+    decoding.erase(still_decoding, decoding.end());
+}
+
+size_t TextureStreamer::upload_rows(TextureStreamer::Slot& slot, size_t budget) {
+    const Texture::Image& image = slot.image;
+    const size_t row_bytes = (size_t) image.width * 4;
+
+    const size_t rows = std::min((size_t) (image.height - slot.rows_uploaded), budget / row_bytes);
+    if (rows == 0) {
+        return budget;
+    }
+
+    const size_t bytes = rows * row_bytes;
+
+    // Everything uploaded in a frame fits in one segment, the budget is the segment size. The frame's first upload
+    // enters the next segment of the ring, when the GPU still copies out of it the rows wait for the next frame
+    // instead of stalling the render thread.
+    std::optional<StreamBuffer::Allocation> allocation = upload_buffer.try_allocate(bytes);
+
+    if (!allocation.has_value()) {
+        return 0;
+    }
+
+    memcpy(allocation->data, image.pixels.get() + slot.rows_uploaded * row_bytes, bytes);
+    glTextureSubImage2D(slot.texture.id, 0, 0, slot.rows_uploaded, image.width, (GLsizei) rows, GL_RGBA, GL_UNSIGNED_BYTE,
+                        (const void*) allocation->first_element);
+
+    RTC_PROFILE_COUNT(BYTES_UPLOADED, bytes);
+
+    slot.rows_uploaded += (int) rows;
+
+    if (slot.rows_uploaded == image.height) {
+        glGenerateTextureMipmap(slot.texture.id);
+
+        slot.state = State::READY;
+        slot.image = Texture::Image{};
+    }
+
+    return budget - bytes;
+}
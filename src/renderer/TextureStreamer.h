@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+#include "StreamBuffer.h"
+#include "Texture.h"
+
+
+// Bytes of pixels moved to the GPU per frame unless the streamer is told otherwise
+static constexpr const size_t TEXTURE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+// Refers to a streamed texture, valid for the lifetime of the TextureStreamer that returned it
+struct TextureHandle {
+    uint32_t index;
+};
+
+// Loads textures without blocking the main thread. Files are decoded by worker threads, the pixels then go to the GPU
+// through a persistently mapped pixel unpack buffer, at most upload_budget bytes per frame. Textures larger than the
+// budget are uploaded in row slices over several frames. A handle resolves to Texture::empty_texture until its texture
+// is complete.
+class TextureStreamer {
+public:
+    TextureStreamer() : slots {}, decoding {}, uploading {}, job_system {}, upload_buffer {}, gl_upload_buffer_id { 0 },
+                        upload_budget { 0 } {
+
+    }
+
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Starts the decode threads and creates the upload buffer, needs a current GL context
+    void init(size_t worker_count, size_t upload_budget_ = TEXTURE_UPLOAD_BUDGET);
+
+    // Deletes every streamed texture, the handles returned so far are invalid afterwards
+    void shutdown();
+
+    // Starts loading the file in the background
+    [[nodiscard]] TextureHandle request(const char* file_name);
+
+    // Uploads decoded textures within the frame budget, called once per frame on the GL thread
+    void update();
+
+    // The streamed texture once it is ready, Texture::empty_texture until then or when the file failed to load
+    [[nodiscard]] Texture resolve(TextureHandle handle) const;
+
+    [[nodiscard]] bool ready(TextureHandle handle) const;
+
+    // Requests that are still decoding or uploading
+    [[nodiscard]] size_t pending_count() const;
+
+private:
+    enum class State {
+        DECODING,
+        UPLOADING,
+        READY,
+        FAILED
+    };
+
+    struct Slot {
+        std::string file_name;
+        State state = State::DECODING;
+        // Written by the decode job, owned by the main thread once decoded is set
+        Texture::Image image{};
+        std::atomic<bool> decoded{false};
+        Texture texture{0};
+        int rows_uploaded = 0;
+    };
+
+    static void decode_job(void* slot, size_t);
+
+    // Moves decoded slots to the upload queue and creates their texture storage
+    void collect_decoded();
+
+    // Uploads rows of slot until it is complete or the budget is spent, returns the budget left
+    size_t upload_rows(Slot& slot, size_t budget);
+
+private:
+    // Slots never move, decode jobs hold a pointer to theirs
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<uint32_t> decoding;
+    std::deque<uint32_t> uploading;
+
+    JobSystem job_system;
+
+    StreamBuffer upload_buffer;
+    GLuint gl_upload_buffer_id;
+    size_t upload_budget;
+};
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
+#include "TileMap.h"
+#include "Profiler.h"
+
+
+static constexpr const size_t CHUNK_CELLS = TILE_CHUNK_SIZE * TILE_CHUNK_SIZE;
+
+void TileMap::init(int width_, int height_, float tile_size_, glm::vec2 origin_) {
+    assert(width_ > 0 && height_ > 0 && tile_size_ > 0.0F);
+
+    this->width = width_;
+    this->height = height_;
+    this->tile_size = tile_size_;
+    this->origin = origin_;
+
+    chunks_x = (width + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    chunks_y = (height + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+
+    cells.assign((size_t) width * height, EMPTY_TILE);
+    chunks.clear();
+    chunks.resize((size_t) chunks_x * chunks_y);
+
+    scratch_vertices.resize(CHUNK_CELLS * 4);
+    scratch_cells.reserve(CHUNK_CELLS);
+
+    init_index_buffer();
+    init_vertex_array();
+}
+
+void TileMap::shutdown() {
+    for (Chunk& chunk: chunks) {
+        if (chunk.gl_vbo_id != 0) {
+            glDeleteBuffers(1, &chunk.gl_vbo_id);
+        }
+    }
+
+    chunks.clear();
+
+    glDeleteVertexArrays(1, &gl_vao_id);
+    glDeleteBuffers(1, &gl_ibo_id);
+    gl_vao_id = 0;
+    gl_ibo_id = 0;
+}
+
+TileMap::TileId TileMap::add_tile(const AtlasSprite& sprite, glm::vec4 tint_color) {
+    tiles.push_back(Tile{sprite, glm::packUnorm4x8(tint_color)});
+
+    return (TileId) tiles.size();
+}
+
+void TileMap::set(int x, int y, TileMap::TileId tile) {
+    assert(x >= 0 && x < width && y >= 0 && y < height);
+    assert(tile <= tiles.size());
+
+    TileId& cell = cells[(size_t) y * width + x];
+
+    if (cell == tile) {
+        return;
+    }
+
+    cell = tile;
+
+    Chunk& chunk = chunk_of(x, y);
+
+    if (chunk.fully_dirty) {
+        return;
+    }
+
+    // Past the limit a single upload of the whole chunk is cheaper than many small ones
+    if (chunk.dirty_cells.size() >= TILE_CHUNK_PATCH_LIMIT) {
+        chunk.fully_dirty = true;
+        chunk.dirty_cells.clear();
+
+        return;
+    }
+
+    chunk.dirty_cells.push_back((uint16_t) ((y % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE + x % TILE_CHUNK_SIZE));
+}
+
+TileMap::TileId TileMap::get(int x, int y) const {
+    assert(x >= 0 && x < width && y >= 0 && y < height);
+
+    return cells[(size_t) y * width + x];
+}
+
+bool TileMap::cell_at(glm::vec2 position, int& x, int& y) const {
+    const glm::vec2 cell = glm::floor((position - origin) / tile_size);
+
+    if (cell.x < 0.0F || cell.y < 0.0F || cell.x >= (float) width || cell.y >= (float) height) {
+        return false;
+    }
+
+    x = (int) cell.x;
+    y = (int) cell.y;
+
+    return true;
+}
+
+size_t TileMap::draw(glm::vec2 view_min, glm::vec2 view_max) {
+    RTC_PROFILE_SCOPE("TileMap::draw");
+
+    const float chunk_extent = tile_size * TILE_CHUNK_SIZE;
+    const glm::vec2 first = glm::floor((view_min - origin) / chunk_extent);
+    const glm::vec2 last = glm::floor((view_max - origin) / chunk_extent);
+
+    // The view misses the map entirely
+    if (last.x < 0.0F || last.y < 0.0F || first.x >= (float) chunks_x || first.y >= (float) chunks_y) {
+        return 0;
+    }
+
+    const int first_x = std::max((int) first.x, 0);
+    const int first_y = std::max((int) first.y, 0);
+    const int last_x = std::min((int) last.x, chunks_x - 1);
+    const int last_y = std::min((int) last.y, chunks_y - 1);
+
+    glBindVertexArray(gl_vao_id);
+
+    size_t draw_calls = 0;
+
+    for (int chunk_y = first_y; chunk_y <= last_y; ++chunk_y) {
+        for (int chunk_x = first_x; chunk_x <= last_x; ++chunk_x) {
+            Chunk& chunk = chunks[(size_t) chunk_y * chunks_x + chunk_x];
+
+            if (chunk.fully_dirty || !chunk.dirty_cells.empty()) {
+                upload_chunk(chunk_x, chunk_y, chunk);
+            }
+
+            glVertexArrayVertexBuffer(gl_vao_id, 0, chunk.gl_vbo_id, 0, sizeof(TileVertex));
+            glDrawElements(GL_TRIANGLES, CHUNK_CELLS * 6, GL_UNSIGNED_SHORT, nullptr);
+
+            ++draw_calls;
+        }
+    }
+
+    glBindVertexArray(0);
+
+    RTC_PROFILE_COUNT(DRAW_CALLS, draw_calls);
+    RTC_PROFILE_COUNT(INDICES, draw_calls * CHUNK_CELLS * 6);
+
+    return draw_calls;
+}
+
+void TileMap::upload_chunk(int chunk_x, int chunk_y, TileMap::Chunk& chunk) {
+    const int cell_x = chunk_x * TILE_CHUNK_SIZE;
+    const int cell_y = chunk_y * TILE_CHUNK_SIZE;
+
+    if (chunk.gl_vbo_id == 0) {
+        glCreateBuffers(1, &chunk.gl_vbo_id);
+        glNamedBufferStorage(chunk.gl_vbo_id, CHUNK_CELLS * 4 * sizeof(TileVertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        chunk.fully_dirty = true;
+    }
+
+    if (chunk.fully_dirty) {
+        for (size_t cell = 0; cell < CHUNK_CELLS; ++cell) {
+            build_cell(cell_x + (int) (cell % TILE_CHUNK_SIZE), cell_y + (int) (cell / TILE_CHUNK_SIZE), &scratch_vertices[cell * 4]);
+        }
+
+        glNamedBufferSubData(chunk.gl_vbo_id, 0, CHUNK_CELLS * 4 * sizeof(TileVertex), scratch_vertices.data());
+
+        RTC_PROFILE_COUNT(BYTES_UPLOADED, CHUNK_CELLS * 4 * sizeof(TileVertex));
+        RTC_PROFILE_COUNT(TILE_CELLS_UPLOADED, CHUNK_CELLS);
+    } else {
+        scratch_cells.assign(chunk.dirty_cells.begin(), chunk.dirty_cells.end());
+        std::sort(scratch_cells.begin(), scratch_cells.end());
+        scratch_cells.erase(std::unique(scratch_cells.begin(), scratch_cells.end()), scratch_cells.end());
+
+        // Neighbouring cells are uploaded as one run
+        size_t run_start = 0;
+
+        while (run_start < scratch_cells.size()) {
+            size_t run_end = run_start + 1;
+
+            while (run_end < scratch_cells.size() && scratch_cells[run_end] == scratch_cells[run_end - 1] + 1) {
+                ++run_end;
+            }
+
+            const size_t first_cell = scratch_cells[run_start];
+            const size_t run_cells = run_end - run_start;
+
+            for (size_t cell = first_cell; cell < first_cell + run_cells; ++cell) {
+                build_cell(cell_x + (int) (cell % TILE_CHUNK_SIZE), cell_y + (int) (cell / TILE_CHUNK_SIZE), &scratch_vertices[cell * 4]);
+            }
+
+            glNamedBufferSubData(chunk.gl_vbo_id, (GLintptr) (first_cell * 4 * sizeof(TileVertex)), (GLsizeiptr) (run_cells * 4 * sizeof(TileVertex)),
+                                 &scratch_vertices[first_cell * 4]);
+
+            RTC_PROFILE_COUNT(BYTES_UPLOADED, run_cells * 4 * sizeof(TileVertex));
+            RTC_PROFILE_COUNT(TILE_CELLS_UPLOADED, run_cells);
+
+            run_start = run_end;
+        }
+    }
+
+    chunk.fully_dirty = false;
+    chunk.dirty_cells.clear();
+}
+
+void TileMap::build_cell(int x, int y, TileMap::TileVertex* vertices) const {
+    // Cells past the edge of the map pad its last chunks
+    const TileId tile = x < width && y < height ? cells[(size_t) y * width + x] : EMPTY_TILE;
+
+    if (tile == EMPTY_TILE) {
+        std::fill(vertices, vertices + 4, TileVertex{});
+
+        return;
+    }
+
+    const Tile& tile_type = tiles[tile - 1];
+    const glm::vec4 uv_rect = tile_type.sprite.uv_rect;
+    const glm::vec2 corner = origin + glm::vec2{(float) x, (float) y} * tile_size;
+
+    // Same corner order as the quad shape
+    static constexpr const glm::vec2 CORNERS[] = {{0.0F, 0.0F}, {1.0F, 0.0F}, {0.0F, 1.0F}, {1.0F, 1.0F}};
+
+    for (size_t v = 0; v < 4; ++v) {
+        vertices[v] = TileVertex{
+                corner + CORNERS[v] * tile_size,
+                glm::vec2{uv_rect.x, uv_rect.y} + CORNERS[v] * glm::vec2{uv_rect.z, uv_rect.w},
+                tile_type.tint_color,
+                (float) tile_type.sprite.layer
+        };
+    }
+}
+
+TileMap::Chunk& TileMap::chunk_of(int x, int y) {
+    return chunks[(size_t) (y / TILE_CHUNK_SIZE) * chunks_x + x / TILE_CHUNK_SIZE];
+}
+
+void TileMap::init_vertex_array() {
+    glCreateVertexArrays(1, &gl_vao_id);
+
+    // Locations shared with filled_quad.vert, the fragment stage is the same
+    glEnableVertexArrayAttrib(gl_vao_id, 0);
+    glVertexArrayAttribFormat(gl_vao_id, 0, 2, GL_FLOAT, GL_FALSE, offsetof(TileVertex, position));
+    glVertexArrayAttribBinding(gl_vao_id, 0, 0);
+
+    glEnableVertexArrayAttrib(gl_vao_id, 1);
+    glVertexArrayAttribFormat(gl_vao_id, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(TileVertex, tint_color));
+    glVertexArrayAttribBinding(gl_vao_id, 1, 0);
+
+    glEnableVertexArrayAttrib(gl_vao_id, 2);
+    glVertexArrayAttribFormat(gl_vao_id, 2, 2, GL_FLOAT, GL_FALSE, offsetof(TileVertex, uv));
+    glVertexArrayAttribBinding(gl_vao_id, 2, 0);
+
+    glEnableVertexArrayAttrib(gl_vao_id, 4);
+    glVertexArrayAttribFormat(gl_vao_id, 4, 1, GL_FLOAT, GL_FALSE, offsetof(TileVertex, texture_layer));
+    glVertexArrayAttribBinding(gl_vao_id, 4, 0);
+
+    glVertexArrayElementBuffer(gl_vao_id, gl_ibo_id);
+}
+
+void TileMap::init_index_buffer() {
+    // Every chunk has the same cell layout and shares the indices
+    std::vector<uint16_t> indices;
+    indices.reserve(CHUNK_CELLS * 6);
+
+    for (size_t cell = 0; cell < CHUNK_CELLS; ++cell) {
+        const auto first_vertex = (uint16_t) (cell * 4);
+
+        for (uint16_t index: {0, 1, 3, 0, 3, 2}) {
+            indices.push_back((uint16_t) (first_vertex + index));
+        }
+    }
+
+    glCreateBuffers(1, &gl_ibo_id);
+    glNamedBufferStorage(gl_ibo_id, (GLsizeiptr) (indices.size() * sizeof(uint16_t)), indices.data(), 0);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TextureAtlas.h"
+
+
+// Cells along each side of a chunk, a chunk indexes at most 65536 vertices so its indices fit 16 bits
+static constexpr const int TILE_CHUNK_SIZE = 32;
+
+// Changed cells of a chunk past which the whole chunk is uploaded instead of its changed cell runs
+static constexpr const size_t TILE_CHUNK_PATCH_LIMIT = TILE_CHUNK_SIZE * TILE_CHUNK_SIZE / 8;
+
+// A static grid of atlas sprites, e.g. the city. The grid is split into chunks of TILE_CHUNK_SIZE^2 cells that keep
+// their vertices on the GPU, a chunk is only uploaded again after one of its cells changed and draws in a single call.
+// The cost of a frame follows the number of changed cells and visible chunks, not the number of cells.
+class TileMap {
+public:
+    using TileId = uint16_t;
+
+    // Cells that draw nothing
+    static constexpr const TileId EMPTY_TILE = 0;
+
+    TileMap() : width { 0 }, height { 0 }, chunks_x { 0 }, chunks_y { 0 }, tile_size { 0.0F }, origin {}, tiles {}, cells {},
+                chunks {}, gl_vao_id { 0 }, gl_ibo_id { 0 }, scratch_vertices {}, scratch_cells {} {
+
+    }
+
+    // Creates the shared index buffer and vertex array, needs a current GL context. Every cell starts out empty.
+    void init(int width_, int height_, float tile_size_, glm::vec2 origin_ = {0.0F, 0.0F});
+
+    void shutdown();
+
+    // Registers a tile type drawn with the sprite of the TextureAtlas bound by the Renderer
+    [[nodiscard]] TileId add_tile(const AtlasSprite& sprite, glm::vec4 tint_color = {1.0F, 1.0F, 1.0F, 1.0F});
+
+    // Marks the chunk of the cell for upload when the tile changes
+    void set(int x, int y, TileId tile);
+
+    [[nodiscard]] TileId get(int x, int y) const;
+
+    // The cell under a world position, false outside of the map
+    [[nodiscard]] bool cell_at(glm::vec2 position, int& x, int& y) const;
+
+    [[nodiscard]] int columns() const {
+        return width;
+    }
+
+    [[nodiscard]] int rows() const {
+        return height;
+    }
+
+    // Uploads the changed chunks overlapping the view rectangle (world units) and draws them, the tile program has to
+    // be bound. Chunks outside of the view keep their changes until they are visible. Returns the draw calls issued.
+    size_t draw(glm::vec2 view_min, glm::vec2 view_max);
+
+private:
+    // Vertex of a tile quad as it lives in the chunk buffers, matches the inputs of tile.vert
+    struct TileVertex {
+        glm::vec2 position;
+        glm::vec2 uv;
+        // RGBA8, normalized by the vertex format
+        uint32_t tint_color;
+        float texture_layer;
+    };
+
+    struct Tile {
+        AtlasSprite sprite;
+        uint32_t tint_color;
+    };
+
+    struct Chunk {
+        // Created the first time the chunk is visible
+        GLuint gl_vbo_id = 0;
+        // Uploaded whole on its next draw
+        bool fully_dirty = true;
+        // Chunk local indices of changed cells, only tracked while the chunk is not fully dirty
+        std::vector<uint16_t> dirty_cells;
+    };
+
+    void init_vertex_array();
+
+    void init_index_buffer();
+
+    void upload_chunk(int chunk_x, int chunk_y, Chunk& chunk);
+
+    // Writes the four vertices of a cell, degenerate when the cell is empty
+    void build_cell(int x, int y, TileVertex* vertices) const;
+
+    [[nodiscard]] Chunk& chunk_of(int x, int y);
+
+private:
+    int width;
+    int height;
+    int chunks_x;
+    int chunks_y;
+    float tile_size;
+    glm::vec2 origin;
+
+    // Indexed by TileId - 1
+    std::vector<Tile> tiles;
+    std::vector<TileId> cells;
+    std::vector<Chunk> chunks;
+
+    GLuint gl_vao_id;
+    GLuint gl_ibo_id;
+
+    // Reused by the uploads
+    std::vector<TileVertex> scratch_vertices;
+    std::vector<uint16_t> scratch_cells;
+};
+
+static_assert(4 * TILE_CHUNK_SIZE * TILE_CHUNK_SIZE <= 65536, "Chunk vertices must be addressable by 16 bit indices");
@@ -0,0 +1,194 @@
+#include "TransformKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RTC_TRANSFORM_KERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(RTC_TRANSFORM_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define RTC_TARGET_SSE2 __attribute__((target("sse2")))
+#define RTC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RTC_TARGET_SSE2
+#define RTC_TARGET_AVX2
+#endif
+
+
+// Every kernel has to evaluate the transform in exactly this order to stay bit identical with the scalar one:
+//   x = (position.x + local.x * cos) - local.y * sin
+//   y = (position.y + local.x * sin) + local.y * cos
+static inline void transform_range(const TransformKernel::TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices,
+                                   size_t first, float* out_x, float* out_y) {
+    for (size_t v = 0; v < shape_vertices.size(); ++v) {
+        const Shape::Vertex& vertex = shape_vertices[v];
+        float* vertex_out_x = out_x + v * transforms.count;
+        float* vertex_out_y = out_y + v * transforms.count;
+
+        for (size_t d = first; d < transforms.count; ++d) {
+            const float local_x = vertex.points.x * transforms.scale_x[d];
+            const float local_y = vertex.points.y * transforms.scale_y[d];
+
+            vertex_out_x[d] = transforms.position_x[d] + local_x * transforms.rotation_cos[d] - local_y * transforms.rotation_sin[d];
+            vertex_out_y[d] = transforms.position_y[d] + local_x * transforms.rotation_sin[d] + local_y * transforms.rotation_cos[d];
+        }
+    }
+}
+
+void TransformKernel::transform_scalar(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y) {
+    transform_range(transforms, shape_vertices, 0, out_x, out_y);
+}
+
+#ifdef RTC_TRANSFORM_KERNEL_X86
+
+RTC_TARGET_SSE2
+void TransformKernel::transform_sse2(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y) {
+    const size_t vector_count = transforms.count - transforms.count % 4;
+
+    for (size_t v = 0; v < shape_vertices.size(); ++v) {
+        const __m128 point_x = _mm_set1_ps(shape_vertices[v].points.x);
+        const __m128 point_y = _mm_set1_ps(shape_vertices[v].points.y);
+        float* vertex_out_x = out_x + v * transforms.count;
+        float* vertex_out_y = out_y + v * transforms.count;
+
+        for (size_t d = 0; d < vector_count; d += 4) {
+            const __m128 rotation_cos = _mm_loadu_ps(transforms.rotation_cos + d);
+            const __m128 rotation_sin = _mm_loadu_ps(transforms.rotation_sin + d);
+            const __m128 local_x = _mm_mul_ps(point_x, _mm_loadu_ps(transforms.scale_x + d));
+            const __m128 local_y = _mm_mul_ps(point_y, _mm_loadu_ps(transforms.scale_y + d));
+
+            __m128 x = _mm_add_ps(_mm_loadu_ps(transforms.position_x + d), _mm_mul_ps(local_x, rotation_cos));
+            x = _mm_sub_ps(x, _mm_mul_ps(local_y, rotation_sin));
+            __m128 y = _mm_add_ps(_mm_loadu_ps(transforms.position_y + d), _mm_mul_ps(local_x, rotation_sin));
+            y = _mm_add_ps(y, _mm_mul_ps(local_y, rotation_cos));
+
+            _mm_storeu_ps(vertex_out_x + d, x);
+            _mm_storeu_ps(vertex_out_y + d, y);
+        }
+    }
+
+    transform_range(transforms, shape_vertices, vector_count, out_x, out_y);
+}
+
+RTC_TARGET_AVX2
+void TransformKernel::transform_avx2(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y) {
+    const size_t vector_count = transforms.count - transforms.count % 8;
+
+    for (size_t v = 0; v < shape_vertices.size(); ++v) {
+        const __m256 point_x = _mm256_set1_ps(shape_vertices[v].points.x);
+        const __m256 point_y = _mm256_set1_ps(shape_vertices[v].points.y);
+        float* vertex_out_x = out_x + v * transforms.count;
+        float* vertex_out_y = out_y + v * transforms.count;
+
+        for (size_t d = 0; d < vector_count; d += 8) {
+            const __m256 rotation_cos = _mm256_loadu_ps(transforms.rotation_cos + d);
+            const __m256 rotation_sin = _mm256_loadu_ps(transforms.rotation_sin + d);
+            const __m256 local_x = _mm256_mul_ps(point_x, _mm256_loadu_ps(transforms.scale_x + d));
+            const __m256 local_y = _mm256_mul_ps(point_y, _mm256_loadu_ps(transforms.scale_y + d));
+
+            __m256 x = _mm256_add_ps(_mm256_loadu_ps(transforms.position_x + d), _mm256_mul_ps(local_x, rotation_cos));
+            x = _mm256_sub_ps(x, _mm256_mul_ps(local_y, rotation_sin));
+            __m256 y = _mm256_add_ps(_mm256_loadu_ps(transforms.position_y + d), _mm256_mul_ps(local_x, rotation_sin));
+            y = _mm256_add_ps(y, _mm256_mul_ps(local_y, rotation_cos));
+
+            _mm256_storeu_ps(vertex_out_x + d, x);
+            _mm256_storeu_ps(vertex_out_y + d, y);
+        }
+    }
+
+    transform_range(transforms, shape_vertices, vector_count, out_x, out_y);
+}
+
+static bool cpu_supports_avx2() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0);
+    if (registers[0] < 7) {
+        return false;
+    }
+
+    // The OS has to save the ymm registers (OSXSAVE + AVX) before AVX2 can be used
+    __cpuid(registers, 1);
+    bool os_saves_ymm = (registers[2] & (1 << 27)) != 0 && (registers[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(registers, 7, 0);
+    return os_saves_ymm && (registers[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+static bool cpu_supports_sse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true; // Part of the x86-64 baseline
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("sse2");
+#else
+    int registers[4];
+    __cpuid(registers, 1);
+    return (registers[3] & (1 << 26)) != 0;
+#endif
+}
+
+#else
+
+void TransformKernel::transform_sse2(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y) {
+    transform_scalar(transforms, shape_vertices, out_x, out_y);
+}
+
+void TransformKernel::transform_avx2(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y) {
+    transform_scalar(transforms, shape_vertices, out_x, out_y);
+}
+
+static bool cpu_supports_avx2() {
+    return false;
+}
+
+static bool cpu_supports_sse2() {
+    return false;
+}
+
+#endif
+
+struct SelectedKernel {
+    TransformKernel::Function function;
+    const char* name;
+};
+
+static SelectedKernel select_kernel() {
+    if (cpu_supports_avx2()) {
+        return SelectedKernel{TransformKernel::transform_avx2, "AVX2"};
+    }
+
+    if (cpu_supports_sse2()) {
+        return SelectedKernel{TransformKernel::transform_sse2, "SSE2"};
+    }
+
+    return SelectedKernel{TransformKernel::transform_scalar, "Scalar"};
+}
+
+static const SelectedKernel& selected_kernel() {
+    static const SelectedKernel kernel = select_kernel();
+
+    return kernel;
+}
+
+void TransformKernel::transform(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y) {
+    selected_kernel().function(transforms, shape_vertices, out_x, out_y);
+}
+
+const char* TransformKernel::active_name() {
+    return selected_kernel().name;
+}
+
+bool TransformKernel::supports_sse2() {
+    return cpu_supports_sse2();
+}
+
+bool TransformKernel::supports_avx2() {
+    return cpu_supports_avx2();
+}
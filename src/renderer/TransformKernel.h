@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include "Shape.h"
+
+
+// Transforms the shape vertices of many drawables at once. The implementation is picked at runtime from the
+// best instruction set the CPU supports, with a scalar fallback that produces the same results.
+namespace TransformKernel {
+    // Structure of arrays view over the transforms of a render buffer, every stream holds count elements
+    struct TransformStreams {
+        const float* position_x;
+        const float* position_y;
+        const float* scale_x;
+        const float* scale_y;
+        const float* rotation_cos;
+        const float* rotation_sin;
+        size_t count;
+    };
+
+    // Writes the transformed position of every shape vertex of every drawable into out_x/out_y. The output is
+    // vertex major: the position of shape vertex v for drawable d lands at [v * transforms.count + d].
+    using Function = void (*)(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y);
+
+    void transform_scalar(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y);
+
+    void transform_sse2(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y);
+
+    void transform_avx2(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y);
+
+    // Runs the kernel selected for this CPU
+    void transform(const TransformStreams& transforms, std::span<const Shape::Vertex> shape_vertices, float* out_x, float* out_y);
+
+    [[nodiscard]] const char* active_name();
+
+    // Whether this CPU can run the vector kernels
+    [[nodiscard]] bool supports_sse2();
+
+    [[nodiscard]] bool supports_avx2();
+}
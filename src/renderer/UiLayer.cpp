@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <glm/packing.hpp>
+#include "UiLayer.h"
+#include "Primitive.h"
+#include "Profiler.h"
+
+
+// Writes a quad in the corner order of the quad shape, uvs run over uv_rect like RenderBatch maps them. The texture
+// slot is the index into the layer's fonts, -1 for none. UI layers draw without the depth test, so z stays 0.
+static void write_quad(Shape::BatchVertex* quad_vertices, glm::vec2 position, glm::vec2 size, glm::vec4 color, glm::vec4 uv_rect, int texture_slot,
+                       glm::vec4 shape_params) {
+    static constexpr const glm::vec2 CORNERS[] = {{0.0F, 0.0F}, {1.0F, 0.0F}, {0.0F, 1.0F}, {1.0F, 1.0F}};
+
+    const uint32_t tint_color = glm::packUnorm4x8(color);
+    const Shape::Material material = Shape::make_material(texture_slot, -1.0F, shape_params);
+    const uint32_t primitive_params = Shape::pack_primitive_params(shape_params);
+
+    for (size_t v = 0; v < 4; ++v) {
+        quad_vertices[v] = Shape::BatchVertex{
+                glm::vec3{position + CORNERS[v] * size, 0.0F},
+                tint_color,
+                glm::packUnorm2x16(glm::vec2{uv_rect.x, uv_rect.y} + CORNERS[v] * glm::vec2{uv_rect.z, uv_rect.w}),
+                material,
+                primitive_params
+        };
+    }
+}
+
+void UiLayer::init(size_t max_quads_) {
+    assert(max_quads_ <= UI_MAX_QUADS);
+
+    this->max_quads = max_quads_;
+    used_quads = 0;
+
+    widgets.clear();
+    dirty_widgets.clear();
+    incomplete_widgets.clear();
+    fonts.clear();
+    vertices.assign(max_quads * 4, Shape::BatchVertex{});
+    stats = {};
+
+    glCreateBuffers(1, &gl_vbo_id);
+    glNamedBufferStorage(gl_vbo_id, (GLsizeiptr) (max_quads * 4 * sizeof(Shape::BatchVertex)), vertices.data(), GL_DYNAMIC_STORAGE_BIT);
+
+    init_index_buffer();
+    init_vertex_array();
+}
+
+void UiLayer::shutdown() {
+    glDeleteVertexArrays(1, &gl_vao_id);
+    glDeleteBuffers(1, &gl_vbo_id);
+    glDeleteBuffers(1, &gl_ibo_id);
+    gl_vao_id = 0;
+    gl_vbo_id = 0;
+    gl_ibo_id = 0;
+
+    widgets.clear();
+    dirty_widgets.clear();
+    incomplete_widgets.clear();
+    fonts.clear();
+    vertices.clear();
+}
+
+UiLayer::WidgetId UiLayer::add_panel(glm::vec2 position, glm::vec2 size, glm::vec4 color, float corner_radius) {
+    return add_widget(Widget{WidgetKind::PANEL, position, size, color, corner_radius, 1.0F, 0, {}, 0, 1, true, false});
+}
+
+UiLayer::WidgetId UiLayer::add_label(Font* font, glm::vec2 position, size_t max_glyphs, glm::vec4 color, float scale) {
+    auto slot = std::find_if(fonts.begin(), fonts.end(), [font](const FontSlot& font_slot) {
+        return font_slot.font == font;
+    });
+
+    if (slot == fonts.end()) {
+        assert(fonts.size() < MAX_TEXTURES);
+
+        slot = fonts.insert(fonts.end(), FontSlot{font, font->font_stats().glyphs_evicted});
+    }
+
+    Widget label{WidgetKind::LABEL, position, glm::vec2{0.0F, 0.0F}, color, 0.0F, scale, (size_t) (slot - fonts.begin()), {}, 0, max_glyphs, true, false};
+    // Room for a text of max_glyphs ASCII characters, changing it does not allocate
+    label.text.reserve(max_glyphs);
+
+    return add_widget(std::move(label));
+}
+
+void UiLayer::set_text(UiLayer::WidgetId id, std::string_view text) {
+    Widget& widget = widgets[id];
+    assert(widget.kind == WidgetKind::LABEL);
+
+    if (widget.text == text) {
+        return;
+    }
+
+    widget.text.assign(text);
+    mark_dirty(id);
+}
+
+void UiLayer::set_position(UiLayer::WidgetId id, glm::vec2 position) {
+    if (widgets[id].position != position) {
+        widgets[id].position = position;
+        mark_dirty(id);
+    }
+}
+
+void UiLayer::set_size(UiLayer::WidgetId id, glm::vec2 size) {
+    assert(widgets[id].kind == WidgetKind::PANEL);
+
+    if (widgets[id].size != size) {
+        widgets[id].size = size;
+        mark_dirty(id);
+    }
+}
+
+void UiLayer::set_color(UiLayer::WidgetId id, glm::vec4 color) {
+    if (widgets[id].color != color) {
+        widgets[id].color = color;
+        mark_dirty(id);
+    }
+}
+
+void UiLayer::set_visible(UiLayer::WidgetId id, bool visible) {
+    if (widgets[id].visible != visible) {
+        widgets[id].visible = visible;
+        mark_dirty(id);
+    }
+}
+
+void UiLayer::update() {
+    stats.widgets = widgets.size();
+    stats.widgets_rebuilt = 0;
+    stats.quads_uploaded = 0;
+
+    RTC_PROFILE_SCOPE("UiLayer::update");
+
+    // Rebuilt labels may evict glyphs of clean ones and those are rebuilt in turn. Glyphs drawn this frame are never
+    // evicted, so every label rebuilt here keeps its glyphs and the loop settles after a pass or two.
+    size_t built = 0;
+
+    do {
+        for (; built < dirty_widgets.size(); ++built) {
+            build(dirty_widgets[built]);
+        }
+
+        revalidate_fonts();
+    } while (built < dirty_widgets.size());
+
+    if (dirty_widgets.empty()) {
+        return;
+    }
+
+    std::sort(dirty_widgets.begin(), dirty_widgets.end());
+    dirty_widgets.erase(std::unique(dirty_widgets.begin(), dirty_widgets.end()), dirty_widgets.end());
+
+    // Widgets own consecutive quad ranges in the order they were added, neighbouring dirty widgets upload as one run
+    size_t run_start = 0;
+
+    while (run_start < dirty_widgets.size()) {
+        size_t run_end = run_start + 1;
+
+        while (run_end < dirty_widgets.size() && dirty_widgets[run_end] == dirty_widgets[run_end - 1] + 1) {
+            ++run_end;
+        }
+
+        const Widget& first = widgets[dirty_widgets[run_start]];
+        const Widget& last = widgets[dirty_widgets[run_end - 1]];
+        const size_t run_quads = last.first_quad + last.quad_capacity - first.first_quad;
+
+        glNamedBufferSubData(gl_vbo_id, (GLintptr) (first.first_quad * 4 * sizeof(Shape::BatchVertex)), (GLsizeiptr) (run_quads * 4 * sizeof(Shape::BatchVertex)),
+                             &vertices[first.first_quad * 4]);
+
+        stats.quads_uploaded += run_quads;
+        RTC_PROFILE_COUNT(BYTES_UPLOADED, run_quads * 4 * sizeof(Shape::BatchVertex));
+
+        run_start = run_end;
+    }
+
+    stats.widgets_rebuilt = dirty_widgets.size();
+    RTC_PROFILE_COUNT(UI_WIDGETS_REBUILT, dirty_widgets.size());
+
+    dirty_widgets.clear();
+
+    for (WidgetId id: incomplete_widgets) {
+        mark_dirty(id);
+    }
+
+    incomplete_widgets.clear();
+}
+
+size_t UiLayer::draw() const {
+    if (used_quads == 0) {
+        return 0;
+    }
+
+    // Panels sample the white texture in slot 0, the labels their font atlas
+    glBindTextureUnit(0, Texture::empty_texture.id);
+
+    for (size_t slot = 0; slot < fonts.size(); ++slot) {
+        glBindTextureUnit(slot + 1, fonts[slot].font->texture().id);
+    }
+
+    glBindVertexArray(gl_vao_id);
+    glDrawElements(GL_TRIANGLES, (GLsizei) (used_quads * 6), GL_UNSIGNED_SHORT, nullptr);
+    glBindVertexArray(0);
+
+    RTC_PROFILE_COUNT(TEXTURE_BINDS, fonts.size() + 1);
+    RTC_PROFILE_COUNT(DRAW_CALLS, 1);
+    RTC_PROFILE_COUNT(INDICES, used_quads * 6);
+
+    return 1;
+}
+
+UiLayer::WidgetId UiLayer::add_widget(UiLayer::Widget widget) {
+    assert(used_quads + widget.quad_capacity <= max_quads);
+
+    widget.first_quad = used_quads;
+    used_quads += widget.quad_capacity;
+
+    const auto id = (WidgetId) widgets.size();
+    widgets.push_back(std::move(widget));
+    mark_dirty(id);
+
+    return id;
+}
+
+void UiLayer::mark_dirty(UiLayer::WidgetId id) {
+    Widget& widget = widgets[id];
+
+    if (!widget.dirty) {
+        widget.dirty = true;
+        dirty_widgets.push_back(id);
+    }
+}
+
+void UiLayer::revalidate_fonts() {
+    for (size_t slot = 0; slot < fonts.size(); ++slot) {
+        FontSlot& font_slot = fonts[slot];
+        const size_t glyphs_evicted = font_slot.font->font_stats().glyphs_evicted;
+
+        if (font_slot.glyphs_evicted == glyphs_evicted) {
+            continue;
+        }
+
+        font_slot.glyphs_evicted = glyphs_evicted;
+
+        // Only on frames with evictions, clean labels are checked glyph by glyph
+        for (WidgetId id = 0; id < widgets.size(); ++id) {
+            Widget& widget = widgets[id];
+
+            if (widget.kind != WidgetKind::LABEL || widget.font_slot != slot || widget.dirty || !widget.visible) {
+                continue;
+            }
+
+            const Font::Layout& text_layout = font_slot.font->layout(widget.text);
+            const size_t glyph_count = std::min(text_layout.glyphs.size(), widget.quad_capacity);
+
+            for (size_t g = 0; g < glyph_count; ++g) {
+                if (!font_slot.font->resident(text_layout.glyphs[g])) {
+                    mark_dirty(id);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void UiLayer::build(UiLayer::WidgetId id) {
+    Widget& widget = widgets[id];
+    Shape::BatchVertex* quad_vertices = &vertices[widget.first_quad * 4];
+    size_t quads = 0;
+
+    if (widget.visible && widget.kind == WidgetKind::PANEL) {
+        quads = build_panel(widget, quad_vertices);
+    } else if (widget.visible) {
+        quads = build_label(widget, quad_vertices);
+
+        // The atlas was full of glyphs of this frame, the next frame may have room again
+        const size_t glyph_count = std::min(fonts[widget.font_slot].font->layout(widget.text).glyphs.size(), widget.quad_capacity);
+
+        if (quads < glyph_count && std::find(incomplete_widgets.begin(), incomplete_widgets.end(), id) == incomplete_widgets.end()) {
+            incomplete_widgets.push_back(id);
+        }
+    }
+
+    // Quads the widget does not use this time draw nothing
+    std::fill(quad_vertices + quads * 4, quad_vertices + widget.quad_capacity * 4, Shape::BatchVertex{});
+
+    widget.dirty = false;
+}
+
+size_t UiLayer::build_panel(const UiLayer::Widget& widget, Shape::BatchVertex* quad_vertices) const {
+    const glm::vec4 shape_params = widget.corner_radius > 0.0F ? Primitive{PrimitiveKind::ROUNDED_RECT, widget.corner_radius}.shape_params(widget.size)
+                                                               : NO_PRIMITIVE;
+
+    write_quad(quad_vertices, widget.position, widget.size, widget.color, glm::vec4{0.0F, 0.0F, 1.0F, 1.0F}, -1, shape_params);
+
+    return 1;
+}
+
+size_t UiLayer::build_label(const UiLayer::Widget& widget, Shape::BatchVertex* quad_vertices) const {
+    Font* font = fonts[widget.font_slot].font;
+    Font::Layout& text_layout = font->layout(widget.text);
+
+    const size_t glyph_count = std::min(text_layout.glyphs.size(), widget.quad_capacity);
+    const auto texture_slot = (int) widget.font_slot;
+    size_t quads = 0;
+
+    for (size_t g = 0; g < glyph_count; ++g) {
+        Font::LayoutGlyph& glyph = text_layout.glyphs[g];
+        std::optional<glm::vec4> uv_rect = font->glyph_uv_rect(glyph);
+
+        if (!uv_rect.has_value()) {
+            continue;
+        }
+
+        write_quad(&quad_vertices[quads * 4], widget.position + glyph.offset * widget.scale, glyph.size * widget.scale, widget.color, *uv_rect,
+                   texture_slot, NO_PRIMITIVE);
+        ++quads;
+    }
+
+    return quads;
+}
+
+void UiLayer::init_vertex_array() {
+    glCreateVertexArrays(1, &gl_vao_id);
+
+    // Same inputs as filled_quad.vert
+    set_vertex_format<Shape::BatchVertex>(gl_vao_id, 0, gl_vbo_id);
+    glVertexArrayElementBuffer(gl_vao_id, gl_ibo_id);
+}
+
+void UiLayer::init_index_buffer() {
+    // Every widget is made of quads, they all share the same index pattern
+    std::vector<uint16_t> indices;
+    indices.reserve(max_quads * 6);
+
+    for (size_t quad = 0; quad < max_quads; ++quad) {
+        const auto first_vertex = (uint16_t) (quad * 4);
+
+        for (uint16_t index: {0, 1, 3, 0, 3, 2}) {
+            indices.push_back((uint16_t) (first_vertex + index));
+        }
+    }
+
+    glCreateBuffers(1, &gl_ibo_id);
+    glNamedBufferStorage(gl_ibo_id, (GLsizeiptr) (indices.size() * sizeof(uint16_t)), indices.data(), 0);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Shape.h"
+#include "Font.h"
+
+
+// Quads all widgets of a layer share, their vertices are addressable by 16 bit indices
+static constexpr const size_t UI_MAX_QUADS = 16384;
+
+// Retained widgets drawn in screen space over the frame, e.g. the terminal. Every widget owns a fixed range of quads in
+// a vertex buffer that stays on the GPU. Changing a widget marks it dirty, only dirty widgets are laid out and
+// uploaded again and a clean widget costs nothing per frame. The whole layer draws in one call, widgets in the order
+// they were added so later widgets cover earlier ones.
+class UiLayer {
+public:
+    using WidgetId = uint32_t;
+
+    struct Stats {
+        size_t widgets;
+        // Of the last update
+        size_t widgets_rebuilt;
+        size_t quads_uploaded;
+    };
+
+    UiLayer() : widgets {}, dirty_widgets {}, incomplete_widgets {}, fonts {}, vertices {}, max_quads { 0 }, used_quads { 0 }, gl_vao_id { 0 }, gl_vbo_id { 0 },
+                gl_ibo_id { 0 }, stats {} {
+
+    }
+
+    // Creates the buffers for at most max_quads_ quads, needs a current GL context
+    void init(size_t max_quads_ = UI_MAX_QUADS);
+
+    void shutdown();
+
+    // A filled rectangle, with rounded corners when corner_radius is positive. Position and size are in screen pixels.
+    [[nodiscard]] WidgetId add_panel(glm::vec2 position, glm::vec2 size, glm::vec4 color, float corner_radius = 0.0F);
+
+    // Text with the bottom left of its box at position, glyphs past max_glyphs are cut off. At most MAX_TEXTURES fonts.
+    [[nodiscard]] WidgetId add_label(Font* font, glm::vec2 position, size_t max_glyphs, glm::vec4 color = {1.0F, 1.0F, 1.0F, 1.0F},
+                                     float scale = 1.0F);
+
+    // Setting what the widget already shows does not mark it dirty
+    void set_text(WidgetId id, std::string_view text);
+
+    void set_position(WidgetId id, glm::vec2 position);
+
+    void set_size(WidgetId id, glm::vec2 size);
+
+    void set_color(WidgetId id, glm::vec4 color);
+
+    void set_visible(WidgetId id, bool visible);
+
+    // Lays out the dirty widgets and uploads their quads, called by the Renderer before drawing the layer
+    void update();
+
+    // Draws every widget, the program and a screen space FrameData have to be bound. Returns the draw calls issued.
+    size_t draw() const;
+
+    [[nodiscard]] const Stats& last_update_stats() const {
+        return stats;
+    }
+
+    // Fonts of the labels, the Renderer ends their frame like the ones it drew text with
+    [[nodiscard]] size_t font_count() const {
+        return fonts.size();
+    }
+
+    [[nodiscard]] Font* font(size_t index) const {
+        return fonts[index].font;
+    }
+
+private:
+    enum class WidgetKind {
+        PANEL,
+        LABEL
+    };
+
+    struct Widget {
+        WidgetKind kind;
+        glm::vec2 position;
+        // Of a panel, labels are as large as their text
+        glm::vec2 size;
+        glm::vec4 color;
+        float corner_radius;
+        float scale;
+        // Index into fonts of a label
+        size_t font_slot;
+        std::string text;
+
+        // Range of quads owned by the widget, unused quads are degenerate
+        size_t first_quad;
+        size_t quad_capacity;
+
+        bool visible;
+        bool dirty;
+    };
+
+    struct FontSlot {
+        Font* font;
+        // Evictions of the font when its labels were last checked, a glyph of a clean label may have lost its cell since
+        size_t glyphs_evicted;
+    };
+
+    WidgetId add_widget(Widget widget);
+
+    void mark_dirty(WidgetId id);
+
+    // Labels whose font evicted glyphs since the last update may point at cells that hold other glyphs by now
+    void revalidate_fonts();
+
+    // Writes the quads of the widget into the CPU copy of the vertex buffer and clears its dirty flag
+    void build(WidgetId id);
+
+    // Both return the quads written
+    size_t build_panel(const Widget& widget, Shape::BatchVertex* quad_vertices) const;
+
+    size_t build_label(const Widget& widget, Shape::BatchVertex* quad_vertices) const;
+
+    void init_vertex_array();
+
+    void init_index_buffer();
+
+private:
+    std::vector<Widget> widgets;
+    std::vector<WidgetId> dirty_widgets;
+    // Labels that lost glyphs to a full font atlas, rebuilt again by the next update
+    std::vector<WidgetId> incomplete_widgets;
+    std::vector<FontSlot> fonts;
+
+    // CPU copy of the vertex buffer, dirty widgets are rebuilt in place and their ranges uploaded
+    std::vector<Shape::BatchVertex> vertices;
+
+    size_t max_quads;
+    size_t used_quads;
+
+    GLuint gl_vao_id;
+    GLuint gl_vbo_id;
+    GLuint gl_ibo_id;
+
+    Stats stats;
+};
+
+static_assert(4 * UI_MAX_QUADS <= 65536, "UI vertices must be addressable by 16 bit indices");
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/glad.h>
+
+
+// One input of a vertex shader, read from a member of the vertex struct
+struct VertexAttribute {
+    GLuint location;
+    GLint components;
+    GLenum gl_data_type;
+    // Integer types arrive as floats in [0, 1], or [-1, 1] when signed
+    GLboolean normalized;
+    // Arrives as an integer, e.g. a texture slot, instead of being converted to float
+    bool integer;
+    GLuint offset;
+};
+
+// Specialized next to every vertex type with its attributes as a constexpr ATTRIBUTES array, so the layout is fixed
+// at compile time and checked against the struct by offsetof
+template<typename Vertex>
+struct VertexFormat;
+
+// Sets up the attributes of Vertex on the vertex array, read from buffer_id through the binding point. A divisor of
+// one advances the attributes once per instance instead of once per vertex.
+template<typename Vertex>
+void set_vertex_format(GLuint vao_id, GLuint binding, GLuint buffer_id, GLuint divisor = 0) {
+    for (const VertexAttribute& attribute: VertexFormat<Vertex>::ATTRIBUTES) {
+        glEnableVertexArrayAttrib(vao_id, attribute.location);
+
+        if (attribute.integer) {
+            glVertexArrayAttribIFormat(vao_id, attribute.location, attribute.components, attribute.gl_data_type, attribute.offset);
+        } else {
+            glVertexArrayAttribFormat(vao_id, attribute.location, attribute.components, attribute.gl_data_type, attribute.normalized, attribute.offset);
+        }
+
+        glVertexArrayAttribBinding(vao_id, attribute.location, binding);
+    }
+
+    glVertexArrayVertexBuffer(vao_id, binding, buffer_id, 0, sizeof(Vertex));
+    glVertexArrayBindingDivisor(vao_id, binding, divisor);
+}
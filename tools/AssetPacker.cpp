@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <stb_image.h>
+#include "renderer/AssetPackFormat.h"
+
+
+// Writes every texture and shader below an asset directory into a single pack file that AssetPack maps at runtime.
+// Textures are decoded to RGBA8 with their full mip chain so loading them needs no decoding at all.
+//
+//   rtc_pack <asset directory> <output pack>
+
+struct PackedAsset {
+    AssetPackFormat::Entry entry;
+    std::vector<unsigned char> data;
+};
+
+static bool is_shader(const std::filesystem::path& path) {
+    const std::string extension = path.extension().string();
+
+    return extension == ".vert" || extension == ".frag" || extension == ".glsl";
+}
+
+// Box filters level into the next smaller one, odd edges repeat their last texel
+static std::vector<unsigned char> downsample(const unsigned char* level, uint32_t width, uint32_t height) {
+    const uint32_t next_width = std::max<uint32_t>(width / 2, 1);
+    const uint32_t next_height = std::max<uint32_t>(height / 2, 1);
+
+    std::vector<unsigned char> next((size_t) next_width * next_height * 4);
+
+    for (uint32_t y = 0; y < next_height; ++y) {
+        const uint32_t y0 = std::min(y * 2, height - 1);
+        const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+        for (uint32_t x = 0; x < next_width; ++x) {
+            const uint32_t x0 = std::min(x * 2, width - 1);
+            const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+            for (uint32_t c = 0; c < 4; ++c) {
+                const uint32_t sum = level[((size_t) y0 * width + x0) * 4 + c] + level[((size_t) y0 * width + x1) * 4 + c] +
+                                     level[((size_t) y1 * width + x0) * 4 + c] + level[((size_t) y1 * width + x1) * 4 + c];
+
+                next[((size_t) y * next_width + x) * 4 + c] = (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+
+    return next;
+}
+
+static bool pack_texture(const std::filesystem::path& path, PackedAsset& asset) {
+    int width = 0, height = 0, channels = 0;
+    unsigned char* pixels = stbi_load(path.string().c_str(), &width, &height, &channels, 4);
+
+    if (pixels == nullptr) {
+        fprintf(stderr, "Failed to decode %s: %s\n", path.string().c_str(), stbi_failure_reason());
+
+        return false;
+    }
+
+    asset.entry.type = AssetPackFormat::EntryType::TEXTURE;
+    asset.entry.width = (uint32_t) width;
+    asset.entry.height = (uint32_t) height;
+    asset.entry.mip_count = 1;
+    asset.data.assign(pixels, pixels + (size_t) width * height * 4);
+
+    stbi_image_free(pixels);
+
+    // Every level is generated from the previous one, down to 1x1
+    size_t level_offset = 0;
+    uint32_t level_width = asset.entry.width;
+    uint32_t level_height = asset.entry.height;
+
+    while (level_width > 1 || level_height > 1) {
+        std::vector<unsigned char> next = downsample(asset.data.data() + level_offset, level_width, level_height);
+
+        level_offset = asset.data.size();
+        asset.data.insert(asset.data.end(), next.begin(), next.end());
+
+        level_width = std::max<uint32_t>(level_width / 2, 1);
+        level_height = std::max<uint32_t>(level_height / 2, 1);
+        ++asset.entry.mip_count;
+    }
+
+    return true;
+}
+
+static bool pack_shader(const std::filesystem::path& path, PackedAsset& asset) {
+    FILE* file = fopen(path.string().c_str(), "rb");
+
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open %s\n", path.string().c_str());
+
+        return false;
+    }
+
+    asset.entry.type = AssetPackFormat::EntryType::SHADER;
+
+    unsigned char buffer[4096];
+    size_t read = 0;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        asset.data.insert(asset.data.end(), buffer, buffer + read);
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+static bool write_pack(const char* file_name, std::vector<PackedAsset>& assets) {
+    FILE* file = fopen(file_name, "wb");
+
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to create %s\n", file_name);
+
+        return false;
+    }
+
+    // AssetPack binary searches the entries by name
+    std::sort(assets.begin(), assets.end(), [](const PackedAsset& a, const PackedAsset& b) {
+        return strcmp(a.entry.name, b.entry.name) < 0;
+    });
+
+    size_t offset = sizeof(AssetPackFormat::Header) + assets.size() * sizeof(AssetPackFormat::Entry);
+
+    for (PackedAsset& asset: assets) {
+        offset = (offset + AssetPackFormat::DATA_ALIGNMENT - 1) / AssetPackFormat::DATA_ALIGNMENT * AssetPackFormat::DATA_ALIGNMENT;
+
+        asset.entry.offset = offset;
+        asset.entry.size = asset.data.size();
+
+        offset += asset.data.size();
+    }
+
+    AssetPackFormat::Header header{};
+    memcpy(header.magic, AssetPackFormat::MAGIC, sizeof(header.magic));
+    header.version = AssetPackFormat::VERSION;
+    header.entry_count = (uint32_t) assets.size();
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (const PackedAsset& asset: assets) {
+        fwrite(&asset.entry, sizeof(asset.entry), 1, file);
+    }
+
+    const unsigned char padding[AssetPackFormat::DATA_ALIGNMENT] = {};
+    size_t written = sizeof(AssetPackFormat::Header) + assets.size() * sizeof(AssetPackFormat::Entry);
+
+    for (const PackedAsset& asset: assets) {
+        fwrite(padding, 1, asset.entry.offset - written, file);
+        fwrite(asset.data.data(), 1, asset.data.size(), file);
+
+        written = asset.entry.offset + asset.data.size();
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    return ok;
+}
+
+int main(int argc, char* args[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <asset directory> <output pack>\n", args[0]);
+
+        return 1;
+    }
+
+    const std::filesystem::path asset_directory{args[1]};
+
+    if (!std::filesystem::is_directory(asset_directory)) {
+        fprintf(stderr, "Not a directory: %s\n", args[1]);
+
+        return 1;
+    }
+
+    std::vector<PackedAsset> assets;
+
+    for (const auto& directory_entry: std::filesystem::recursive_directory_iterator{asset_directory}) {
+        if (!directory_entry.is_regular_file()) {
+            continue;
+        }
+
+        const std::filesystem::path& path = directory_entry.path();
+        const bool texture = path.extension() == ".png";
+
+        if (!texture && !is_shader(path)) {
+            continue;
+        }
+
+        // Named like the loose file path the game opens, relative to the asset directory
+        const std::string name = std::filesystem::relative(path, asset_directory).generic_string();
+
+        if (name.size() >= AssetPackFormat::NAME_LENGTH) {
+            fprintf(stderr, "Name too long for the pack: %s\n", name.c_str());
+
+            return 1;
+        }
+
+        PackedAsset asset{};
+        memcpy(asset.entry.name, name.c_str(), name.size());
+
+        if (!(texture ? pack_texture(path, asset) : pack_shader(path, asset))) {
+            return 1;
+        }
+
+        printf("Packed %-48s %8zu bytes\n", name.c_str(), asset.data.size());
+
+        assets.push_back(std::move(asset));
+    }
+
+    if (!write_pack(args[2], assets)) {
+        return 1;
+    }
+
+    printf("Wrote %zu assets to %s\n", assets.size(), args[2]);
+
+    return 0;
+}